@@ -0,0 +1,108 @@
+/***************************************************************************
+ *   Copyright (C) by ETHZ/SED, GNS New Zealand, GeoScience Australia      *
+ *                                                                         *
+ * This program is free software: you can redistribute it and/or modify    *
+ * it under the terms of the GNU Affero General Public License as published*
+ * by the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                     *
+ *                                                                         *
+ * This program is distributed in the hope that it will be useful,         *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU Affero General Public License for more details.                     *
+ *                                                                         *
+ *   Developed by gempa GmbH                                               *
+ ***************************************************************************/
+
+
+#include "pool.h"
+
+
+namespace Seiscomp {
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+WorkerPool::WorkerPool(int numberOfThreads)
+: _activeJobs(0), _shutdown(false) {
+	for ( int i = 0; i < numberOfThreads; ++i )
+		_threads.emplace_back(&WorkerPool::run, this);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+WorkerPool::~WorkerPool() {
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_shutdown = true;
+	}
+
+	_jobAvailable.notify_all();
+
+	for ( auto &thread : _threads )
+		thread.join();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WorkerPool::push(Job job) {
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_jobs.push_back(std::move(job));
+	}
+
+	_jobAvailable.notify_one();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WorkerPool::wait() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle.wait(lock, [this] { return _jobs.empty() && _activeJobs == 0; });
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WorkerPool::run() {
+	while ( true ) {
+		Job job;
+
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_jobAvailable.wait(lock, [this] { return _shutdown || !_jobs.empty(); });
+
+			// Drain the queue before shutting down
+			if ( _jobs.empty() ) return;
+
+			job = std::move(_jobs.front());
+			_jobs.pop_front();
+			++_activeJobs;
+		}
+
+		job();
+
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			--_activeJobs;
+			if ( _jobs.empty() && _activeJobs == 0 )
+				_idle.notify_all();
+		}
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+}
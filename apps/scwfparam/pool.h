@@ -0,0 +1,80 @@
+/***************************************************************************
+ *   Copyright (C) by ETHZ/SED, GNS New Zealand, GeoScience Australia      *
+ *                                                                         *
+ * This program is free software: you can redistribute it and/or modify    *
+ * it under the terms of the GNU Affero General Public License as published*
+ * by the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                     *
+ *                                                                         *
+ * This program is distributed in the hope that it will be useful,         *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU Affero General Public License for more details.                     *
+ *                                                                         *
+ *   Developed by gempa GmbH                                               *
+ ***************************************************************************/
+
+
+#ifndef __SEISCOMP_APPLICATIONS_WFPARAM_POOL_H__
+#define __SEISCOMP_APPLICATIONS_WFPARAM_POOL_H__
+
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace Seiscomp {
+
+
+/**
+ * @brief A fixed size pool of worker threads executing queued jobs in
+ *        FIFO order. Jobs must not touch reference counted objects that
+ *        are shared with the main thread, the caller is responsible to keep
+ *        them alive until the job has finished.
+ */
+class WorkerPool {
+	public:
+		using Job = std::function<void()>;
+
+
+	public:
+		//! Starts numberOfThreads worker threads
+		explicit WorkerPool(int numberOfThreads);
+
+		//! Waits for all pending jobs and joins the workers
+		~WorkerPool();
+
+
+	public:
+		int size() const { return static_cast<int>(_threads.size()); }
+
+		//! Appends a job to the queue
+		void push(Job job);
+
+		//! Blocks until the queue is empty and no job is running anymore
+		void wait();
+
+
+	private:
+		void run();
+
+
+	private:
+		std::vector<std::thread> _threads;
+		std::deque<Job>          _jobs;
+		std::mutex               _mutex;
+		std::condition_variable  _jobAvailable;
+		std::condition_variable  _idle;
+		int                      _activeJobs;
+		bool                     _shutdown;
+};
+
+
+}
+
+
+#endif
@@ -23,6 +23,8 @@
 #define SEISCOMP_COMPONENT PGAV
 
 #include "pgav.h"
+#include "responsecache.h"
+#include "sdof.h"
 #include <seiscomp/logging/log.h>
 #include <seiscomp/math/mean.h>
 #include <seiscomp/math/fft.h>
@@ -30,6 +32,8 @@
 #include <seiscomp/math/filter/stalta.h>
 #include <seiscomp/math/restitution/fft.h>
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <fstream>
 
@@ -282,6 +286,41 @@ void ButterworthLoPass_Acausal(std::vector<Complex> &spec,
 	}
 }
 
+// Number of decay times T/(2*pi*zeta) of the oscillator response the trace
+// is followed by zeros in the frequency domain response spectrum method.
+// The part of the response wrapping around into the signal is then below
+// exp(-10) = 5E-5 of the response at the end of the trace.
+const double ResponseDecayTimes = 10.0;
+
+
+// Computes the maximum absolute relative displacement of a damped SDOF
+// oscillator within the samples [start, end) from the spectrum of the
+// ground acceleration. The transfer function of the relative displacement
+// is H(f) = -1 / (w0^2 - w^2 + 2i*zeta*w0*w).
+double spectralMaxDisplacement(std::vector<Complex> &work, DoubleArray &out,
+                               const std::vector<Complex> &acc, double df,
+                               double T, double zeta, int start, int end) {
+	double w0 = (2*M_PI)/T;
+	double w02 = w0*w0;
+
+	work.resize(acc.size());
+	for ( size_t i = 0; i < acc.size(); ++i ) {
+		double w = 2*M_PI*df*i;
+		work[i] = -acc[i] / Complex(w02 - w*w, 2*zeta*w0*w);
+	}
+
+	Math::ifft(out.size(), out.typedData(), work);
+
+	double maxx = 0;
+	for ( int i = start; i < end; ++i ) {
+		double v = fabs(out[i]);
+		if ( v > maxx ) maxx = v;
+	}
+
+	return maxx;
+}
+
+
 template <typename T>
 void costaper(int n, T *inout, int istart, int iend, int estart, int eend) {
 	int taperLength = iend - istart;
@@ -306,12 +345,93 @@ void costaper(int n, T *inout, int istart, int iend, int estart, int eend) {
 }
 
 
+typedef std::unique_ptr< Filtering::InPlaceFilter<double> > FilterPtr;
+
+
+// Work buffers shared by all processors running in the same thread. They
+// keep their capacity between time windows and avoid to allocate
+// the spectra and temporary traces for each channel again.
+struct Workspace {
+	std::vector<Complex> spectrum;
+	std::vector<Complex> accSpectrum;
+	std::vector<Complex> response;
+	DoubleArray          trace;
+	DoubleArray          Ia;
+};
+
+
+Workspace &workspace() {
+	static thread_local Workspace ws;
+	return ws;
+}
+
+
+// Returns the smallest number >= n without prime factors larger than 5.
+// The FFT is considerably slower for lengths with large prime factors.
+int fastFFTSize(int n) {
+	for ( ; ; ++n ) {
+		int m = n;
+		while ( m % 2 == 0 ) m /= 2;
+		while ( m % 3 == 0 ) m /= 3;
+		while ( m % 5 == 0 ) m /= 5;
+		if ( m == 1 ) return n;
+	}
+}
+
+
+// Measures the time between consecutive laps and adds it to the counter
+// of the stage that has just finished
+class StageClock {
+	public:
+		StageClock() : _last(std::chrono::steady_clock::now()) {}
+
+		void lap(double &stage) {
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			stage += std::chrono::duration<double>(now - _last).count();
+			_last = now;
+		}
+
+	private:
+		std::chrono::steady_clock::time_point _last;
+};
+
+
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
 
 
 
+// State of the incremental processing. All indexes are absolute indexes
+// into _data.
+struct PGAV::IncrementalState {
+	IncrementalState()
+	: next(0), offset(0), lastVelocity(0), lastAcc(0), velocity(0)
+	, maxSTALTA(0), maxRaw(0), pga(0), pgv(0), loFilter(0), hiFilter(0) {}
+
+	int                 start;
+	int                 trigger;
+	int                 next;
+	int                 staltaI0, staltaI1;
+	double              gain;
+	double              offset;
+	double              lastVelocity;
+	double              lastAcc;
+	double              velocity;
+	double              maxSTALTA;
+	double              maxRaw;
+	double              pga, pgv;
+	double              loFilter, hiFilter;
+	STALTA<double>      stalta;
+	FilterPtr           hp, lp;
+	OscillatorBank      oscillators;
+	std::vector<double> periods;
+	std::vector<double> buffer;
+};
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 int PGAV::Config::freqFromString(double &val, const std::string &str) {
 	bool isNyquist = false;
@@ -348,6 +468,23 @@ bool PGAV::Config::freqToString(std::string &str, double val) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool PGAV::Config::methodFromString(ResponseSpectrumMethod &method,
+                                    const std::string &str) {
+	if ( str == "newmark" )
+		method = Newmark;
+	else if ( str == "fft" )
+		method = FFT;
+	else
+		return false;
+
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 PGAV::PGAV(const Seiscomp::Core::Time& trigger) {
 	_trigger = trigger;
@@ -453,6 +590,24 @@ void PGAV::setCustomPeriods(const std::vector<double> &periods) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void PGAV::setResponseSpectrumMethod(Config::ResponseSpectrumMethod method) {
+	_config.responseSpectrumMethod = method;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void PGAV::setResponseID(const std::string &id) {
+	_responseID = id;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void PGAV::setAftershockRemovalEnabled(bool e) {
 	_config.aftershockRemoval = e;
@@ -658,6 +813,18 @@ bool PGAV::setup(const Settings &settings) {
 	settings.getValue(_config.Tmin, "PGAV.Tmin");
 	settings.getValue(_config.Tmax, "PGAV.Tmax");
 
+	string method;
+	if ( settings.getValue(method, "PGAV.responseSpectrum.method") ) {
+		if ( !Config::methodFromString(_config.responseSpectrumMethod, method) ) {
+			SEISCOMP_ERROR("%s.%s.PGAV.responseSpectrum.method: expected either "
+			               "'newmark' or 'fft', got '%s'",
+			               settings.networkCode.c_str(),
+			               settings.stationCode.c_str(),
+			               method.c_str());
+			return false;
+		}
+	}
+
 	if ( _config.totalTimeWindowLength <= 0 ) {
 		SEISCOMP_ERROR("%s.%s.PGAV.totalTimeWindowLength <= 0: ",
 		               settings.networkCode.c_str(),
@@ -684,6 +851,227 @@ void PGAV::finish() {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void PGAV::setDeferredProcessing(bool f) {
+	_deferred = f;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void PGAV::processDeferred() {
+	if ( !_pending ) return;
+
+	_pending = false;
+
+	bool deferred = _deferred;
+	_deferred = false;
+	process(lastRecord(), _data);
+	_deferred = deferred;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void PGAV::setIncrementalProcessing(bool f) {
+	_incremental = f;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void PGAV::updateIncremental(int ti, int noise0i, int sig1i) {
+	int n = (int)_data.size();
+	double dt = 1.0 / _stream.fsamp;
+
+	// Data have been reset in between, e.g. due to a gap
+	if ( _incrementalState &&
+	     (_incrementalState->start != noise0i || n < _incrementalState->next) )
+		_incrementalState.reset();
+
+	if ( !_incrementalState ) {
+		// Wait for the complete pre event window to compute the offset
+		if ( n <= ti ) return;
+
+		IncrementalState *state = new IncrementalState;
+		_incrementalState.reset(state);
+
+		state->start = state->next = noise0i;
+		state->trigger = ti;
+		state->gain = _streamConfig[targetComponent()].gain;
+
+		// Offset of the pre event window in acceleration units. The
+		// pre event cut-off is not applied, it requires the data
+		// after the trigger.
+		if ( ti > noise0i ) {
+			double sum = 0;
+			for ( int i = noise0i; i < ti; ++i ) {
+				if ( _velocity ) {
+					if ( i > noise0i )
+						sum += (_data[i] - _data[i-1]) / state->gain * _stream.fsamp;
+				}
+				else
+					sum += _data[i] / state->gain;
+			}
+
+			state->offset = sum / (ti-noise0i);
+		}
+
+		state->stalta = STALTA<double>(
+			std::min(_config.STAlength, _config.preEventWindowLength),
+			std::min(_config.LTAlength, dt*(ti-noise0i)), _stream.fsamp
+		);
+
+		state->staltaI0 = noise0i;
+		state->staltaI1 = sig1i;
+
+		if ( _config.STALTAmargin >= 0 ) {
+			state->staltaI0 = (int)(ti - _config.STALTAmargin*_stream.fsamp);
+			state->staltaI1 = (int)(ti + _config.STALTAmargin*_stream.fsamp);
+		}
+
+		if ( _config.filterOrder > 0 ) {
+			double fNyquist = (_stream.fsamp * 0.5);
+			double fmin = _config.loFilterFreq;
+			double fmax = _config.hiFilterFreq;
+
+			if ( fmin < 0 ) fmin = fabs(fmin) * fNyquist;
+			if ( fmax < 0 ) fmax = fabs(fmax) * fNyquist;
+
+			if ( fmin > 0 ) {
+				state->hp.reset(new Math::Filtering::IIR::ButterworthHighpass<double>(_config.filterOrder, fmin));
+				state->hp->setSamplingFrequency(_stream.fsamp);
+			}
+
+			if ( fmax > 0 ) {
+				state->lp.reset(new Math::Filtering::IIR::ButterworthLowpass<double>(_config.filterOrder, fmax));
+				state->lp->setSamplingFrequency(_stream.fsamp);
+			}
+
+			if ( state->hp || state->lp ) {
+				state->loFilter = fmin;
+				state->hiFilter = fmax;
+			}
+		}
+
+		computePeriods(state->periods);
+
+		state->oscillators.setSamplingInterval(dt);
+		for ( size_t di = 0; di < _config.dampings.size(); ++di ) {
+			double zeta = _config.dampings[di]*0.01;
+			for ( size_t i = 0; i < state->periods.size(); ++i ) {
+				if ( state->periods[i] == 0 || state->periods[i] == -1 ) continue;
+				state->oscillators.add(state->periods[i], zeta);
+			}
+		}
+
+		SEISCOMP_DEBUG("> incremental processing of %s started",
+		               lastRecord()->streamID().c_str());
+	}
+
+	IncrementalState &state = *_incrementalState;
+	int m = n - state.next;
+
+	if ( m > 0 ) {
+		state.buffer.resize(m);
+
+		// Gain, STA/LTA, conversion to acceleration and offset removal
+		for ( int j = 0; j < m; ++j ) {
+			int i = state.next + j;
+
+			if ( _data[i] > state.maxRaw ) state.maxRaw = _data[i];
+
+			double v = _data[i] / state.gain;
+			double r = v;
+			state.stalta.apply(1, &r);
+			if ( i >= state.staltaI0 && i <= state.staltaI1 && r > state.maxSTALTA )
+				state.maxSTALTA = r;
+
+			double a;
+			if ( _velocity ) {
+				a = i == state.start ? 0 : (v - state.lastVelocity) * _stream.fsamp;
+				state.lastVelocity = v;
+			}
+			else
+				a = v;
+
+			state.buffer[j] = a - state.offset;
+		}
+
+		// The causal filters keep their state between calls
+		if ( state.hp ) state.hp->apply(m, &state.buffer[0]);
+		if ( state.lp ) state.lp->apply(m, &state.buffer[0]);
+
+		// Track the maxima after the trigger and integrate to velocity
+		// using the trapezoidal rule
+		double as = 0.5 * dt;
+		for ( int j = 0; j < m; ++j ) {
+			int i = state.next + j;
+			double a = state.buffer[j];
+
+			if ( i > state.start )
+				state.velocity += (state.lastAcc + a)*as;
+			state.lastAcc = a;
+
+			if ( i < state.trigger ) continue;
+
+			if ( fabs(a) > state.pga ) state.pga = fabs(a);
+			if ( fabs(state.velocity) > state.pgv ) state.pgv = fabs(state.velocity);
+		}
+
+		state.oscillators.feed(m, &state.buffer[0]);
+		state.next = n;
+	}
+
+	// Noise only data are not reported
+	if ( state.next <= state.trigger || state.maxSTALTA < _config.STALTAratio )
+		return;
+
+	_maximumRawValue = state.maxRaw;
+	_loFilter = state.loFilter;
+	_hiFilter = state.hiFilter;
+	_pga = state.pga;
+	_pgv = state.pgv;
+
+	_responseSpectra.clear();
+
+	size_t oi = 0;
+	for ( size_t di = 0; di < _config.dampings.size(); ++di ) {
+		_responseSpectra.push_back(DampingResponseSpectrum(_config.dampings[di], ResponseSpectrum()));
+		ResponseSpectrum &spectrum = _responseSpectra.back().second;
+		spectrum.resize(state.periods.size());
+
+		for ( size_t i = 0; i < state.periods.size(); ++i ) {
+			spectrum[i].period = state.periods[i];
+
+			if ( state.periods[i] == 0 ) {
+				spectrum[i].sd = spectrum[i].psa = _pga;
+			}
+			else if ( state.periods[i] == -1 ) {
+				spectrum[i].sd = spectrum[i].psa = _pgv;
+			}
+			else {
+				double maxx = state.oscillators.maximumDisplacement(oi);
+				spectrum[i].sd = maxx;
+				spectrum[i].psa = maxx*state.oscillators.omega2(oi);
+				++oi;
+			}
+		}
+	}
+
+	_provisional = true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void PGAV::computeTimeWindow() {
 	setTimeWindow(
@@ -716,6 +1104,7 @@ void PGAV::process(const Record *record, const DoubleArray &) {
 	_loFilter = _hiFilter = 0;
 	_velocity = true;
 	_processed = false;
+	_provisional = false;
 
 	// Sampling frequency has not been set yet
 	if ( _stream.fsamp == 0.0 )
@@ -781,12 +1170,28 @@ void PGAV::process(const Record *record, const DoubleArray &) {
 	if ( n < sig1i ) {
 		// time window not complete
 		if ( !_force ) {
+			if ( _incremental && !_config.noncausal && !_config.useDeconvolution )
+				updateIncremental(ti, noise0i, sig1i);
+
 			setStatus(InProgress, n*100.0/sig1i);
 			return;
 		}
 
 		sig1i = n;
 	}
+	else if ( _deferred && !_force ) {
+		// Time window complete but processing is left to processDeferred()
+		_processed = false;
+		_pending = true;
+		setStatus(InProgress, 100);
+		return;
+	}
+
+	// The final values are computed from the complete time window
+	_incrementalState.reset();
+
+	_timings.reset();
+	StageClock clock;
 
 	SEISCOMP_DEBUG("> processing %s", record->streamID().c_str());
 
@@ -863,6 +1268,8 @@ void PGAV::process(const Record *record, const DoubleArray &) {
 		_data[i] /= _streamConfig[targetComponent()].gain;
 	}
 
+	clock.lap(_timings.gain);
+
 
 	// -------------------------------------------------------------------
 	// Check STA/LTA ratio
@@ -899,6 +1306,8 @@ void PGAV::process(const Record *record, const DoubleArray &) {
 	               std::min(_config.LTAlength, dt*(ti-noise0i)),
 	               maxSTALTA, maxSTALTA >= _config.STALTAratio?"yes":"no");
 
+	clock.lap(_timings.stalta);
+
 	// Return if minimum STA/LTA ratio is not reached
 	if ( maxSTALTA < _config.STALTAratio ) {
 		setStatus(LowSNR, maxSTALTA);
@@ -985,7 +1394,8 @@ void PGAV::process(const Record *record, const DoubleArray &) {
 	// -------------------------------------------------------------------
 	// Signal duration
 	// -------------------------------------------------------------------
-	DoubleArray Ia;
+	Workspace &ws = workspace();
+	DoubleArray &Ia = ws.Ia;
 	double Ias = M_PI/(2*9.81)*dt;
 
 	Ia.resize(n);
@@ -1094,8 +1504,13 @@ void PGAV::process(const Record *record, const DoubleArray &) {
 	               (sig1i-ti)*dt);
 
 	double fNyquist = (_stream.fsamp * 0.5);
-	std::vector<Complex> spectrum;
+	std::vector<Complex> &spectrum = ws.spectrum;
 	double df = 0.0;
+	// First sample of the signal and number of zeros after the data
+	int sigStart = 0;
+	int trailingZeros = 0;
+
+	clock.lap(_timings.other);
 
 	if ( _config.noncausal || _config.useDeconvolution ) {
 		double Tzpad;
@@ -1121,20 +1536,29 @@ void PGAV::process(const Record *record, const DoubleArray &) {
 		int numZeros = Tzpad * _stream.fsamp;
 
 		if ( numZeros > 0 ) {
-			SEISCOMP_DEBUG(">  padding %.1f secs / %d samples of zeros on either side",
-			               Tzpad, numZeros);
-			DoubleArray zeros(numZeros);
-			zeros.fill(0);
-
-			_data.prepend(&zeros);
-			_data.append(&zeros);
+			int len = (int)_data.size();
+			// Round the padded length up to a size the FFT handles
+			// efficiently, the additional zeros are appended
+			int total = fastFFTSize(len + 2*numZeros);
+			int numTrailingZeros = total - len - numZeros;
+
+			SEISCOMP_DEBUG(">  padding %.1f secs / %d samples of zeros on either side, "
+			               "%d samples in total",
+			               Tzpad, numZeros, total);
+
+			// Pad in place, only grow the buffer once
+			_data.resize(total);
+			double *data = _data.typedData();
+			std::copy_backward(data, data + len, data + numZeros + len);
+			std::fill(data, data + numZeros, 0.0);
+			std::fill(data + numZeros + len, data + total, 0.0);
 
 			_stream.dataTimeWindow.setStartTime(
 				_stream.dataTimeWindow.startTime() - Core::TimeSpan(Tzpad)
 			);
 
 			_stream.dataTimeWindow.setEndTime(
-				_stream.dataTimeWindow.endTime() + Core::TimeSpan(Tzpad)
+				_stream.dataTimeWindow.endTime() + Core::TimeSpan(numTrailingZeros*dt)
 			);
 
 			// Taper data
@@ -1149,11 +1573,14 @@ void PGAV::process(const Record *record, const DoubleArray &) {
 				SEISCOMP_DEBUG(">  taper %.1f secs / %d samples on either side",
 				               taperLength, numTaperSamples);
 
-				costaper(_data.size(), _data.typedData(),
+				costaper(total, data,
 				         numZeros, numZeros + numTaperSamples,
-				         _data.size() - numZeros - numTaperSamples, _data.size() - numZeros);
+				         numZeros + len - numTaperSamples, numZeros + len);
 			}
 
+			sigStart = numZeros;
+			trailingZeros = numTrailingZeros;
+
 			ti += numZeros;
 			noise1i += numZeros;
 			sig0i += numZeros;
@@ -1164,6 +1591,8 @@ void PGAV::process(const Record *record, const DoubleArray &) {
 		// Compute frequency spectrum of trace
 		Math::fft(spectrum, _data.size(), _data.typedData());
 		df = fNyquist / spectrum.size();
+
+		clock.lap(_timings.fft);
 	}
 
 	// -------------------------------------------------------------------
@@ -1186,18 +1615,46 @@ void PGAV::process(const Record *record, const DoubleArray &) {
 			return;
 		}
 
-		Math::Restitution::FFT::TransferFunctionPtr tf =
-			sensor->response()->getTransferFunction();
+		int nfft = (int)_data.size();
+		ResponseCache::SpectrumCPtr inverse;
 
-		if ( tf == NULL ) {
-			SEISCOMP_DEBUG(">  deconvolution failed, no transferfunction");
-			setStatus(DeconvolutionFailed, 1);
-			return;
+		// Look up the evaluated response shared by all processors
+		if ( !_responseID.empty() )
+			inverse = ResponseCache::Instance().find(_responseID, nfft, df);
+
+		if ( !inverse ) {
+			Math::Restitution::FFT::TransferFunctionPtr tf =
+				sensor->response()->getTransferFunction();
+
+			if ( tf == NULL ) {
+				SEISCOMP_DEBUG(">  deconvolution failed, no transferfunction");
+				setStatus(DeconvolutionFailed, 1);
+				return;
+			}
+
+			if ( !_responseID.empty() ) {
+				// Deconvolve a white spectrum to get the inverse response
+				std::shared_ptr<ResponseCache::Spectrum> tmp =
+					std::make_shared<ResponseCache::Spectrum>(spectrum.size(), Complex(1.0, 0.0));
+				tf->deconvolve(*tmp, df, df);
+				inverse = tmp;
+				ResponseCache::Instance().insert(_responseID, nfft, df, inverse);
+			}
+			else
+				tf->deconvolve(spectrum, df, df);
+		}
+		else
+			SEISCOMP_DEBUG(">  using cached response %s", _responseID.c_str());
+
+		if ( inverse ) {
+			for ( size_t i = 0; i < spectrum.size(); ++i )
+				spectrum[i] *= (*inverse)[i];
 		}
 
-		tf->deconvolve(spectrum, df, df);
 		SEISCOMP_DEBUG(">  applied deconvolution");
 
+		clock.lap(_timings.deconvolution);
+
 		// -------------------------------------------------------------------
 		// Optional post-deconvolution filter
 		// -------------------------------------------------------------------
@@ -1231,9 +1688,13 @@ void PGAV::process(const Record *record, const DoubleArray &) {
 			SEISCOMP_DEBUG(">  no post deconvolution filter applied: order <= 0 (%d)",
 			               _config.PDorder);
 
+		clock.lap(_timings.filter);
+
 		// Convert back to time domain
-		if ( !_config.noncausal )
+		if ( !_config.noncausal ) {
 			Math::ifft(_data.size(), _data.typedData(), spectrum);
+			clock.lap(_timings.fft);
+		}
 	}
 	else
 		SEISCOMP_DEBUG(">  no deconvolution applied (disabled)");
@@ -1301,9 +1762,27 @@ void PGAV::process(const Record *record, const DoubleArray &) {
 	else
 		SEISCOMP_DEBUG(">  no filter applied: filter order <= 0 (%d)", _config.filterOrder);
 
-	if ( _config.noncausal )
+	clock.lap(_timings.filter);
+
+	// Spectrum of the final acceleration trace used to compute the response
+	// spectra in the frequency domain
+	std::vector<Complex> &accSpectrum = ws.accSpectrum;
+	int nfft = 0;
+
+	accSpectrum.clear();
+
+	if ( _config.noncausal ) {
+		// Keep the filtered spectrum, the inverse transform is allowed
+		// to use it as work space
+		if ( _config.responseSpectrumMethod == Config::FFT ) {
+			accSpectrum = spectrum;
+			nfft = _data.size();
+		}
+
 		// Convert back to time domain
 		Math::ifft(_data.size(), _data.typedData(), spectrum);
+		clock.lap(_timings.fft);
+	}
 
 	int pgai, pgvi;
 
@@ -1361,10 +1840,150 @@ void PGAV::process(const Record *record, const DoubleArray &) {
 	SEISCOMP_DEBUG(">  PGA = %e", _pga);
 	SEISCOMP_DEBUG(">  PGV = %e", _pgv);
 
+	clock.lap(_timings.other);
+
 
 	// -------------------------------------------------------------------
 	// Calculate response spectra
 	// -------------------------------------------------------------------
+	vector<double> T;
+	computePeriods(T);
+
+	_responseSpectra.clear();
+
+	// Set up one oscillator per damping and period and integrate all of
+	// them in a single pass over the data
+	OscillatorBank oscillators;
+	oscillators.setSamplingInterval(dt);
+
+	for ( size_t di = 0; di < _config.dampings.size(); ++di ) {
+		// Convert from percent
+		double zeta = _config.dampings[di]*0.01;
+
+		_responseSpectra.push_back(DampingResponseSpectrum(_config.dampings[di], ResponseSpectrum()));
+		ResponseSpectrum &spectrum = _responseSpectra.back().second;
+		spectrum.resize(T.size());
+
+		for ( size_t i = 0; i < T.size(); ++i ) {
+			spectrum[i].period = T[i];
+
+			if ( T[i] == 0 ) {
+				spectrum[i].sd = _pga;
+				spectrum[i].psa = _pga;
+				continue;
+			}
+			else if ( T[i] == -1 ) {
+				spectrum[i].sd = _pgv;
+				spectrum[i].psa = _pgv;
+				continue;
+			}
+
+			oscillators.add(T[i], zeta);
+		}
+	}
+
+	// The oscillator responses computed in the frequency domain are
+	// circular. The response to the end of the trace has to decay before it
+	// wraps around into the signal, which requires enough trailing zeros
+	// for the longest decay time T/(2*pi*zeta). Undamped oscillators do not
+	// decay and are integrated in the time domain.
+	bool useFFT = _config.responseSpectrumMethod == Config::FFT
+	           && oscillators.size() > 0 && sig1i > sigStart;
+	int numDecaySamples = 0;
+
+	if ( useFFT ) {
+		double decayTime = 0;
+		for ( size_t di = 0; di < _config.dampings.size(); ++di ) {
+			double zeta = _config.dampings[di]*0.01;
+			if ( zeta <= 0 ) {
+				SEISCOMP_DEBUG(">  response spectra: undamped oscillators, fall back to newmark method");
+				useFFT = false;
+				break;
+			}
+
+			for ( size_t i = 0; i < T.size(); ++i ) {
+				if ( T[i] > 0 )
+					decayTime = std::max(decayTime, T[i]/(2*M_PI*zeta));
+			}
+		}
+
+		numDecaySamples = (int)ceil(ResponseDecayTimes*decayTime*_stream.fsamp);
+	}
+
+	if ( useFFT ) {
+		if ( !accSpectrum.empty() && trailingZeros < numDecaySamples ) {
+			SEISCOMP_DEBUG(">  response spectra: %d trailing zeros, %d required, "
+			               "transform signal again", trailingZeros, numDecaySamples);
+			accSpectrum.clear();
+		}
+
+		if ( accSpectrum.empty() ) {
+			// No usable spectrum of the final trace available, transform
+			// the signal window followed by enough zeros
+			nfft = fastFFTSize(sig1i + numDecaySamples);
+			DoubleArray &padded = ws.trace;
+			padded.resize(nfft);
+			std::copy(_data.typedData(), _data.typedData()+sig1i, padded.typedData());
+			std::fill(padded.typedData()+sig1i, padded.typedData()+nfft, 0.0);
+			Math::fft(accSpectrum, nfft, padded.typedData());
+		}
+
+		SEISCOMP_DEBUG(">  response spectra: fft method with %d samples", nfft);
+
+		double dfs = _stream.fsamp / nfft;
+		std::vector<Complex> &work = ws.response;
+		DoubleArray &response = ws.trace;
+		response.resize(nfft);
+
+		size_t oi = 0;
+		for ( auto &item : _responseSpectra ) {
+			double zeta = item.first*0.01;
+			ResponseSpectrum &spectrum = item.second;
+			for ( size_t i = 0; i < spectrum.size(); ++i ) {
+				if ( T[i] == 0 || T[i] == -1 ) continue;
+
+				double maxx = spectralMaxDisplacement(work, response, accSpectrum,
+				                                      dfs, T[i], zeta, sigStart, sig1i);
+				spectrum[i].sd = maxx;
+				spectrum[i].psa = maxx*oscillators.omega2(oi);
+				++oi;
+			}
+		}
+	}
+	else {
+		oscillators.feed(sig1i, _data.typedData());
+
+		// Oscillators have been added in the same order
+		size_t oi = 0;
+		for ( auto &item : _responseSpectra ) {
+			ResponseSpectrum &spectrum = item.second;
+			for ( size_t i = 0; i < spectrum.size(); ++i ) {
+				if ( T[i] == 0 || T[i] == -1 ) continue;
+
+				double maxx = oscillators.maximumDisplacement(oi);
+				spectrum[i].sd = maxx;
+				spectrum[i].psa = maxx*oscillators.omega2(oi);
+				++oi;
+			}
+		}
+	}
+
+	clock.lap(_timings.spectra);
+
+#ifndef CONTINUE_PROCESSING_WHEN_CHECK_FAILS
+	_processed = true;
+	setStatus(Finished, 100);
+#endif
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void PGAV::computePeriods(std::vector<double> &T) const {
+	T.clear();
+
 	double Tmax = _config.Tmax;
 
 	if ( _config.clipTmax ) {
@@ -1379,8 +1998,6 @@ void PGAV::process(const Record *record, const DoubleArray &) {
 		}
 	}
 
-	vector<double> T;
-
 	if ( !_config.fixedPeriods ) {
 		if ( !_config.customPeriods.empty() ) {
 			T = _config.customPeriods;
@@ -1439,72 +2056,6 @@ void PGAV::process(const Record *record, const DoubleArray &) {
 			T.assign(FIXED_PERIODS, FIXED_PERIODS + sizeof(FIXED_PERIODS)/sizeof(double));
 		}
 	}
-
-	_responseSpectra.clear();
-	for ( size_t di = 0; di < _config.dampings.size(); ++di ) {
-		// Convert from percent
-		double zeta = _config.dampings[di]*0.01;
-
-		_responseSpectra.push_back(DampingResponseSpectrum(_config.dampings[di], ResponseSpectrum()));
-		ResponseSpectrum &spectrum = _responseSpectra.back().second;
-		spectrum.resize(T.size());
-
-		for ( size_t i = 0; i < T.size(); ++i ) {
-			spectrum[i].period = T[i];
-
-			if ( T[i] == 0 ) {
-				spectrum[i].sd = _pga;
-				spectrum[i].psa = _pga;
-				continue;
-			}
-			else if ( T[i] == -1 ) {
-				spectrum[i].sd = _pgv;
-				spectrum[i].psa = _pgv;
-				continue;
-			}
-
-			double K = (2*M_PI)/T[i];
-			double C = 2*zeta*K;
-			double beta = 0.25;
-			double gamma = 0.5;
-			K *= K; // K = K^2
-
-			double B = 1.0/(beta*dt*dt) + (gamma*C)/(beta*dt);
-			double A = B + K;
-			double E = 1.0/(beta*dt) + (gamma/beta-1)*C;
-			double G = 1.0/(2*beta)-1.0;
-
-			double x = 0;
-			double xp = 0;
-			// f = -f: thats why -_data[0] is used
-			double xpp = -_data[0];
-			double maxx = x;
-
-			for ( int j = 1; j < sig1i; ++j ) {
-				// f = -f: thats why -_data[j] is used
-				double xn = (-_data[j]+B*x+E*xp+G*xpp)/A;
-				double xppn = (xn-x-dt*xp-dt*dt*xpp/2+dt*dt*beta*xpp)/(beta*dt*dt);
-				double xpn = xp+dt*xpp+dt*gamma*(xppn-xpp);
-
-				x = xn;
-				xpp = xppn;
-				xp = xpn;
-
-				xn = fabs(x);
-
-				// Save max(fabs(x))
-				if ( xn > maxx ) maxx = xn;
-			}
-
-			spectrum[i].sd = maxx;
-			spectrum[i].psa = maxx*K;
-		}
-	}
-
-#ifndef CONTINUE_PROCESSING_WHEN_CHECK_FAILS
-	_processed = true;
-	setStatus(Finished, 100);
-#endif
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -1527,11 +2078,17 @@ void PGAV::init() {
 	setNonCausalFiltering(false, -1);
 	setPadLength(-1);
 	setClipTmaxToLowestFilterFrequency(true);
+	setResponseSpectrumMethod(Config::Newmark);
 
 	_config.saturationThreshold = -1;
 
 	_maximumRawValue = 0;
 	_force = false;
+	_deferred = false;
+	_pending = false;
+	_incremental = false;
+	_provisional = false;
+	_responseID.clear();
 	_loFilter = _hiFilter = 0;
 
 	computeTimeWindow();
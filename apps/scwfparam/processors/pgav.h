@@ -20,6 +20,8 @@
 
 #include <seiscomp/processing/amplitudeprocessor.h>
 
+#include <memory>
+
 
 namespace Seiscomp {
 namespace Processing {
@@ -29,6 +31,21 @@ DEFINE_SMARTPOINTER(PGAV);
 class PGAV : public TimeWindowProcessor {
 	public:
 		struct Config {
+			enum ResponseSpectrumMethod {
+				// Time domain integration of each oscillator
+				Newmark,
+				// Multiplication of the acceleration spectrum with the
+				// oscillator transfer function, one inverse transform per
+				// oscillator and therefore slower than Newmark
+				FFT
+			};
+
+			// Converts a string to a response spectrum method
+			// ("newmark" or "fft"). Returns false if the string is
+			// not a valid method.
+			static bool methodFromString(ResponseSpectrumMethod &method,
+			                             const std::string &str);
+
 			// Converts a string to a frequency value. "fNyquist" suffix is
 			// parsed and returns a negative value.
 			// Returns
@@ -75,6 +92,8 @@ class PGAV : public TimeWindowProcessor {
 			double  Tmax;
 			bool    clipTmax;
 			bool    fixedPeriods;
+
+			ResponseSpectrumMethod responseSpectrumMethod;
 		};
 
 
@@ -89,6 +108,28 @@ class PGAV : public TimeWindowProcessor {
 		typedef std::pair<double, ResponseSpectrum> DampingResponseSpectrum;
 		typedef std::list<DampingResponseSpectrum> ResponseSpectra;
 
+		//! Wall clock time in seconds spent in the stages of the last
+		//! processing of a complete time window
+		struct Timings {
+			Timings() { reset(); }
+
+			void reset() {
+				gain = stalta = fft = deconvolution = filter = spectra = other = 0;
+			}
+
+			double total() const {
+				return gain + stalta + fft + deconvolution + filter + spectra + other;
+			}
+
+			double gain;          //!< Data checks and gain correction
+			double stalta;        //!< STA/LTA check
+			double fft;           //!< Padding, tapering and transforms
+			double deconvolution; //!< Response evaluation and deconvolution
+			double filter;        //!< Post-deconvolution filter and filter
+			double spectra;       //!< Response spectra
+			double other;         //!< Duration, aftershock removal, PGA/PGV
+		};
+
 
 	public:
 		PGAV(const Seiscomp::Core::Time& trigger);
@@ -111,6 +152,12 @@ class PGAV : public TimeWindowProcessor {
 		                                   bool logarithmicSpacing);
 
 		void setCustomPeriods(const std::vector<double> &periods);
+		void setResponseSpectrumMethod(Config::ResponseSpectrumMethod method);
+
+		// Sets the publicID of the sensor response. If set, the evaluated
+		// response is shared with all processors using the same response
+		// through the ResponseCache.
+		void setResponseID(const std::string &id);
 
 		void setAftershockRemovalEnabled(bool);
 		void setPreEventCutOffEnabled(bool);
@@ -140,6 +187,25 @@ class PGAV : public TimeWindowProcessor {
 		// to use available data for processing
 		void finish();
 
+		// Enables deferred processing. If enabled, a complete time window
+		// is not processed while feeding data. Instead the processor is
+		// flagged as pending and processDeferred() must be called, e.g.
+		// from a worker thread.
+		void setDeferredProcessing(bool);
+
+		// Processes a pending time window. Does nothing if the processor
+		// is not pending.
+		void processDeferred();
+
+		// Enables incremental processing. If enabled, gain, STA/LTA, the
+		// causal filters, PGA/PGV and the oscillators are advanced with
+		// each record and provisional values are available before the
+		// time window is complete. Incremental processing is only
+		// supported with causal filtering and without deconvolution,
+		// otherwise it is ignored. The final values are always computed
+		// from the complete time window.
+		void setIncrementalProcessing(bool);
+
 		void computeTimeWindow();
 
 
@@ -147,6 +213,11 @@ class PGAV : public TimeWindowProcessor {
 		const Core::Time &trigger() const { return _trigger; }
 
 		bool processed() const { return _processed; }
+		bool isPending() const { return _pending; }
+
+		// Returns whether PGA(), PGV() and responseSpectra() hold
+		// provisional values of an incomplete time window
+		bool hasProvisionalValues() const { return _provisional; }
 		double maximumRawValue() const { return _maximumRawValue; }
 		double PGA() const { return _pga; }
 		double PGV() const { return _pgv; }
@@ -162,13 +233,19 @@ class PGAV : public TimeWindowProcessor {
 
 		const ResponseSpectra &responseSpectra() const;
 
+		const Timings &timings() const { return _timings; }
+
 
 	protected:
 		void process(const Record *record, const DoubleArray &filteredData);
 
 
 	private:
+		struct IncrementalState;
+
 		void init();
+		void computePeriods(std::vector<double> &T) const;
+		void updateIncremental(int ti, int noise0i, int sig1i);
 
 
 	private:
@@ -180,6 +257,7 @@ class PGAV : public TimeWindowProcessor {
 		OPT(double) _duration;
 		double      _pga, _pgv;
 		ResponseSpectra _responseSpectra;
+		Timings     _timings;
 
 		double      _loPDFilter;
 		double      _hiPDFilter;
@@ -187,10 +265,18 @@ class PGAV : public TimeWindowProcessor {
 		double      _loFilter;
 		double      _hiFilter;
 
+		std::string _responseID;
+
 		bool        _force;
+		bool        _deferred;
+		bool        _pending;
+		bool        _incremental;
+		bool        _provisional;
 		bool        _velocity;
 		bool        _processed;
 
+		std::unique_ptr<IncrementalState> _incrementalState;
+
 
 };
 
@@ -0,0 +1,141 @@
+/***************************************************************************
+ *   Copyright (C) by ETHZ/SED, GNS New Zealand, GeoScience Australia      *
+ *                                                                         *
+ * This program is free software: you can redistribute it and/or modify    *
+ * it under the terms of the GNU Affero General Public License as published*
+ * by the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                     *
+ *                                                                         *
+ * This program is distributed in the hope that it will be useful,         *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU Affero General Public License for more details.                     *
+ *                                                                         *
+ *   Developed by gempa GmbH                                               *
+ ***************************************************************************/
+
+
+#include "responsecache.h"
+
+#include <functional>
+
+
+namespace Seiscomp {
+namespace Processing {
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+size_t ResponseCache::KeyHash::operator()(const Key &key) const {
+	size_t h = std::hash<std::string>()(key.responseID);
+	h ^= std::hash<int>()(key.nfft) + 0x9e3779b9 + (h << 6) + (h >> 2);
+	h ^= std::hash<double>()(key.df) + 0x9e3779b9 + (h << 6) + (h >> 2);
+	return h;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+ResponseCache::ResponseCache()
+: _capacity(64*1024*1024), _used(0) {}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+ResponseCache &ResponseCache::Instance() {
+	static ResponseCache instance;
+	return instance;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void ResponseCache::setCapacity(size_t bytes) {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_capacity = bytes;
+	evict();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+ResponseCache::SpectrumCPtr
+ResponseCache::find(const std::string &responseID, int nfft, double df) {
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	Lookup::iterator it = _lookup.find(Key{responseID, nfft, df});
+	if ( it == _lookup.end() ) return nullptr;
+
+	// Move to front, the most recently used entry is evicted last
+	_entries.splice(_entries.begin(), _entries, it->second);
+	return it->second->second;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void ResponseCache::insert(const std::string &responseID, int nfft, double df,
+                           const SpectrumCPtr &spectrum) {
+	if ( !spectrum ) return;
+
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	if ( bytes(*spectrum) > _capacity ) return;
+
+	Key key{responseID, nfft, df};
+	Lookup::iterator it = _lookup.find(key);
+
+	// Another thread evaluated the same response in the meantime
+	if ( it != _lookup.end() ) {
+		_entries.splice(_entries.begin(), _entries, it->second);
+		return;
+	}
+
+	_entries.push_front(Entry(key, spectrum));
+	_lookup[key] = _entries.begin();
+	_used += bytes(*spectrum);
+
+	evict();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void ResponseCache::clear() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_lookup.clear();
+	_entries.clear();
+	_used = 0;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void ResponseCache::evict() {
+	while ( _used > _capacity && !_entries.empty() ) {
+		Entry &entry = _entries.back();
+		_used -= bytes(*entry.second);
+		_lookup.erase(entry.first);
+		_entries.pop_back();
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+}
+}
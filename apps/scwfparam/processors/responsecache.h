@@ -0,0 +1,115 @@
+/***************************************************************************
+ *   Copyright (C) by ETHZ/SED, GNS New Zealand, GeoScience Australia      *
+ *                                                                         *
+ * This program is free software: you can redistribute it and/or modify    *
+ * it under the terms of the GNU Affero General Public License as published*
+ * by the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                     *
+ *                                                                         *
+ * This program is distributed in the hope that it will be useful,         *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU Affero General Public License for more details.                     *
+ *                                                                         *
+ *   Developed by gempa GmbH                                               *
+ ***************************************************************************/
+
+
+#ifndef __SEISCOMP_PROCESSING_RESPONSECACHE_H__
+#define __SEISCOMP_PROCESSING_RESPONSECACHE_H__
+
+
+#include <seiscomp/math/math.h>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace Seiscomp {
+namespace Processing {
+
+
+/**
+ * @brief A process wide cache of evaluated inverse instrument responses.
+ *
+ * Entries are keyed by the response publicID, the FFT length and the
+ * frequency sampling interval and hold the factors a spectrum has to be
+ * multiplied with to deconvolve the response. The cache is bounded by
+ * the memory used by the spectra, the least recently used entries are
+ * evicted first. All methods are thread-safe.
+ */
+class ResponseCache {
+	public:
+		typedef std::vector<Math::Complex> Spectrum;
+		typedef std::shared_ptr<const Spectrum> SpectrumCPtr;
+
+
+	public:
+		//! Returns the global instance
+		static ResponseCache &Instance();
+
+
+	public:
+		//! Sets the maximum number of bytes used by the cached spectra. A
+		//! capacity of 0 disables the cache.
+		void setCapacity(size_t bytes);
+
+		//! Returns the cached spectrum or nullptr
+		SpectrumCPtr find(const std::string &responseID, int nfft, double df);
+
+		//! Adds a spectrum to the cache and evicts old entries if the
+		//! capacity is exceeded
+		void insert(const std::string &responseID, int nfft, double df,
+		            const SpectrumCPtr &spectrum);
+
+		//! Removes all entries
+		void clear();
+
+
+	private:
+		ResponseCache();
+
+		struct Key {
+			std::string responseID;
+			int         nfft;
+			double      df;
+
+			bool operator==(const Key &other) const {
+				return nfft == other.nfft && df == other.df &&
+				       responseID == other.responseID;
+			}
+		};
+
+		struct KeyHash {
+			size_t operator()(const Key &key) const;
+		};
+
+		typedef std::pair<Key, SpectrumCPtr> Entry;
+		typedef std::list<Entry> Entries;
+		typedef std::unordered_map<Key, Entries::iterator, KeyHash> Lookup;
+
+		static size_t bytes(const Spectrum &spectrum) {
+			return spectrum.size() * sizeof(Math::Complex);
+		}
+
+		void evict();
+
+
+	private:
+		std::mutex _mutex;
+		Entries    _entries;
+		Lookup     _lookup;
+		size_t     _capacity;
+		size_t     _used;
+};
+
+
+}
+}
+
+
+#endif
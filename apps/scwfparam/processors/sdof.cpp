@@ -0,0 +1,228 @@
+/***************************************************************************
+ *   Copyright (C) by ETHZ/SED, GNS New Zealand, GeoScience Australia      *
+ *                                                                         *
+ * This program is free software: you can redistribute it and/or modify    *
+ * it under the terms of the GNU Affero General Public License as published*
+ * by the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                     *
+ *                                                                         *
+ * This program is distributed in the hope that it will be useful,         *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU Affero General Public License for more details.                     *
+ *                                                                         *
+ *   Developed by gempa GmbH                                               *
+ ***************************************************************************/
+
+
+#include "sdof.h"
+
+#include <cmath>
+
+
+namespace Seiscomp {
+namespace Processing {
+
+
+namespace {
+
+
+// Newmark-beta parameters: average acceleration method
+const double Beta = 0.25;
+const double Gamma = 0.5;
+
+// Number of samples all blocks are advanced by before the next chunk of
+// the input is processed. The chunk stays in the L1 cache while it is
+// applied to all blocks.
+const int ChunkSize = 512;
+
+
+}
+
+
+const int OscillatorBank::Lanes;
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+OscillatorBank::OscillatorBank()
+: _count(0), _dt(0), _initialized(false) {}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void OscillatorBank::clear() {
+	_blocks.clear();
+	_count = 0;
+	_initialized = false;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void OscillatorBank::setSamplingInterval(double dt) {
+	_dt = dt;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+size_t OscillatorBank::add(double T, double zeta) {
+	double dt = _dt;
+	double K = (2*M_PI)/T;
+	double C = 2*zeta*K;
+	K *= K; // K = K^2
+
+	double B = 1.0/(Beta*dt*dt) + (Gamma*C)/(Beta*dt);
+	double A = B + K;
+	double E = 1.0/(Beta*dt) + (Gamma/Beta-1)*C;
+
+	size_t lane = _count % Lanes;
+
+	if ( lane == 0 ) {
+		// Initialize all lanes of a new block with the first oscillator to
+		// not integrate garbage in unused lanes
+		_blocks.resize(_blocks.size()+1);
+		Block &block = _blocks.back();
+		for ( int l = 0; l < Lanes; ++l ) {
+			block.A[l] = A;
+			block.B[l] = B;
+			block.E[l] = E;
+			block.K[l] = K;
+			block.x[l] = block.xp[l] = block.xpp[l] = block.maxx[l] = 0;
+		}
+	}
+	else {
+		Block &block = _blocks.back();
+		block.A[lane] = A;
+		block.B[lane] = B;
+		block.E[lane] = E;
+		block.K[lane] = K;
+	}
+
+	return _count++;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void OscillatorBank::reset() {
+	for ( auto &block : _blocks ) {
+		for ( int l = 0; l < Lanes; ++l )
+			block.x[l] = block.xp[l] = block.xpp[l] = block.maxx[l] = 0;
+	}
+
+	_initialized = false;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void OscillatorBank::feed(int n, const double *acc) {
+	if ( n <= 0 ) return;
+
+	if ( !_initialized ) {
+		// The oscillators start at rest: x = xp = 0 and the relative
+		// acceleration equals the negative ground acceleration
+		for ( auto &block : _blocks ) {
+			for ( int l = 0; l < Lanes; ++l )
+				block.xpp[l] = -acc[0];
+		}
+
+		_initialized = true;
+		++acc;
+		--n;
+	}
+
+	for ( int i = 0; i < n; i += ChunkSize ) {
+		int len = n - i < ChunkSize ? n - i : ChunkSize;
+		for ( auto &block : _blocks )
+			advance(block, len, acc + i);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+double OscillatorBank::maximumDisplacement(size_t i) const {
+	return _blocks[i / Lanes].maxx[i % Lanes];
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+double OscillatorBank::omega2(size_t i) const {
+	return _blocks[i / Lanes].K[i % Lanes];
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void OscillatorBank::advance(Block &block, int n, const double *acc) const {
+	const double dt = _dt;
+	const double G = 1.0/(2*Beta)-1.0;
+
+	// Work on local copies to let the compiler keep the state in registers
+	double A[Lanes], B[Lanes], E[Lanes];
+	double x[Lanes], xp[Lanes], xpp[Lanes], maxx[Lanes];
+
+	for ( int l = 0; l < Lanes; ++l ) {
+		A[l] = block.A[l];
+		B[l] = block.B[l];
+		E[l] = block.E[l];
+		x[l] = block.x[l];
+		xp[l] = block.xp[l];
+		xpp[l] = block.xpp[l];
+		maxx[l] = block.maxx[l];
+	}
+
+	for ( int j = 0; j < n; ++j ) {
+		// f = -f: thats why -acc[j] is used
+		const double f = -acc[j];
+
+		for ( int l = 0; l < Lanes; ++l ) {
+			double xn = (f+B[l]*x[l]+E[l]*xp[l]+G*xpp[l])/A[l];
+			double xppn = (xn-x[l]-dt*xp[l]-dt*dt*xpp[l]/2+dt*dt*Beta*xpp[l])/(Beta*dt*dt);
+			double xpn = xp[l]+dt*xpp[l]+dt*Gamma*(xppn-xpp[l]);
+
+			x[l] = xn;
+			xpp[l] = xppn;
+			xp[l] = xpn;
+
+			// Save max(fabs(x))
+			double ax = fabs(xn);
+			maxx[l] = ax > maxx[l] ? ax : maxx[l];
+		}
+	}
+
+	for ( int l = 0; l < Lanes; ++l ) {
+		block.x[l] = x[l];
+		block.xp[l] = xp[l];
+		block.xpp[l] = xpp[l];
+		block.maxx[l] = maxx[l];
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+}
+}
@@ -0,0 +1,117 @@
+/***************************************************************************
+ *   Copyright (C) by ETHZ/SED, GNS New Zealand, GeoScience Australia      *
+ *                                                                         *
+ * This program is free software: you can redistribute it and/or modify    *
+ * it under the terms of the GNU Affero General Public License as published*
+ * by the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                     *
+ *                                                                         *
+ * This program is distributed in the hope that it will be useful,         *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU Affero General Public License for more details.                     *
+ *                                                                         *
+ *   Developed by gempa GmbH                                               *
+ ***************************************************************************/
+
+
+#ifndef __SEISCOMP_PROCESSING_SDOF_H__
+#define __SEISCOMP_PROCESSING_SDOF_H__
+
+
+#include <vector>
+#include <cstddef>
+
+
+namespace Seiscomp {
+namespace Processing {
+
+
+/**
+ * @brief A bank of damped single degree of freedom oscillators driven by
+ *        the same ground acceleration.
+ *
+ * The oscillators are integrated with the Newmark-beta method (average
+ * acceleration, beta = 1/4, gamma = 1/2) and the maximum absolute relative
+ * displacement of each oscillator is tracked.
+ *
+ * The oscillator states are stored as structure of arrays in blocks of
+ * Lanes oscillators. Each sample is applied to all oscillators of a block
+ * in an inner loop without dependencies between iterations which compilers
+ * turn into SSE2/AVX/NEON instructions. The input is processed in chunks
+ * of samples: all blocks are advanced over a chunk before the next chunk
+ * is read, so the input is traversed once.
+ *
+ * Per oscillator, the arithmetic is exactly the same as the scalar
+ * recurrence formerly implemented in PGAV::process, hence results are
+ * identical as long as the compiler does not contract multiply-adds
+ * differently for the scalar and the vector code (-ffp-contract). If it
+ * does, the relative deviation of the maximum displacement stays below
+ * 1E-10 which is checked by test/oscillatorbank.cpp.
+ */
+class OscillatorBank {
+	public:
+		//! Number of oscillators advanced together
+		static const int Lanes = 4;
+
+
+	public:
+		OscillatorBank();
+
+
+	public:
+		//! Removes all oscillators
+		void clear();
+
+		//! Sets the sampling interval of the input acceleration. Must be
+		//! called before oscillators are added.
+		void setSamplingInterval(double dt);
+
+		//! Adds an oscillator with natural period T in seconds and damping
+		//! ratio zeta (not in percent). Returns the index of the oscillator.
+		size_t add(double T, double zeta);
+
+		//! Resets the state of all oscillators
+		void reset();
+
+		//! Advances all oscillators by n acceleration samples
+		void feed(int n, const double *acc);
+
+		//! Returns the number of oscillators
+		size_t size() const { return _count; }
+
+		//! Returns the maximum absolute displacement of oscillator i
+		double maximumDisplacement(size_t i) const;
+
+		//! Returns the squared natural angular frequency of oscillator i
+		double omega2(size_t i) const;
+
+
+	private:
+		struct Block {
+			double A[Lanes];
+			double B[Lanes];
+			double E[Lanes];
+			double K[Lanes];
+			double x[Lanes];
+			double xp[Lanes];
+			double xpp[Lanes];
+			double maxx[Lanes];
+		};
+
+		void advance(Block &block, int n, const double *acc) const;
+
+
+	private:
+		std::vector<Block> _blocks;
+		size_t             _count;
+		double             _dt;
+		bool               _initialized;
+};
+
+
+}
+}
+
+
+#endif
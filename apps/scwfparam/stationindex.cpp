@@ -0,0 +1,194 @@
+/***************************************************************************
+ *   Copyright (C) by ETHZ/SED, GNS New Zealand, GeoScience Australia      *
+ *                                                                         *
+ * This program is free software: you can redistribute it and/or modify    *
+ * it under the terms of the GNU Affero General Public License as published*
+ * by the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                     *
+ *                                                                         *
+ * This program is distributed in the hope that it will be useful,         *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU Affero General Public License for more details.                     *
+ *                                                                         *
+ *   Developed by gempa GmbH                                               *
+ ***************************************************************************/
+
+
+
+#include "stationindex.h"
+
+#include <seiscomp/datamodel/network.h>
+#include <seiscomp/datamodel/station.h>
+#include <seiscomp/math/geo.h>
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace Seiscomp {
+
+
+namespace {
+
+
+void toUnitVector(double lat, double lon, double *x) {
+	lat = lat * M_PI / 180.0;
+	lon = lon * M_PI / 180.0;
+	x[0] = cos(lat) * cos(lon);
+	x[1] = cos(lat) * sin(lon);
+	x[2] = sin(lat);
+}
+
+
+}
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+StationIndex::StationIndex() : _valid(false) {}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void StationIndex::build(DataModel::Inventory *inventory) {
+	_entries.clear();
+	_valid = true;
+
+	if ( !inventory ) return;
+
+	for ( size_t n = 0; n < inventory->networkCount(); ++n ) {
+		DataModel::Network *net = inventory->network(n);
+
+		for ( size_t s = 0; s < net->stationCount(); ++s ) {
+			DataModel::Station *sta = net->station(s);
+			Entry entry;
+
+			try {
+				toUnitVector(sta->latitude(), sta->longitude(), entry.x);
+			}
+			catch ( ... ) {
+				// Stations without coordinates cannot be selected
+				continue;
+			}
+
+			entry.order = _entries.size();
+			entry.start = std::max(net->start(), sta->start());
+			entry.hasEnd = false;
+
+			try {
+				entry.end = net->end();
+				entry.hasEnd = true;
+			}
+			catch ( ... ) {}
+
+			try {
+				if ( !entry.hasEnd || sta->end() < entry.end )
+					entry.end = sta->end();
+				entry.hasEnd = true;
+			}
+			catch ( ... ) {}
+
+			entry.network = net;
+			entry.station = sta;
+			_entries.push_back(entry);
+		}
+	}
+
+	build(0, _entries.size(), 0);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void StationIndex::invalidate() {
+	_entries.clear();
+	_valid = false;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void StationIndex::query(double lat, double lon, double radius,
+                         const Core::Time &time, Candidates &candidates) const {
+	double p[3];
+	toUnitVector(lat, lon, p);
+
+	// Squared chord length of the radius, enlarged slightly to not miss
+	// stations due to rounding. Radii beyond the antipode select everything.
+	double angle = Math::Geo::km2deg(radius) * M_PI / 180.0;
+	double maxDist2 = angle < M_PI ? 2.0 * sin(0.5 * angle) : 2.0;
+	maxDist2 = maxDist2 * maxDist2 + 1E-9;
+
+	std::vector<const Entry*> result;
+	search(0, _entries.size(), 0, p, maxDist2, time, result);
+
+	std::sort(result.begin(), result.end(),
+	          [](const Entry *a, const Entry *b) { return a->order < b->order; });
+
+	for ( const Entry *entry : result )
+		candidates.push_back(Candidate{entry->network, entry->station});
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void StationIndex::build(size_t begin, size_t end, int depth) {
+	if ( end - begin < 2 ) return;
+
+	// The median of the current axis becomes the node, the lower half
+	// the left and the upper half the right subtree
+	int axis = depth % 3;
+	size_t mid = begin + (end - begin) / 2;
+	std::nth_element(_entries.begin() + begin, _entries.begin() + mid,
+	                 _entries.begin() + end,
+	                 [axis](const Entry &a, const Entry &b) {
+		return a.x[axis] < b.x[axis];
+	});
+
+	build(begin, mid, depth + 1);
+	build(mid + 1, end, depth + 1);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void StationIndex::search(size_t begin, size_t end, int depth, const double *p,
+                          double maxDist2, const Core::Time &time,
+                          std::vector<const Entry*> &result) const {
+	if ( begin >= end ) return;
+
+	int axis = depth % 3;
+	size_t mid = begin + (end - begin) / 2;
+	const Entry &entry = _entries[mid];
+
+	double dx = p[0] - entry.x[0];
+	double dy = p[1] - entry.x[1];
+	double dz = p[2] - entry.x[2];
+
+	if ( dx*dx + dy*dy + dz*dz <= maxDist2 &&
+	     entry.start <= time && (!entry.hasEnd || entry.end >= time) )
+		result.push_back(&entry);
+
+	double diff = p[axis] - entry.x[axis];
+
+	if ( diff <= 0 || diff*diff <= maxDist2 )
+		search(begin, mid, depth + 1, p, maxDist2, time, result);
+	if ( diff >= 0 || diff*diff <= maxDist2 )
+		search(mid + 1, end, depth + 1, p, maxDist2, time, result);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+}
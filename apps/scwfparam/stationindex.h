@@ -0,0 +1,103 @@
+/***************************************************************************
+ *   Copyright (C) by ETHZ/SED, GNS New Zealand, GeoScience Australia      *
+ *                                                                         *
+ * This program is free software: you can redistribute it and/or modify    *
+ * it under the terms of the GNU Affero General Public License as published*
+ * by the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                     *
+ *                                                                         *
+ * This program is distributed in the hope that it will be useful,         *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU Affero General Public License for more details.                     *
+ *                                                                         *
+ *   Developed by gempa GmbH                                               *
+ ***************************************************************************/
+
+
+
+#ifndef __SEISCOMP_APPLICATIONS_WFPARAM_STATIONINDEX_H__
+#define __SEISCOMP_APPLICATIONS_WFPARAM_STATIONINDEX_H__
+
+
+#include <seiscomp/core/datetime.h>
+#include <seiscomp/datamodel/inventory.h>
+
+#include <vector>
+
+
+namespace Seiscomp {
+
+
+/**
+ * @brief A spatial index of the station epochs of an inventory.
+ *
+ * The station locations are stored as unit vectors in a k-d tree which
+ * allows to find all stations within an epicentral distance without
+ * computing the distance to each station of the inventory. The index
+ * keeps raw pointers to the inventory objects and must be rebuilt after
+ * the inventory has changed.
+ */
+class StationIndex {
+	public:
+		struct Candidate {
+			DataModel::Network *network;
+			DataModel::Station *station;
+		};
+
+		using Candidates = std::vector<Candidate>;
+
+
+	public:
+		StationIndex();
+
+
+	public:
+		//! Builds the index from all station epochs of an inventory
+		void build(DataModel::Inventory *inventory);
+
+		//! Marks the index as outdated
+		void invalidate();
+
+		//! Returns whether the index reflects the current inventory
+		bool isValid() const { return _valid; }
+
+		/**
+		 * @brief Collects the stations whose network and station epoch
+		 *        contain time and which are located within radius km
+		 *        around lat/lon. The candidates are returned in inventory
+		 *        order. Stations close to the radius may be returned
+		 *        although they are slightly outside, the caller is expected
+		 *        to check the exact distance.
+		 */
+		void query(double lat, double lon, double radius, const Core::Time &time,
+		           Candidates &candidates) const;
+
+
+	private:
+		struct Entry {
+			double              x[3];
+			size_t              order;
+			Core::Time          start;
+			Core::Time          end;
+			bool                hasEnd;
+			DataModel::Network *network;
+			DataModel::Station *station;
+		};
+
+		void build(size_t begin, size_t end, int depth);
+		void search(size_t begin, size_t end, int depth, const double *p,
+		            double maxDist2, const Core::Time &time,
+		            std::vector<const Entry*> &result) const;
+
+
+	private:
+		std::vector<Entry> _entries;
+		bool               _valid;
+};
+
+
+}
+
+
+#endif
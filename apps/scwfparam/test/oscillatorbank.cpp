@@ -0,0 +1,134 @@
+/***************************************************************************
+ *   Copyright (C) by ETHZ/SED, GNS New Zealand, GeoScience Australia      *
+ *                                                                         *
+ * This program is free software: you can redistribute it and/or modify    *
+ * it under the terms of the GNU Affero General Public License as published*
+ * by the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                     *
+ *                                                                         *
+ * This program is distributed in the hope that it will be useful,         *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU Affero General Public License for more details.                     *
+ *                                                                         *
+ *   Developed by gempa GmbH                                               *
+ ***************************************************************************/
+
+
+#include "processors/sdof.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+
+using namespace Seiscomp::Processing;
+
+
+namespace {
+
+
+// The scalar recurrence formerly implemented in PGAV::process
+double referenceMaximum(const std::vector<double> &data, double dt,
+                        double T, double zeta) {
+	double K = (2*M_PI)/T;
+	double C = 2*zeta*K;
+	double beta = 0.25;
+	double gamma = 0.5;
+	K *= K; // K = K^2
+
+	double B = 1.0/(beta*dt*dt) + (gamma*C)/(beta*dt);
+	double A = B + K;
+	double E = 1.0/(beta*dt) + (gamma/beta-1)*C;
+	double G = 1.0/(2*beta)-1.0;
+
+	double x = 0;
+	double xp = 0;
+	// f = -f: thats why -data[0] is used
+	double xpp = -data[0];
+	double maxx = x;
+
+	for ( size_t j = 1; j < data.size(); ++j ) {
+		// f = -f: thats why -data[j] is used
+		double xn = (-data[j]+B*x+E*xp+G*xpp)/A;
+		double xppn = (xn-x-dt*xp-dt*dt*xpp/2+dt*dt*beta*xpp)/(beta*dt*dt);
+		double xpn = xp+dt*xpp+dt*gamma*(xppn-xpp);
+
+		x = xn;
+		xpp = xppn;
+		xp = xpn;
+
+		xn = fabs(x);
+
+		// Save max(fabs(x))
+		if ( xn > maxx ) maxx = xn;
+	}
+
+	return maxx;
+}
+
+
+}
+
+
+int main(int, char **) {
+	const double dt = 0.01;
+	const double tolerance = 1E-10;
+
+	// A fixed trace: decaying sum of sines plus deterministic noise
+	std::vector<double> data(12000);
+	unsigned int seed = 12345;
+	for ( size_t i = 0; i < data.size(); ++i ) {
+		double t = i*dt;
+		seed = seed*1103515245 + 12345;
+		double noise = ((seed >> 16) & 0x7fff) / 32768.0 - 0.5;
+		data[i] = exp(-0.02*t) * (sin(2*M_PI*1.3*t) + 0.5*sin(2*M_PI*7.1*t))
+		        + 0.1*noise;
+	}
+
+	// A number of oscillators which leaves lanes of the last block unused
+	std::vector<double> periods;
+	for ( double T = 0.05; T < 10.0; T *= 1.17 )
+		periods.push_back(T);
+	const double dampings[] = { 0.02, 0.05, 0.2 };
+
+	OscillatorBank bank;
+	bank.setSamplingInterval(dt);
+	for ( double zeta : dampings )
+		for ( double T : periods )
+			bank.add(T, zeta);
+
+	// Feed in pieces which do not align with the internal chunks
+	const int pieces[] = { 1, 700, 3, 4096, 1500 };
+	size_t offset = 0;
+	for ( int n : pieces ) {
+		bank.feed(n, &data[offset]);
+		offset += n;
+	}
+	bank.feed(static_cast<int>(data.size() - offset), &data[offset]);
+
+	int errors = 0;
+	double maxDeviation = 0;
+	size_t oi = 0;
+	for ( double zeta : dampings ) {
+		for ( double T : periods ) {
+			double expected = referenceMaximum(data, dt, T, zeta);
+			double value = bank.maximumDisplacement(oi);
+			double deviation = fabs(value - expected) / expected;
+			if ( deviation > maxDeviation ) maxDeviation = deviation;
+
+			if ( !(deviation <= tolerance) ) {
+				fprintf(stderr, "T = %g, zeta = %g: %.17g != %.17g\n",
+				        T, zeta, value, expected);
+				++errors;
+			}
+
+			++oi;
+		}
+	}
+
+	fprintf(stderr, "%d oscillators, max relative deviation %g\n",
+	        static_cast<int>(bank.size()), maxDeviation);
+
+	return errors ? 1 : 0;
+}
@@ -47,6 +47,7 @@ struct PGAVResult {
 
 	bool             processed;
 	bool             valid;
+	bool             provisional;
 	bool             isVelocity;
 	bool             isVertical;
 	bool             isAcausal;
@@ -0,0 +1,194 @@
+/***************************************************************************
+ *   Copyright (C) by ETHZ/SED, GNS New Zealand, GeoScience Australia      *
+ *                                                                         *
+ * This program is free software: you can redistribute it and/or modify    *
+ * it under the terms of the GNU Affero General Public License as published*
+ * by the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                     *
+ *                                                                         *
+ * This program is distributed in the hope that it will be useful,         *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU Affero General Public License for more details.                     *
+ *                                                                         *
+ *   Developed by gempa GmbH                                               *
+ ***************************************************************************/
+
+
+
+#include "waveformcache.h"
+
+#include <algorithm>
+
+
+namespace Seiscomp {
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+WaveformCache::WaveformCache()
+: _capacity(0), _used(0) {}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WaveformCache::setCapacity(size_t bytes) {
+	_capacity = bytes;
+
+	while ( _used > _capacity && !_lru.empty() )
+		erase(_entries.find(_lru.back()));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+Core::Time WaveformCache::lookup(const std::string &streamID,
+                                 const Core::TimeWindow &tw,
+                                 Records &records) {
+	Entries::iterator it = _entries.find(streamID);
+	if ( it == _entries.end() ) return tw.startTime();
+
+	Entry &entry = it->second;
+
+	// Only windows starting inside the cached span can be continued
+	// seamlessly by a request of the remaining part
+	if ( tw.startTime() < entry.coverage.startTime() ||
+	     tw.startTime() >= entry.coverage.endTime() )
+		return tw.startTime();
+
+	touch(entry);
+
+	for ( const RecordPtr &rec : entry.records ) {
+		if ( rec->endTime() <= tw.startTime() ) continue;
+		if ( rec->startTime() >= tw.endTime() ) break;
+		records.push_back(rec);
+	}
+
+	return std::min(entry.coverage.endTime(), tw.endTime());
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WaveformCache::feed(Record *rec) {
+	if ( _capacity == 0 || !rec->data() ) return;
+
+	size_t recBytes = bytes(rec);
+	if ( recBytes > _capacity ) return;
+
+	std::pair<Entries::iterator, bool> itp;
+	itp = _entries.insert(Entries::value_type(rec->streamID(), Entry()));
+	Entry &entry = itp.first->second;
+
+	if ( itp.second ) {
+		_lru.push_front(rec->streamID());
+		entry.lru = _lru.begin();
+		entry.bytes = 0;
+	}
+	else {
+		// Already cached or older than the cached span
+		if ( rec->endTime() <= entry.coverage.endTime() ) return;
+
+		Core::TimeSpan tolerance;
+		if ( rec->samplingFrequency() > 0 )
+			tolerance = Core::TimeSpan(0.5 / rec->samplingFrequency());
+
+		// A gap: start a new span with the more recent data
+		if ( rec->startTime() > entry.coverage.endTime() + tolerance ) {
+			_used -= entry.bytes;
+			entry.bytes = 0;
+			entry.records.clear();
+		}
+
+		touch(entry);
+	}
+
+	if ( entry.records.empty() )
+		entry.coverage.setStartTime(rec->startTime());
+	entry.coverage.setEndTime(rec->endTime());
+
+	entry.records.push_back(rec);
+	entry.bytes += recBytes;
+	_used += recBytes;
+
+	evict(entry);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WaveformCache::clear() {
+	_entries.clear();
+	_lru.clear();
+	_used = 0;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+size_t WaveformCache::bytes(const Record *rec) {
+	size_t bytes = sizeof(Record);
+
+	if ( rec->data() )
+		bytes += rec->data()->size() * rec->data()->elementSize();
+	if ( rec->raw() )
+		bytes += rec->raw()->size() * rec->raw()->elementSize();
+
+	return bytes;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WaveformCache::touch(Entry &entry) {
+	_lru.splice(_lru.begin(), _lru, entry.lru);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WaveformCache::erase(Entries::iterator it) {
+	_used -= it->second.bytes;
+	_lru.erase(it->second.lru);
+	_entries.erase(it);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WaveformCache::evict(Entry &current) {
+	// Drop the least recently used streams first, current is the most
+	// recently used one
+	while ( _used > _capacity && _lru.back() != *current.lru )
+		erase(_entries.find(_lru.back()));
+
+	// Still too large: drop the oldest records of the current stream
+	while ( _used > _capacity && current.records.size() > 1 ) {
+		size_t recBytes = bytes(current.records.front().get());
+		current.records.pop_front();
+		current.bytes -= recBytes;
+		_used -= recBytes;
+		current.coverage.setStartTime(current.records.front()->startTime());
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+}
@@ -0,0 +1,108 @@
+/***************************************************************************
+ *   Copyright (C) by ETHZ/SED, GNS New Zealand, GeoScience Australia      *
+ *                                                                         *
+ * This program is free software: you can redistribute it and/or modify    *
+ * it under the terms of the GNU Affero General Public License as published*
+ * by the Free Software Foundation, either version 3 of the License, or    *
+ * (at your option) any later version.                                     *
+ *                                                                         *
+ * This program is distributed in the hope that it will be useful,         *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of          *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the           *
+ * GNU Affero General Public License for more details.                     *
+ *                                                                         *
+ *   Developed by gempa GmbH                                               *
+ ***************************************************************************/
+
+
+
+#ifndef __SEISCOMP_APPLICATIONS_WFPARAM_WAVEFORMCACHE_H__
+#define __SEISCOMP_APPLICATIONS_WFPARAM_WAVEFORMCACHE_H__
+
+
+#include <seiscomp/core/record.h>
+#include <seiscomp/core/timewindow.h>
+
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace Seiscomp {
+
+
+/**
+ * @brief A bounded in-memory store of recently acquired records.
+ *
+ * For each stream the cache keeps the records of one contiguous time span.
+ * Cron re-runs and overlapping events request largely the same time windows,
+ * those parts are served from the cache and only the remainder has to be
+ * fetched from the record source. If the memory used by the records exceeds
+ * the capacity the least recently used streams are dropped. The cache is
+ * not thread-safe.
+ */
+class WaveformCache {
+	public:
+		using Records = std::vector<RecordPtr>;
+
+
+	public:
+		WaveformCache();
+
+
+	public:
+		//! Sets the maximum number of bytes used by the cached records. A
+		//! capacity of 0 disables the cache.
+		void setCapacity(size_t bytes);
+
+		/**
+		 * @brief Looks up the cached records of a time window.
+		 * @param streamID The stream id, NET.STA.LOC.CHA
+		 * @param tw The requested time window
+		 * @param records The records overlapping the cached part of the
+		 *                time window are appended to this list
+		 * @return The time up to which the window is served from the cache.
+		 *         If the start of the window is not cached, the start time
+		 *         is returned and no records are added.
+		 */
+		Core::Time lookup(const std::string &streamID,
+		                  const Core::TimeWindow &tw, Records &records);
+
+		//! Adds a record received from the record source
+		void feed(Record *rec);
+
+		//! Removes all records
+		void clear();
+
+
+	private:
+		struct Entry {
+			Core::TimeWindow              coverage;
+			std::deque<RecordPtr>         records;
+			size_t                        bytes;
+			std::list<std::string>::iterator lru;
+		};
+
+		using Entries = std::map<std::string, Entry>;
+
+		static size_t bytes(const Record *rec);
+
+		void touch(Entry &entry);
+		void erase(Entries::iterator it);
+		void evict(Entry &current);
+
+
+	private:
+		Entries                _entries;
+		std::list<std::string> _lru;
+		size_t                 _capacity;
+		size_t                 _used;
+};
+
+
+}
+
+
+#endif
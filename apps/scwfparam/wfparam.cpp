@@ -18,14 +18,17 @@
 #include "wfparam.h"
 #include "util.h"
 #include "msg.h"
+#include "processors/responsecache.h"
 
 #include <seiscomp/logging/output/filerotator.h>
 #include <seiscomp/logging/channel.h>
+#include <seiscomp/core/datamessage.h>
 
 #include <seiscomp/core/genericrecord.h>
 
 #include <seiscomp/client/inventory.h>
 #include <seiscomp/io/archive/xmlarchive.h>
+#include <seiscomp/io/recordinput.h>
 #include <seiscomp/io/records/mseedrecord.h>
 
 #include <seiscomp/datamodel/event.h>
@@ -36,6 +39,9 @@
 #include <seiscomp/datamodel/parameter.h>
 #include <seiscomp/datamodel/parameterset.h>
 #include <seiscomp/datamodel/journalentry.h>
+#include <seiscomp/datamodel/comment.h>
+#include <seiscomp/datamodel/network.h>
+#include <seiscomp/datamodel/station.h>
 #include <seiscomp/datamodel/utils.h>
 
 #include <seiscomp/math/geo.h>
@@ -165,7 +171,8 @@ string toXML(const string &input) {
 
 
 enum MyNotifications {
-	AcquisitionFinished  = -1
+	RecordAvailable      = -1,
+	ProcessingFinished   = -2
 };
 
 
@@ -203,6 +210,50 @@ pid_t startExternalProcess(const vector<string> &cmdparams) {
 }
 
 
+// Adds the time spent in a scope to a counter
+struct ScopedTimer {
+	explicit ScopedTimer(double &c) : counter(c) {}
+	~ScopedTimer() { counter += (double)watch.elapsed(); }
+
+	double          &counter;
+	Util::StopWatch  watch;
+};
+
+
+// Writes a latency as JSON number, null if the stage has not been reached
+void writeJSONLatency(ostream &os, const char *name, double value) {
+	os << ",\"" << name << "\":";
+	if ( value < 0 )
+		os << "null";
+	else
+		os << value;
+}
+
+
+// Writes the processing stage times as JSON members
+void writeJSONTimings(ostream &os, const PGAV::Timings &timings) {
+	os << "\"gain\":" << timings.gain
+	   << ",\"stalta\":" << timings.stalta
+	   << ",\"fft\":" << timings.fft
+	   << ",\"deconvolution\":" << timings.deconvolution
+	   << ",\"filter\":" << timings.filter
+	   << ",\"spectra\":" << timings.spectra
+	   << ",\"other\":" << timings.other
+	   << ",\"total\":" << timings.total();
+}
+
+
+string escapeJSON(const string &str) {
+	string res;
+	for ( char c : str ) {
+		if ( c == '"' || c == '\\' ) res += '\\';
+		if ( static_cast<unsigned char>(c) < 0x20 ) continue;
+		res += c;
+	}
+	return res;
+}
+
+
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -212,6 +263,7 @@ pid_t startExternalProcess(const vector<string> &cmdparams) {
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 WFParam::Config::Config() {
 	processingLogfile = "@LOGDIR@/scwfparam-processing-info";
+	metricsGroup = "STATUS_GROUP";
 
 	totalTimeWindowLength = 360;
 	preEventWindowLength = 60;
@@ -232,6 +284,8 @@ WFParam::Config::Config() {
 	Tmin = 0;
 	Tmax = 5;
 	clipTmax = true;
+	responseSpectrumMethodStr = "newmark";
+	responseSpectrumMethod = PGAV::Config::Newmark;
 
 	afterShockRemoval = true;
 	eventCutOff = true;
@@ -249,6 +303,8 @@ WFParam::Config::Config() {
 	PDfilter.second = 0;
 
 	enableDeconvolution = true;
+	responseCacheSize = 64;
+	waveformCacheSize = 128;
 	enableNonCausalFilters = false;
 	taperLength = -1;
 	padLength = -1;
@@ -274,6 +330,7 @@ WFParam::Config::Config() {
 
 	initialAcquisitionTimeout = 30;
 	runningAcquisitionTimeout = 2;
+	concurrentAcquisitions = 1;
 
 	eventMaxIdleTime = 3600;
 
@@ -286,6 +343,9 @@ WFParam::Config::Config() {
 	saveSpectraFiles = false;
 	enableMessagingOutput = false;
 
+	processingThreads = 0;
+	incrementalProcessing = false;
+
 	saturationThreshold = 80;
 
 	updateDelay = 60;
@@ -325,6 +385,9 @@ bool WFParam::CompareWaveformStreamID::operator()(
 bool WFParam::Process::hasBeenProcessed(DataModel::Stream *stream) const {
 	PGAVResults::const_iterator it;
 	for ( it = results.begin(); it != results.end(); ++it ) {
+		// Provisional results are replaced by the final ones
+		if ( it->provisional ) continue;
+
 		if ( it->streamID.networkCode() != stream->sensorLocation()->station()->network()->code() )
 			continue;
 
@@ -368,8 +431,8 @@ WFParam::WFParam(int argc, char **argv) : Application(argc, argv) {
 
 	_processingInfoChannel = nullptr;
 	_processingInfoOutput = nullptr;
+	_outputMetrics = nullptr;
 
-	_acquisitionTimeout = 0;
 	_wantShakeMapPGA = true;
 	_wantShakeMapPGV = true;
 	_wantShakeMapPSAPeriods.push_back(PeriodID("psa03", 0.3));
@@ -377,6 +440,8 @@ WFParam::WFParam(int argc, char **argv) : Application(argc, argv) {
 	_wantShakeMapPSAPeriods.push_back(PeriodID("psa30", 3.0));
 
 	NEW_OPT(_config.processingLogfile, "wfparam.logfile");
+	NEW_OPT(_config.metricsFile, "wfparam.metrics");
+	NEW_OPT(_config.metricsGroup, "wfparam.metricsGroup");
 	NEW_OPT(_config.streamsWhiteList, "wfparam.streams.whitelist");
 	NEW_OPT(_config.streamsBlackList, "wfparam.streams.blacklist");
 	NEW_OPT(_config.totalTimeWindowLength, "wfparam.totalTimeWindowLength");
@@ -398,6 +463,7 @@ WFParam::WFParam(int argc, char **argv) : Application(argc, argv) {
 	NEW_OPT(_config.Tmin, "wfparam.Tmin");
 	NEW_OPT(_config.Tmax, "wfparam.Tmax");
 	NEW_OPT(_config.clipTmax, "wfparam.clipTmax");
+	NEW_OPT(_config.responseSpectrumMethodStr, "wfparam.responseSpectrum.method");
 	NEW_OPT(_config.afterShockRemoval, "wfparam.afterShockRemoval");
 	NEW_OPT(_config.eventCutOff, "wfparam.eventCutOff");
 	NEW_OPT(_config.order, "wfparam.filter.order",
@@ -413,9 +479,13 @@ WFParam::WFParam(int argc, char **argv) : Application(argc, argv) {
 	NEW_OPT_FREQ(_config.PDfilter.second, "wfparam.pd.hiFreq",
 	             "Mode", "pd-hi-filter", "post deconvolution low-pass filter frequency");
 	NEW_OPT(_config.enableDeconvolution, "wfparam.deconvolution");
+	NEW_OPT(_config.responseCacheSize, "wfparam.responseCacheSize");
+	NEW_OPT(_config.waveformCacheSize, "wfparam.waveformCacheSize");
 	NEW_OPT(_config.enableNonCausalFilters, "wfparam.filtering.noncausal");
 	NEW_OPT(_config.taperLength, "wfparam.filtering.taperLength");
 	NEW_OPT(_config.padLength, "wfparam.filtering.padLength");
+	NEW_OPT(_config.processingThreads, "wfparam.processing.threads");
+	NEW_OPT(_config.incrementalProcessing, "wfparam.processing.incremental");
 	NEW_OPT(_config.wakeupInterval, "wfparam.cron.wakeupInterval");
 	NEW_OPT(_config.eventMaxIdleTime, "wfparam.cron.eventMaxIdleTime");
 	NEW_OPT(_config.logCrontab, "wfparam.cron.logging");
@@ -423,6 +493,7 @@ WFParam::WFParam(int argc, char **argv) : Application(argc, argv) {
 	NEW_OPT(_config.delayTimes, "wfparam.cron.delayTimes");
 	NEW_OPT(_config.initialAcquisitionTimeout, "wfparam.acquisition.initialTimeout");
 	NEW_OPT(_config.runningAcquisitionTimeout, "wfparam.acquisition.runningTimeout");
+	NEW_OPT(_config.concurrentAcquisitions, "wfparam.acquisition.concurrentEvents");
 	NEW_OPT(_config.enableMessagingOutput, "wfparam.output.messaging");
 	NEW_OPT(_config.saveProcessedWaveforms, "wfparam.output.waveforms.enable");
 	NEW_OPT(_config.waveformOutputPath, "wfparam.output.waveforms.path");
@@ -554,6 +625,21 @@ bool WFParam::validateParameters() {
 		_config.customPeriods.clear();
 	}
 
+	if ( !PGAV::Config::methodFromString(_config.responseSpectrumMethod,
+	                                     _config.responseSpectrumMethodStr) ) {
+		SEISCOMP_ERROR("wfparam.responseSpectrum.method: "
+		               "expected either 'newmark' or 'fft', got '%s'",
+		               _config.responseSpectrumMethodStr.c_str());
+		return false;
+	}
+
+	if ( _config.concurrentAcquisitions < 1 ) {
+		SEISCOMP_ERROR("wfparam.acquisition.concurrentEvents: "
+		               "expected a value >= 1, got %d",
+		               _config.concurrentAcquisitions);
+		return false;
+	}
+
 	if ( _config.offline )
 		// If the inventory is provided by an XML file and
 		// an event XML is provided, disable the database
@@ -685,6 +771,8 @@ bool WFParam::validateParameters() {
 
 	// Resolve placeholders
 	_config.processingLogfile = Environment::Instance()->absolutePath(_config.processingLogfile);
+	if ( !_config.metricsFile.empty() )
+		_config.metricsFile = Environment::Instance()->absolutePath(_config.metricsFile);
 	_config.shakeMap.output.script = Environment::Instance()->absolutePath(_config.shakeMap.output.script);
 	if ( _config.shakeMap.output.path != "-" ) {
 		_config.shakeMap.output.path = Environment::Instance()->absolutePath(_config.shakeMap.output.path);
@@ -828,9 +916,6 @@ bool WFParam::init() {
 		}
 	}
 
-	if ( _config.dumpRecords )
-		setRecordInputHint(Record::Hint(Record::SAVE_RAW));
-
 	if ( !_config.eventParameterFile.empty() ) {
 		IO::XMLArchive ar;
 		if ( !ar.open(_config.eventParameterFile.c_str()) ) {
@@ -852,9 +937,36 @@ bool WFParam::init() {
 
 	_processingInfoOutput->subscribe(_processingInfoChannel);
 
+	if ( !_config.metricsFile.empty() ) {
+		_metricsOutput.open(_config.metricsFile.c_str(), ios_base::out | ios_base::app);
+		if ( !_metricsOutput.is_open() ) {
+			SEISCOMP_ERROR("Unable to open metrics file %s", _config.metricsFile.c_str());
+			return false;
+		}
+
+		SEISCOMP_INFO("Metrics log: %s", _config.metricsFile.c_str());
+	}
+
+	if ( !_config.metricsGroup.empty() && connection() )
+		_outputMetrics = addOutputObjectLog("metrics", _config.metricsGroup);
+
 	_cache.setTimeSpan(Core::TimeSpan(_config.fExpiry*3600.));
 	_cache.setDatabaseArchive(query());
 
+	ResponseCache::Instance().setCapacity(
+		static_cast<size_t>(std::max(0.0, _config.responseCacheSize) * 1024 * 1024)
+	);
+
+	_waveformCache.setCapacity(
+		static_cast<size_t>(std::max(0.0, _config.waveformCacheSize) * 1024 * 1024)
+	);
+
+	if ( _config.processingThreads > 0 ) {
+		SEISCOMP_INFO("Processing time windows with %d worker threads",
+		              _config.processingThreads);
+		_workerPool.reset(new WorkerPool(_config.processingThreads));
+	}
+
 	// Check each 10 seconds if a new job needs to be started
 	enableTimer(1);
 	_cronCounter = _config.wakeupInterval;
@@ -897,6 +1009,13 @@ bool WFParam::run() {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void WFParam::done() {
+	// Let the workers finish their jobs before shutting down. The jobs
+	// refer to the deferred jobs of the acquisitions which are released
+	// by stopAcquisitions.
+	_workerPool.reset();
+
+	stopAcquisitions();
+
 	Application::done();
 
 	// Remove crontab log file if exists
@@ -937,6 +1056,11 @@ void WFParam::addObject(const string& parentID, DataModel::Object* object) {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void WFParam::updateObject(const string &parentID, Object* object) {
+	if ( Network::Cast(object) || Station::Cast(object) ) {
+		_stationIndex.invalidate();
+		return;
+	}
+
 	Pick *pick = Pick::Cast(object);
 	if ( pick ) {
 		feed(pick);
@@ -967,6 +1091,18 @@ void WFParam::updateObject(const string &parentID, Object* object) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WFParam::removeObject(const string &parentID, Object* object) {
+	// The index holds pointers to the inventory objects, rebuild it before
+	// the next use
+	if ( Network::Cast(object) || Station::Cast(object) )
+		_stationIndex.invalidate();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void WFParam::handleTimeout() {
 	--_cronCounter;
@@ -1036,15 +1172,24 @@ void WFParam::handleTimeout() {
 			++it;
 		}
 
-		// Process event queue if no acquisition thread is currently running
-		if ( !isRecordThreadActive() && !_processQueue.empty() ) {
-			ProcessPtr proc = _processQueue.front();
-			_processQueue.pop_front();
+		// Start queued processes in order as long as acquisition slots are
+		// available. A process with a running acquisition stays in the
+		// queue until its acquisition has finished.
+		for ( auto it = _processQueue.begin(); it != _processQueue.end(); ) {
+			if ( (int)_acquisitions.size() >= _config.concurrentAcquisitions ) {
+				SEISCOMP_DEBUG("All acquisition slots in use, starting next process deferred");
+				break;
+			}
+
+			ProcessPtr proc = *it;
+			if ( isAcquiring(proc.get()) ) {
+				++it;
+				continue;
+			}
+
+			it = _processQueue.erase(it);
 			startProcess(proc.get());
 		}
-		else if ( isRecordThreadActive() && !_processQueue.empty() ) {
-			SEISCOMP_DEBUG("Acquistion active, starting next process deferred");
-		}
 
 		// Dump crontab if activated
 		if ( _config.logCrontab ) {
@@ -1063,28 +1208,32 @@ void WFParam::handleTimeout() {
 			}
 
 			// Dump process queue if not empty
-			if ( !_processQueue.empty() || _currentProcess ) {
+			if ( !_processQueue.empty() || !_acquisitions.empty() ) {
 				of << endl << "[Queue]" << endl;
 
 				ProcessQueue::iterator it;
 				for ( it = _processQueue.begin(); it != _processQueue.end(); ++it )
 					of << "WAITING            \t" << (*it)->event->publicID() << endl;
-				if ( _currentProcess )
-					of << "RUNNING            \t" << _currentProcess->event->publicID() << endl;
+				for ( auto &acq : _acquisitions )
+					of << "RUNNING            \t" << acq->process->event->publicID() << endl;
 			}
 		}
 
-		if ( _config.offline && !isRecordThreadActive() )
+		if ( _config.offline && _acquisitions.empty() )
 			quit();
 	}
 
-	// Check acquisition timeout
-	if ( recordStream() && _acquisitionTimeout > 0 ) {
-		if ( _noDataTimer.elapsed().seconds() >= _acquisitionTimeout ) {
-			SEISCOMP_INFO("Data acquisition timeout: %d >= %d",
-			              (int)_noDataTimer.elapsed().seconds(),
-			              (int)_acquisitionTimeout);
-			recordStream()->close();
+	// Check acquisition timeouts
+	for ( auto &acq : _acquisitions ) {
+		if ( acq->stream && acq->timeout > 0 ) {
+			if ( acq->noDataTimer.elapsed().seconds() >= acq->timeout ) {
+				SEISCOMP_INFO("Data acquisition timeout: %d >= %d",
+				              (int)acq->noDataTimer.elapsed().seconds(),
+				              (int)acq->timeout);
+				acq->stream->close();
+				// Do not close the stream again
+				acq->timeout = 0;
+			}
 		}
 	}
 }
@@ -1233,7 +1382,10 @@ bool WFParam::addProcess(DataModel::Event *evt) {
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 bool WFParam::startProcess(Process *proc) {
 	SEISCOMP_DEBUG("Starting process [%s]", proc->event->publicID().c_str());
-	_currentProcess = proc;
+	AcquisitionPtr acq = new Acquisition;
+	acq->process = proc;
+	activate(acq.get());
+
 	_currentProcess->newValidResults = 0;
 	// Now is set in handleTimeout before calling this method
 	_currentProcess->lastRun = *now;
@@ -1250,22 +1402,23 @@ bool WFParam::startProcess(Process *proc) {
 		else {
 			SEISCOMP_DEBUG("Processing remaining channels, process magnitude = %.2f, current magnitude = %.2f",
 			               *proc->lastMagnitude, mval);
+
+			// Remove provisional results of incomplete time windows,
+			// they are recomputed in this run
+			proc->results.remove_if([](const PGAVResult &res) {
+				return res.provisional;
+			});
 		}
 	}
-	else
-		return false;
-
-	if ( !handle(proc->event.get()) ) {
-		_currentProcess = nullptr;
+	else {
+		activate(nullptr);
 		return false;
 	}
 
-	if ( !isRecordThreadActive() ) {
-		_currentProcess = nullptr;
-		return false;
-	}
+	bool started = handle(proc->event.get()) && acq->thread.joinable();
+	activate(nullptr);
 
-	return true;
+	return started;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -1314,25 +1467,25 @@ bool WFParam::handle(Seiscomp::DataModel::Event *evt) {
 	}
 
 	// Copy default values
-	_maximumEpicentralDistance = _config.maximumEpicentralDistance;
-	_totalTimeWindowLength = _config.totalTimeWindowLength;
-	_filter = _config.filter;
+	_acquisition->maximumEpicentralDistance = _config.maximumEpicentralDistance;
+	_acquisition->totalTimeWindowLength = _config.totalTimeWindowLength;
+	_acquisition->filter = _config.filter;
 
 	MagnitudePtr mag = _cache.get<Magnitude>(evt->preferredMagnitudeID());
 	if ( mag ) {
 		try {
 			// Load magnitude dependent maximum distance
-			getValue(_maximumEpicentralDistance,
+			getValue(_acquisition->maximumEpicentralDistance,
 			         _config.magnitudeDistanceTable,
 			         mag->magnitude().value());
 
 			// Load magnitude dependent maximum time window
-			getValue(_totalTimeWindowLength,
+			getValue(_acquisition->totalTimeWindowLength,
 			         _config.magnitudeTimeWindowTable,
 			         mag->magnitude().value());
 
 			// Load magnitude dependent filter settings
-			getValue(_filter, _config.magnitudeFilterTable,
+			getValue(_acquisition->filter, _config.magnitudeFilterTable,
 			         mag->magnitude().value());
 		}
 		catch ( ... ) {}
@@ -1349,12 +1502,17 @@ bool WFParam::handle(Seiscomp::DataModel::Event *evt) {
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 bool WFParam::handle(Seiscomp::DataModel::Origin *org) {
+	AcquisitionPtr acq = new Acquisition;
+	activate(acq.get());
+
 	// Copy default values
-	_maximumEpicentralDistance = _config.maximumEpicentralDistance;
-	_totalTimeWindowLength = _config.totalTimeWindowLength;
-	_currentProcess = nullptr;
+	_acquisition->maximumEpicentralDistance = _config.maximumEpicentralDistance;
+	_acquisition->totalTimeWindowLength = _config.totalTimeWindowLength;
+	_acquisition->filter = _config.filter;
 
 	process(org);
+
+	activate(nullptr);
 	return true;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
@@ -1387,16 +1545,16 @@ void WFParam::process(Origin *origin) {
 	}
 
 	// Clear all processors
-	_processors.clear();
+	_acquisition->processors.clear();
 
 	// Clear all station time windows
-	_stationRequests.clear();
+	_acquisition->stationRequests.clear();
 
-	if ( !recordStream() ) {
-		if ( !openStream() ) {
-			SEISCOMP_ERROR("%s: unable to open stream", recordStreamURL().c_str());
-			return;
-		}
+	// Each acquisition reads its data through its own stream
+	_acquisition->stream = IO::RecordStream::Open(recordStreamURL().c_str());
+	if ( !_acquisition->stream ) {
+		SEISCOMP_ERROR("%s: unable to open stream", recordStreamURL().c_str());
+		return;
 	}
 
 	// Typedef a pickmap entry containing the pick and
@@ -1411,9 +1569,9 @@ void WFParam::process(Origin *origin) {
 	PickStreamMap pickStreamMap;
 
 	try {
-		_originTime = origin->time().value();
-		_latitude = origin->latitude().value();
-		_longitude = origin->longitude().value();
+		_acquisition->originTime = origin->time().value();
+		_acquisition->latitude = origin->latitude().value();
+		_acquisition->longitude = origin->longitude().value();
 	}
 	catch ( ... ) {
 		SEISCOMP_WARNING("Ignoring origin %s with unset lat/lon or time",
@@ -1421,32 +1579,32 @@ void WFParam::process(Origin *origin) {
 		return;
 	}
 
-	try { _depth = origin->depth().value(); }
-	catch ( ... ) { _depth = 10; }
+	try { _acquisition->depth = origin->depth().value(); }
+	catch ( ... ) { _acquisition->depth = 10; }
 
-	_report << endl;
-	_report << "Processing report for event: " << _currentProcess->event->publicID() << endl;
-	_report << "-----------------------------------------------------------------" << endl;
-	_report << " + Hypocenter" << endl;
-	_report << "   + origin " << origin->publicID() << endl;
-	_report << " + Parameters" << endl;
+	_acquisition->report << endl;
+	_acquisition->report << "Processing report for event: " << _currentProcess->event->publicID() << endl;
+	_acquisition->report << "-----------------------------------------------------------------" << endl;
+	_acquisition->report << " + Hypocenter" << endl;
+	_acquisition->report << "   + origin " << origin->publicID() << endl;
+	_acquisition->report << " + Parameters" << endl;
 	if ( _currentProcess->lastMagnitude ) {
-		_report << "   + magnitude = " << *_currentProcess->lastMagnitude << endl;
+		_acquisition->report << "   + magnitude = " << *_currentProcess->lastMagnitude << endl;
 	}
 	else {
-		_report << "   + magnitude is none" << endl;
+		_acquisition->report << "   + magnitude is none" << endl;
 	}
-	_report << "   + saturation threshold = " << _config.saturationThreshold << "% of 2**23" << endl;
-	_report << "   + maximum epicentral distance = " << _maximumEpicentralDistance << "km" << endl;
-	_report << "   + pre event window length = " << _config.preEventWindowLength << "s" << endl;
-	_report << "   + total time window length = " << _totalTimeWindowLength << "s" << endl;
-	_report << "   + sta/lta/ratio = " << _config.STAlength << "/"
-	                             << _config.LTAlength << "/"
-	                             << _config.STALTAratio << endl;
-	_report << "   + aftershock removal = " << (_config.afterShockRemoval?"on":"off") << endl;
-	_report << "   + pre event cut off = " << (_config.eventCutOff?"on":"off") << endl;
+	_acquisition->report << "   + saturation threshold = " << _config.saturationThreshold << "% of 2**23" << endl;
+	_acquisition->report << "   + maximum epicentral distance = " << _acquisition->maximumEpicentralDistance << "km" << endl;
+	_acquisition->report << "   + pre event window length = " << _config.preEventWindowLength << "s" << endl;
+	_acquisition->report << "   + total time window length = " << _acquisition->totalTimeWindowLength << "s" << endl;
+	_acquisition->report << "   + sta/lta/ratio = " << _config.STAlength << "/"
+	                                          << _config.LTAlength << "/"
+	                                          << _config.STALTAratio << endl;
+	_acquisition->report << "   + aftershock removal = " << (_config.afterShockRemoval?"on":"off") << endl;
+	_acquisition->report << "   + pre event cut off = " << (_config.eventCutOff?"on":"off") << endl;
 
-	_report << " + Stations" << endl;
+	_acquisition->report << " + Stations" << endl;
 
 	// Reset remaining channels
 	_currentProcess->remainingChannels = 0;
@@ -1467,7 +1625,7 @@ void WFParam::process(Origin *origin) {
 
 		PickPtr pick = _cache.get<Pick>(pickID);
 		if ( !pick ) {
-			_report << "   - " << pickID << " [pick not found]" << endl;
+			_acquisition->report << "   - " << pickID << " [pick not found]" << endl;
 			continue;
 		}
 
@@ -1491,230 +1649,242 @@ void WFParam::process(Origin *origin) {
 		usedStations.insert(stationID);
 	}
 
-	for ( size_t n = 0; n < inventory->networkCount(); ++n ) {
-		auto net = inventory->network(n);
+	if ( !_stationIndex.isValid() ) {
+		_stationIndex.build(inventory);
+	}
 
-		if ( net->start() > _originTime ) {
-			continue;
-		}
+	// Only visit the stations operating at origin time within the maximum
+	// distance instead of the whole inventory
+	StationIndex::Candidates candidates;
+	_stationIndex.query(_acquisition->latitude, _acquisition->longitude,
+	                    _acquisition->maximumEpicentralDistance,
+	                    _acquisition->originTime, candidates);
 
-		try {
-			if ( net->end() < _originTime ) {
-				continue;
-			}
-		}
-		catch ( ... ) {}
+	for ( const StationIndex::Candidate &candidate : candidates ) {
+		auto net = candidate.network;
+		auto sta = candidate.station;
 
-		for ( size_t s = 0; s < net->stationCount(); ++s ) {
-			auto sta = net->station(s);
+		double distance, az, baz;
+		Math::Geo::delazi(_acquisition->latitude, _acquisition->longitude,
+		                  sta->latitude(), sta->longitude(),
+		                  &distance, &az, &baz);
+		distance = Math::Geo::deg2km(distance);
 
-			if ( sta->start() > _originTime ) {
-				continue;
-			}
+		string stationID = net->code() + "." + sta->code();
 
-			try {
-				if ( sta->end() < _originTime ) {
-					continue;
-				}
-			}
-			catch ( ... ) {}
+		if ( distance > _acquisition->maximumEpicentralDistance ) {
+			_acquisition->report << "   - " << stationID << " [distance out of range]" << endl;
+			continue;
+		}
 
-			double distance, az, baz;
-			Math::Geo::delazi(_latitude, _longitude,
-			                  sta->latitude(), sta->longitude(),
-			                  &distance, &az, &baz);
-			distance = Math::Geo::deg2km(distance);
+		_acquisition->report << "   + " << stationID << endl;
+		_acquisition->report << "     + distance = " << distance << "km" << endl;
 
-			string stationID = net->code() + "." + sta->code();
+		PickStreamEntry &e = pickStreamMap[stationID];
+		Core::Time triggerTime;
 
-			if ( distance > _maximumEpicentralDistance ) {
-				_report << "   - " << stationID << " [distance out of range]" << endl;
+		if ( e.first ) {
+			triggerTime = e.first->time().value();
+			_acquisition->report << "     + trigger time = " << triggerTime.iso()
+			                     << " [pick: " << e.first->publicID() << "]" << endl;
+		}
+		else {
+			try {
+				TravelTime tt = _travelTime.computeFirst(_acquisition->latitude, _acquisition->longitude, _acquisition->depth,
+				                                         sta->latitude(), sta->longitude());
+				triggerTime = _acquisition->originTime + Core::TimeSpan(tt.time);
+			}
+			catch ( ... ) {
+				_acquisition->report << "     - PGAV [no travel time available]" << endl;
 				continue;
 			}
 
-			_report << "   + " << stationID << endl;
-			_report << "     + distance = " << distance << "km" << endl;
+			_acquisition->report << "     + trigger time = " << triggerTime.iso() << " [predicted arrival time]" << endl;
+		}
 
-			PickStreamEntry &e = pickStreamMap[stationID];
-			Core::Time triggerTime;
+		// Find velocity and strong-motion streams
+		DataModel::WaveformStreamID tmp(net->code(), sta->code(), "", "", "");
 
-			if ( e.first ) {
-				triggerTime = e.first->time().value();
-				_report << "     + trigger time = " << triggerTime.iso()
-				        << " [pick: " << e.first->publicID() << "]" << endl;
-			}
-			else {
-				try {
-					TravelTime tt = _travelTime.computeFirst(_latitude, _longitude, _depth,
-					                                         sta->latitude(), sta->longitude());
-					triggerTime = _originTime + Core::TimeSpan(tt.time);
-				}
-				catch ( ... ) {
-					_report << "     - PGAV [no travel time available]" << endl;
-					continue;
-				}
+		DataModel::Stream *maxVel, *maxAcc;
+		maxVel = Private::findStreamMaxSR(sta, triggerTime,
+		                                  WaveformProcessor::MeterPerSecond,
+		                                  &_streamFirewall);
+		maxAcc = Private::findStreamMaxSR(sta, triggerTime,
+		                                  WaveformProcessor::MeterPerSecondSquared,
+		                                  &_streamFirewall);
 
-				_report << "     + trigger time = " << triggerTime.iso() << " [predicted arrival time]" << endl;
-			}
+		/*
+		if ( maxVel && _currentProcess->hasBeenProcessed(maxVel) ) {
+			_acquisition->report << "     - vel " << maxVel->sensorLocation()->code()
+			                     << "." << maxVel->code().substr(0,2) << " [processed already]" << endl;
+			maxVel = nullptr;
+		}
 
-			// Find velocity and strong-motion streams
-			DataModel::WaveformStreamID tmp(net->code(), sta->code(), "", "", "");
+		if ( maxAcc && _currentProcess->hasBeenProcessed(maxAcc) ) {
+			_acquisition->report << "     - acc " << maxAcc->sensorLocation()->code()
+			                     << "." << maxAcc->code().substr(0,2) << " [processed already]" << endl;
+			maxAcc = nullptr;
+		}
+		*/
 
-			DataModel::Stream *maxVel, *maxAcc;
-			maxVel = Private::findStreamMaxSR(sta, triggerTime,
-			                                  WaveformProcessor::MeterPerSecond,
-			                                  &_streamFirewall);
-			maxAcc = Private::findStreamMaxSR(sta, triggerTime,
-			                                  WaveformProcessor::MeterPerSecondSquared,
-			                                  &_streamFirewall);
+		if ( !maxAcc && !maxVel ) {
+			_acquisition->report << "     - PGAV [no usable channel found]" << endl;
+			continue;
+		}
 
-			/*
-			if ( maxVel && _currentProcess->hasBeenProcessed(maxVel) ) {
-				_report << "     - vel " << maxVel->sensorLocation()->code()
-				        << "." << maxVel->code().substr(0,2) << " [processed already]" << endl;
-				maxVel = nullptr;
-			}
+		// Add strong-motion data if available
+		if ( maxAcc ) {
+			tmp.setLocationCode(maxAcc->sensorLocation()->code());
+			// Fixing the component would bind this channel to the processor
+			// regardless of the orientation of the requested component.
+			// This will be useful, if processors are created whenever a
+			// new data channel arrives.
+			//tmp.setChannelCode(maxAcc->code() + "E");
+			tmp.setChannelCode(maxAcc->code().substr(0,2));
 
-			if ( maxAcc && _currentProcess->hasBeenProcessed(maxAcc) ) {
-				_report << "     - acc " << maxAcc->sensorLocation()->code()
-				        << "." << maxAcc->code().substr(0,2) << " [processed already]" << endl;
-				maxAcc = nullptr;
+			DataModel::ThreeComponents tc;
+			try {
+				DataModel::getThreeComponents(
+					tc, maxAcc->sensorLocation(),
+					tmp.channelCode().c_str(), triggerTime
+				);
 			}
-			*/
-
-			if ( !maxAcc && !maxVel ) {
-				_report << "     - PGAV [no usable channel found]" << endl;
-				continue;
+			catch ( exception &e ) {
+				cout << Private::toStreamID(tmp) << ": " << e.what() << endl;
+				_acquisition->report << "     - acc " << maxAcc->sensorLocation()->code()
+				                     << "." << maxAcc->code().substr(0,2) << " [" << e.what() << "]" << endl;
 			}
 
-			// Add strong-motion data if available
-			if ( maxAcc ) {
-				tmp.setLocationCode(maxAcc->sensorLocation()->code());
-				// Fixing the component would bind this channel to the processor
-				// regardless of the orientation of the requested component.
-				// This will be useful, if processors are created whenever a
-				// new data channel arrives.
-				//tmp.setChannelCode(maxAcc->code() + "E");
-				tmp.setChannelCode(maxAcc->code().substr(0,2));
-
-				DataModel::ThreeComponents tc;
-				try {
-					DataModel::getThreeComponents(
-						tc, maxAcc->sensorLocation(),
-						tmp.channelCode().c_str(), triggerTime
-					);
+			for ( int i = 0; i < 3; ++i ) {
+				if ( tc.comps[i] == nullptr ) continue;
+				tmp.setChannelCode(tc.comps[i]->code());
+				if ( _currentProcess->hasBeenProcessed(tc.comps[i]) ) {
+					_acquisition->report << "     - acc " << tmp.locationCode()
+					                     << "." << tmp.channelCode() << " [processed already]" << endl;
 				}
-				catch ( exception &e ) {
-					cout << Private::toStreamID(tmp) << ": " << e.what() << endl;
-					_report << "     - acc " << maxAcc->sensorLocation()->code()
-					        << "." << maxAcc->code().substr(0,2) << " [" << e.what() << "]" << endl;
+				else if ( _streamFirewall.isAllowed(toStreamID(tmp)) ) {
+					_acquisition->report << "     + acc " << tmp.networkCode() << "."
+					                     << tmp.stationCode() << "." << tmp.locationCode() << "."
+					                     << tmp.channelCode() << endl;
+					if ( addProcessor(tmp, tc.comps[i], triggerTime,
+					                  (WaveformProcessor::StreamComponents)i) == -3 )
+						++_currentProcess->remainingChannels;
 				}
+			}
+		}
 
-				for ( int i = 0; i < 3; ++i ) {
-					if ( tc.comps[i] == nullptr ) continue;
-					tmp.setChannelCode(tc.comps[i]->code());
-					if ( _currentProcess->hasBeenProcessed(tc.comps[i]) ) {
-						_report << "     - acc " << tmp.locationCode()
-						        << "." << tmp.channelCode() << " [processed already]" << endl;
-					}
-					else if ( _streamFirewall.isAllowed(toStreamID(tmp)) ) {
-						_report << "     + acc " << tmp.networkCode() << "."
-						        << tmp.stationCode() << "." << tmp.locationCode() << "."
-						        << tmp.channelCode() << endl;
-						if ( addProcessor(tmp, tc.comps[i], triggerTime,
-						                  (WaveformProcessor::StreamComponents)i) == -3 )
-							++_currentProcess->remainingChannels;
-					}
-				}
+		// Add velocity data if available
+		if ( maxVel ) {
+			tmp.setLocationCode(maxVel->sensorLocation()->code());
+			tmp.setChannelCode(maxVel->code().substr(0,2));
+
+			DataModel::ThreeComponents tc;
+			try {
+				DataModel::getThreeComponents(
+					tc, maxVel->sensorLocation(),
+					tmp.channelCode().c_str(), triggerTime
+				);
+			}
+			catch ( exception &e ) {
+				cout << Private::toStreamID(tmp) << ": " << e.what() << endl;
+				_acquisition->report << "     - vel " << maxAcc->sensorLocation()->code()
+				                     << "." << maxAcc->code().substr(0,2) << " [" << e.what() << "]" << endl;
 			}
 
-			// Add velocity data if available
-			if ( maxVel ) {
-				tmp.setLocationCode(maxVel->sensorLocation()->code());
-				tmp.setChannelCode(maxVel->code().substr(0,2));
-
-				DataModel::ThreeComponents tc;
-				try {
-					DataModel::getThreeComponents(
-						tc, maxVel->sensorLocation(),
-						tmp.channelCode().c_str(), triggerTime
-					);
+			for ( int i = 0; i < 3; ++i ) {
+				if ( tc.comps[i] == nullptr ) continue;
+				tmp.setChannelCode(tc.comps[i]->code());
+				if ( _currentProcess->hasBeenProcessed(tc.comps[i]) ) {
+					_acquisition->report << "     - vel " << tmp.locationCode()
+					                     << "." << tmp.channelCode() << " [processed already]" << endl;
 				}
-				catch ( exception &e ) {
-					cout << Private::toStreamID(tmp) << ": " << e.what() << endl;
-					_report << "     - vel " << maxAcc->sensorLocation()->code()
-					        << "." << maxAcc->code().substr(0,2) << " [" << e.what() << "]" << endl;
-				}
-
-				for ( int i = 0; i < 3; ++i ) {
-					if ( tc.comps[i] == nullptr ) continue;
-					tmp.setChannelCode(tc.comps[i]->code());
-					if ( _currentProcess->hasBeenProcessed(tc.comps[i]) ) {
-						_report << "     - vel " << tmp.locationCode()
-						        << "." << tmp.channelCode() << " [processed already]" << endl;
-					}
-					else if ( _streamFirewall.isAllowed(toStreamID(tmp)) ) {
-						_report << "     + vel " << tmp.networkCode() << "."
-						        << tmp.stationCode() << "." << tmp.locationCode() << "."
-						        << tmp.channelCode() << endl;
-						if ( addProcessor(tmp, tc.comps[i], triggerTime,
-						                  (WaveformProcessor::StreamComponents)i) == -3 )
-							++_currentProcess->remainingChannels;
-					}
+				else if ( _streamFirewall.isAllowed(toStreamID(tmp)) ) {
+					_acquisition->report << "     + vel " << tmp.networkCode() << "."
+					                     << tmp.stationCode() << "." << tmp.locationCode() << "."
+					                     << tmp.channelCode() << endl;
+					if ( addProcessor(tmp, tc.comps[i], triggerTime,
+					                  (WaveformProcessor::StreamComponents)i) == -3 )
+						++_currentProcess->remainingChannels;
 				}
 			}
-
-			// Eventually all results are grouped by station and the
-			// results from the sensor with the highest raw value is
-			// used.
 		}
+
+		// Eventually all results are grouped by station and the
+		// results from the sensor with the highest raw value is
+		// used.
 	}
 
 	//_currentProcess->results.clear();
 
-	if ( _processors.empty() ) {
-		_report << " + No processors added" << endl;
+	if ( _acquisition->processors.empty() ) {
+		_acquisition->report << " + No processors added" << endl;
 		printReport();
 		//return;
 	}
 	else {
-		_report << " + Requested time windows" << endl;
-		for ( RequestMap::iterator it = _stationRequests.begin(); it != _stationRequests.end(); ++it ) {
+		int requestedStreams = 0;
+
+		_acquisition->report << " + Requested time windows" << endl;
+		for ( RequestMap::iterator it = _acquisition->stationRequests.begin(); it != _acquisition->stationRequests.end(); ++it ) {
 			StationRequest &req = it->second;
+			size_t cachedRecords = _acquisition->cachedRecords.size();
+
 			for ( WaveformIDSet::iterator wit = req.streams.begin(); wit != req.streams.end(); ++wit ) {
 				const WaveformStreamID &wsid = *wit;
-				recordStream()->addStream(wsid.networkCode(), wsid.stationCode(),
-				                          wsid.locationCode(), wsid.channelCode(),
-				                          req.timeWindow.startTime(),
-				                          req.timeWindow.endTime());
+
+				// Only request the part of the time window that is not
+				// available from previous acquisitions
+				Core::Time start = _waveformCache.lookup(
+					Private::toStreamID(wsid), req.timeWindow,
+					_acquisition->cachedRecords
+				);
+
+				if ( start >= req.timeWindow.endTime() ) continue;
+
+				_acquisition->stream->addStream(wsid.networkCode(), wsid.stationCode(),
+				                                wsid.locationCode(), wsid.channelCode(),
+				                                start, req.timeWindow.endTime());
+				++requestedStreams;
 			}
 
-			_report << "   + " << it->first << ": " << req.timeWindow.startTime().toString("%F %T")
-			        << ", " << req.timeWindow.endTime().toString("%F %T") << endl;
+			_acquisition->report << "   + " << it->first << ": " << req.timeWindow.startTime().toString("%F %T")
+			                     << ", " << req.timeWindow.endTime().toString("%F %T");
+			if ( _acquisition->cachedRecords.size() > cachedRecords )
+				_acquisition->report << " [" << (_acquisition->cachedRecords.size() - cachedRecords)
+				                     << " records cached]";
+			_acquisition->report << endl;
 		}
 
-		_result << " + Processing" << endl;
+		// Everything is served from the cache
+		if ( requestedStreams == 0 ) {
+			_acquisition->stream->close();
+			_acquisition->stream = nullptr;
+		}
+
+		_acquisition->result << " + Processing" << endl;
 	}
 
-	_firstRecord = true;
-	_acquisitionTimer.restart();
-	_noDataTimer.restart();
-	_acquisitionTimeout = _config.initialAcquisitionTimeout;
+	_acquisition->metrics.requested = _acquisition->metrics.elapsed();
+
+	_acquisition->firstRecord = true;
+	_acquisition->timer.restart();
+	_acquisition->noDataTimer.restart();
+	_acquisition->timeout = _config.initialAcquisitionTimeout;
 
-	if ( _acquisitionTimeout > 0 ) {
-		SEISCOMP_INFO("set stream timeout to %d seconds", _acquisitionTimeout);
+	if ( _acquisition->timeout > 0 ) {
+		SEISCOMP_INFO("set stream timeout to %d seconds", _acquisition->timeout);
 	}
 
 	if ( _config.dumpRecords ) {
-		if ( _currentProcess->event ) {
-			_recordDumpOutput.open((_currentProcess->event->publicID() + ".recs").c_str());
+		if ( _currentProcess && _currentProcess->event ) {
+			_acquisition->recordDump.open((_currentProcess->event->publicID() + ".recs").c_str());
 		}
 		else {
-			_recordDumpOutput.open("dump.recs");
+			_acquisition->recordDump.open("dump.recs");
 		}
 	}
 
-	startRecordThread();
+	startAcquisition();
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -1730,7 +1900,7 @@ int WFParam::addProcessor(const DataModel::WaveformStreamID &waveformID,
 	int componentCount = 0;
 
 	PGAVPtr proc = new PGAV(time);
-	proc->setEventWindow(_config.preEventWindowLength, _totalTimeWindowLength);
+	proc->setEventWindow(_config.preEventWindowLength, _acquisition->totalTimeWindowLength);
 	proc->setSTALTAParameters(_config.STAlength, _config.LTAlength, _config.STALTAratio, _config.STALTAmargin);
 	if ( _config.naturalPeriodsFixed ) {
 		proc->setResponseSpectrumParameters(_config.dampings);
@@ -1746,10 +1916,19 @@ int WFParam::addProcessor(const DataModel::WaveformStreamID &waveformID,
 	proc->setPadLength(_config.padLength);
 	// -1 as hifreq: let the algorithm define the best frequency
 	proc->setPostDeconvolutionFilterParams(_config.PDorder, _config.PDfilter.first, _config.PDfilter.second);
-	proc->setFilterParams(_config.order, _filter.first, _filter.second);
+	proc->setFilterParams(_config.order, _acquisition->filter.first, _acquisition->filter.second);
 	proc->setDeconvolutionEnabled(_config.enableDeconvolution);
 	proc->setDurationScale(_config.durationScale);
 	proc->setClipTmaxToLowestFilterFrequency(_config.clipTmax);
+	proc->setResponseSpectrumMethod(_config.responseSpectrumMethod);
+	proc->setDeferredProcessing(_workerPool != nullptr);
+	proc->setIncrementalProcessing(_config.incrementalProcessing);
+
+	// Share the evaluated sensor response with all processors and runs
+	if ( _config.enableDeconvolution && selectedStream ) {
+		DataModel::Sensor *sensor = DataModel::Sensor::Find(selectedStream->sensor());
+		if ( sensor ) proc->setResponseID(sensor->response());
+	}
 
 	// Override used component
 	proc->setUsedComponent(component);
@@ -1810,8 +1989,8 @@ int WFParam::addProcessor(const DataModel::WaveformStreamID &waveformID,
 			componentCount = 3;
 			break;
 		default:
-			_report << "       - PGAV [unsupported component " << proc->usedComponent() << "]"
-			        << endl;
+			_acquisition->report << "       - PGAV [unsupported component " << proc->usedComponent() << "]"
+			                     << endl;
 			return -1;
 	}
 
@@ -1858,7 +2037,7 @@ int WFParam::addProcessor(const DataModel::WaveformStreamID &waveformID,
 	for ( int i = 0; i < componentCount; ++i ) {
 		cwids[i] = tmp;
 		if ( tc.comps[components[i]] == nullptr ) {
-			_report << "       - PGAV [components not found]" << endl;
+			_acquisition->report << "       - PGAV [components not found]" << endl;
 			return -1;
 		}
 
@@ -1866,7 +2045,7 @@ int WFParam::addProcessor(const DataModel::WaveformStreamID &waveformID,
 		streamIDs[i] = Private::toStreamID(cwids[i]);
 
 		if ( cwids[i].channelCode().empty() ) {
-			_report << "       - PGAV [invalid channel code]" << endl;
+			_acquisition->report << "       - PGAV [invalid channel code]" << endl;
 			return -1;
 		}
 
@@ -1886,7 +2065,7 @@ int WFParam::addProcessor(const DataModel::WaveformStreamID &waveformID,
 		}
 
 		if ( proc->streamConfig(components[i]).gain == 0.0 ) {
-			_report << "       - PGAV [gain not found for "
+			_acquisition->report << "       - PGAV [gain not found for "
 					<< proc->streamConfig(components[i]).code() << "]"
 					<< endl;
 			return -1;
@@ -1911,30 +2090,30 @@ int WFParam::addProcessor(const DataModel::WaveformStreamID &waveformID,
 
 	// Check: end-time in future?
 	if ( now && (proc->safetyTimeWindow().endTime() > *now) ) {
-		_report << "       - PGAV [end of time window in future]" << endl;
+		_acquisition->report << "       - PGAV [end of time window in future]" << endl;
 		return -3;
 	}
 
 	if ( proc->isFinished() ) {
-		_report << "       - PGAV [" << proc->status().toString() << " (" << proc->statusValue() << ")]" << endl;
+		_acquisition->report << "       - PGAV [" << proc->status().toString() << " (" << proc->statusValue() << ")]" << endl;
 		return -1;
 	}
 	else {
 		/*
 		if ( proc->safetyTimeWindow().endTime() > Core::Time::GMT() + Core::TimeSpan(30.) ) {
-			_report << "     - " << proc->type() << " [timewindow end is too far in the future]" << endl;
+			_acquisition->report << "     - " << proc->type() << " [timewindow end is too far in the future]" << endl;
 			return false;
 		}
 		*/
-		_report << "       + PGAV" << endl;
+		_acquisition->report << "       + PGAV" << endl;
 	}
 
 	for ( int i = 0; i < componentCount; ++i ) {
 		pair<ProcessorMap::iterator, bool> handle =
-			_processors.insert(ProcessorMap::value_type(streamIDs[i], ProcessorSlot()));
+			_acquisition->processors.insert(ProcessorMap::value_type(streamIDs[i], ProcessorSlot()));
 
 		// Update processors station time window
-		StationRequest &req = _stationRequests[stationID];
+		StationRequest &req = _acquisition->stationRequests[stationID];
 		if ( (bool)req.timeWindow == true )
 			req.timeWindow = req.timeWindow | proc->safetyTimeWindow();
 		else
@@ -1944,7 +2123,7 @@ int WFParam::addProcessor(const DataModel::WaveformStreamID &waveformID,
 		if ( handle.second ) {
 			req.streams.insert(cwids[i]);
 			//addStream(cwids[i].networkCode(), cwids[i].stationCode(), cwids[i].locationCode(), cwids[i].channelCode());
-			_report << "         + " << streamIDs[i] << endl;
+			_acquisition->report << "         + " << streamIDs[i] << endl;
 		}
 
 		handle.first->second.push_back(proc);
@@ -1981,8 +2160,104 @@ bool WFParam::getValue(VALUE &res, const map<KEY,VALUE> &values,
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void WFParam::printReport() {
-	SEISCOMP_LOG(_processingInfoChannel, "%s%s", _report.str().c_str(),
-	             _result.str().c_str());
+	SEISCOMP_LOG(_processingInfoChannel, "%s%s", _acquisition->report.str().c_str(),
+	             _acquisition->result.str().c_str());
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WFParam::reportMetrics() {
+	const Metrics &metrics = _acquisition->metrics;
+	const PGAV::Timings &processing = metrics.processing;
+	string eventID = _currentProcess && _currentProcess->event ?
+	                 _currentProcess->event->publicID() : string("-");
+
+	SEISCOMP_INFO("Metrics of %s: requested after %.3fs, first record after %.3fs, "
+	              "last record after %.3fs, %d records, collected after %.3fs",
+	              eventID.c_str(), metrics.requested, metrics.firstRecord,
+	              metrics.lastRecord, static_cast<int>(metrics.records),
+	              metrics.collected);
+	SEISCOMP_INFO("Metrics of %s: processing of %d channels took %.3fs "
+	              "(gain %.3fs, sta/lta %.3fs, fft %.3fs, deconvolution %.3fs, "
+	              "filter %.3fs, spectra %.3fs, other %.3fs), messaging %.3fs, "
+	              "shakemap %.3fs",
+	              eventID.c_str(), metrics.channels, processing.total(),
+	              processing.gain, processing.stalta, processing.fft,
+	              processing.deconvolution, processing.filter,
+	              processing.spectra, processing.other,
+	              metrics.messaging, metrics.shakeMap);
+
+	for ( const Metrics::StreamTimings &stream : metrics.streams ) {
+		const PGAV::Timings &timings = stream.second;
+		SEISCOMP_DEBUG("Metrics of %s: processing of %s took %.3fs "
+		               "(gain %.3fs, sta/lta %.3fs, fft %.3fs, deconvolution %.3fs, "
+		               "filter %.3fs, spectra %.3fs, other %.3fs)",
+		               eventID.c_str(), stream.first.c_str(), timings.total(),
+		               timings.gain, timings.stalta, timings.fft,
+		               timings.deconvolution, timings.filter,
+		               timings.spectra, timings.other);
+	}
+
+	bool publish = _outputMetrics && connection();
+	if ( !_metricsOutput.is_open() && !publish ) return;
+
+	// One JSON object per line
+	ostringstream os;
+	os.precision(6);
+	os << fixed;
+	os << "{\"event\":\"" << escapeJSON(eventID) << "\"";
+	if ( _currentProcess ) {
+		os << ",\"received\":\"" << _currentProcess->created.iso() << "\""
+		   << ",\"started\":\"" << _currentProcess->lastRun.iso() << "\"";
+	}
+	writeJSONLatency(os, "requested", metrics.requested);
+	writeJSONLatency(os, "firstRecord", metrics.firstRecord);
+	writeJSONLatency(os, "lastRecord", metrics.lastRecord);
+	writeJSONLatency(os, "collected", metrics.collected);
+	os << ",\"records\":" << metrics.records
+	   << ",\"channels\":" << metrics.channels
+	   << ",\"processing\":{";
+	writeJSONTimings(os, processing);
+	os << "},\"streams\":[";
+	for ( size_t i = 0; i < metrics.streams.size(); ++i ) {
+		if ( i ) os << ",";
+		os << "{\"stream\":\"" << escapeJSON(metrics.streams[i].first) << "\",";
+		writeJSONTimings(os, metrics.streams[i].second);
+		os << "}";
+	}
+	os << "]"
+	   << ",\"messaging\":" << metrics.messaging
+	   << ",\"shakeMap\":" << metrics.shakeMap
+	   << "}";
+
+	if ( _metricsOutput.is_open() )
+		_metricsOutput << os.str() << endl;
+
+	if ( !publish ) return;
+
+	// Publish the record as comment to the status group so that monitoring
+	// clients receive the metrics of each event along with the status of
+	// this client
+	CreationInfo ci;
+	ci.setAgencyID(agencyID());
+	ci.setAuthor(author());
+	ci.setCreationTime(Core::Time::UTC());
+
+	CommentPtr comment = new Comment;
+	comment->setId("metrics");
+	comment->setText(os.str());
+	comment->setCreationInfo(ci);
+
+	Core::DataMessagePtr msg = new Core::DataMessage;
+	msg->attach(comment.get());
+	if ( connection()->send(_config.metricsGroup, msg.get()) )
+		logObject(_outputMetrics, Core::Time::UTC());
+	else
+		SEISCOMP_WARNING("Sending metrics of %s to %s failed",
+		                 eventID.c_str(), _config.metricsGroup.c_str());
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -2065,105 +2340,75 @@ void WFParam::removedFromCache(Seiscomp::DataModel::PublicObject *po) {}
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-bool WFParam::storeRecord(Record *rec) {
-	if ( _firstRecord ) {
-		if ( _config.runningAcquisitionTimeout > 0 ) {
-			SEISCOMP_INFO("Data request: got first record, set timeout to %d seconds",
-			              _config.runningAcquisitionTimeout);
-
-			_acquisitionTimeout = _config.runningAcquisitionTimeout;
-		}
-
-		_firstRecord = false;
-	}
+void WFParam::handleRecord(Record *rec) {
+	RecordPtr tmp(rec);
 
-	return Application::storeRecord(rec);
-}
-// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+	// Cached records are delivered before the records of the record
+	// source and do not tell anything about its responsiveness
+	if ( _acquisition->pendingCachedRecords > 0 )
+		--_acquisition->pendingCachedRecords;
+	else {
+		if ( _acquisition->firstRecord ) {
+			if ( _config.runningAcquisitionTimeout > 0 ) {
+				SEISCOMP_INFO("Data request: got first record, set timeout to %d seconds",
+				              _config.runningAcquisitionTimeout);
 
+				_acquisition->timeout = _config.runningAcquisitionTimeout;
+			}
 
+			_acquisition->firstRecord = false;
+		}
 
+		_waveformCache.feed(rec);
+	}
 
-// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-void WFParam::handleRecord(Record *rec) {
-	RecordPtr tmp(rec);
+	_acquisition->noDataTimer.restart();
 
-	_noDataTimer.restart();
+	Metrics &metrics = _acquisition->metrics;
+	metrics.lastRecord = metrics.elapsed();
+	if ( metrics.firstRecord < 0 ) metrics.firstRecord = metrics.lastRecord;
+	++metrics.records;
 
 	if ( _config.dumpRecords ) {
 		if ( rec->raw() ) {
 			size_t bytes = rec->raw()->elementSize()*rec->raw()->size();
-			_recordDumpOutput.write((const char*)rec->raw()->data(), bytes);
+			_acquisition->recordDump.write((const char*)rec->raw()->data(), bytes);
 		}
 	}
 
 	string streamID = rec->streamID();
 
-	ProcessorMap::iterator slot_it = _processors.find(streamID);
-	if ( slot_it == _processors.end() ) {
+	ProcessorMap::iterator slot_it = _acquisition->processors.find(streamID);
+	if ( slot_it == _acquisition->processors.end() ) {
 		/*
 		// Add new processor?
 		if ( !createProcessor(rec) ) return;
 
-		slot_it = _processors.find(streamID);
-		if ( slot_it == _processors.end() ) return;
+		slot_it = _acquisition->processors.find(streamID);
+		if ( slot_it == _acquisition->processors.end() ) return;
 		*/
 		return;
 	}
 
 	for ( ProcessorSlot::iterator it = slot_it->second.begin(); it != slot_it->second.end(); ) {
 		(*it)->feed(rec);
-		if ( (*it)->status() == WaveformProcessor::InProgress ) {
+		PGAV *pgav = static_cast<PGAV*>(it->get());
+		if ( pgav->isPending() ) {
+			// time window complete, hand it over to the worker pool
+			dispatch(slot_it->first, pgav);
+			it = slot_it->second.erase(it);
+		}
+		else if ( (*it)->status() == WaveformProcessor::InProgress ) {
 			// processor still needs some time (progress = (*it)->statusValue())
 			++it;
 		}
-		else if ( (*it)->status() == WaveformProcessor::Finished ) {
-			_result << "   + PGAV, " << slot_it->first.c_str() << endl;
-			PGAV *pgav = static_cast<PGAV*>(it->get());
-			_currentProcess->results.resize(_currentProcess->results.size()+1);
-			++_currentProcess->newValidResults;
-			PGAVResult &res = _currentProcess->results.back();
-			res.valid = true;
-			res.processed = pgav->processed();
-			res.streamID.setNetworkCode(rec->networkCode());
-			res.streamID.setStationCode(rec->stationCode());
-			res.streamID.setLocationCode(rec->locationCode());
-			res.streamID.setChannelCode(rec->channelCode());
-
-			setup(res, pgav);
-
-			if ( _config.saveProcessedWaveforms )
-				dumpWaveforms(_currentProcess.get(), res, pgav);
-
-			if ( _config.saveSpectraFiles )
-				dumpSpectra(_currentProcess.get(), res, pgav);
-
-			// processor finished successfully
-			it = slot_it->second.erase(it);
-		}
 		else if ( (*it)->isFinished() ) {
-			_result << "   - PGAV, " << slot_it->first.c_str() << " ("
-			        << (*it)->status().toString()
-			        << ")" << endl;
-			PGAV *pgav = static_cast<PGAV*>(it->get());
-			_currentProcess->results.resize(_currentProcess->results.size()+1);
-			PGAVResult &res = _currentProcess->results.back();
-			res.valid = false;
-			res.processed = pgav->processed();
-			res.streamID.setNetworkCode(rec->networkCode());
-			res.streamID.setStationCode(rec->stationCode());
-			res.streamID.setLocationCode(rec->locationCode());
-			res.streamID.setChannelCode(rec->channelCode());
-
-			if ( res.processed ) {
-				setup(res, pgav);
-
-				if ( _config.saveProcessedWaveforms )
-					dumpWaveforms(_currentProcess.get(), res, pgav);
-
-				if ( _config.saveSpectraFiles )
-					dumpSpectra(_currentProcess.get(), res, pgav);
-			}
+			// processor finished, successfully or not. With workers the
+			// result is queued behind the time windows dispatched before.
+			if ( _workerPool )
+				_acquisition->deferredJobs.emplace_back(pgav, slot_it->first, true);
+			else
+				addFinishedResult(slot_it->first, pgav);
 
 			it = slot_it->second.erase(it);
 		}
@@ -2171,8 +2416,10 @@ void WFParam::handleRecord(Record *rec) {
 			++it;
 	}
 
+	if ( _workerPool ) collectDeferredResults();
+
 	if ( slot_it->second.empty() )
-		_processors.erase(slot_it);
+		_acquisition->processors.erase(slot_it);
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -2191,61 +2438,61 @@ bool WFParam::createProcessor(Record *rec) {
 
 	DataModel::Stream *stream =
 		inv->getStream(tmp.networkCode(), tmp.stationCode(),
-		               tmp.locationCode(), tmp.channelCode(), _originTime);
+		               tmp.locationCode(), tmp.channelCode(), _acquisition->originTime);
 
 	if ( stream == nullptr ) {
-		_report << "   - " << rec->streamID() << " [no inventory information]" << endl;
+		_acquisition->report << "   - " << rec->streamID() << " [no inventory information]" << endl;
 		return false;
 	}
 
 	Core::Time triggerTime;
 
 	double distance, az, baz;
-	Math::Geo::delazi(_latitude, _longitude,
+	Math::Geo::delazi(_acquisition->latitude, _acquisition->longitude,
 	                  stream->sensorLocation()->latitude(),
 	                  stream->sensorLocation()->longitude(),
 	                  &distance, &az, &baz);
 	distance = Math::Geo::deg2km(distance);
 
-	if ( distance > _maximumEpicentralDistance ) {
-		_report << "   - " << rec->streamID() << " [distance out of range]" << endl;
+	if ( distance > _acquisition->maximumEpicentralDistance ) {
+		_acquisition->report << "   - " << rec->streamID() << " [distance out of range]" << endl;
 		return false;
 	}
 	else {
-		_report << "   + " << rec->streamID() << endl;
-		_report << "     + distance = " << distance << "km" << endl;
+		_acquisition->report << "   + " << rec->streamID() << endl;
+		_acquisition->report << "     + distance = " << distance << "km" << endl;
 	}
 
 	try {
-		TravelTime tt = _travelTime.computeFirst(_latitude, _longitude, _depth,
+		TravelTime tt = _travelTime.computeFirst(_acquisition->latitude, _acquisition->longitude, _acquisition->depth,
 		                                         stream->sensorLocation()->latitude(),
 		                                         stream->sensorLocation()->longitude());
-		triggerTime = _originTime + Core::TimeSpan(tt.time);
-		_report << "     + trigger time = " << triggerTime.iso() << " [predicted arrival time]" << endl;
+		triggerTime = _acquisition->originTime + Core::TimeSpan(tt.time);
+		_acquisition->report << "     + trigger time = " << triggerTime.iso() << " [predicted arrival time]" << endl;
 	}
 	catch ( ... ) {
-		_report << "     - PGAV [no travel time available]" << endl;
+		_acquisition->report << "     - PGAV [no travel time available]" << endl;
 		return false;
 	}
 
 	Processing::WaveformProcessor::SignalUnit unit;
 	if ( !unit.fromString(stream->gainUnit().c_str()) ) {
-		_report << "     - PGAV [unknown sensor unit:" << stream->gainUnit()
-		        << "]" << endl;
+		_acquisition->report << "     - PGAV [unknown sensor unit:" << stream->gainUnit()
+		                     << "]" << endl;
 		return false;
 	}
 
 	if ( unit == WaveformProcessor::MeterPerSecond )
-		_report << "     + type = vel" << endl;
+		_acquisition->report << "     + type = vel" << endl;
 	else if ( unit == WaveformProcessor::MeterPerSecondSquared )
-		_report << "     + type = acc" << endl;
+		_acquisition->report << "     + type = acc" << endl;
 	else
-		_report << "     + type = other (" << unit.toString() << ")" << endl;
+		_acquisition->report << "     + type = other (" << unit.toString() << ")" << endl;
 
 	/*
-	_report << "     + acc " << tmp.networkCode() << "."
-	        << tmp.stationCode() << "." << tmp.locationCode() << "."
-	        << tmp.channelCode().substr(0,2) << endl;
+	_acquisition->report << "     + acc " << tmp.networkCode() << "."
+	                     << tmp.stationCode() << "." << tmp.locationCode() << "."
+	                     << tmp.channelCode().substr(0,2) << endl;
 	*/
 
 	addProcessor(tmp, nullptr, triggerTime);
@@ -2260,44 +2507,16 @@ bool WFParam::createProcessor(Record *rec) {
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 bool WFParam::dispatchNotification(int type, Core::BaseObject *obj) {
 	switch ( type ) {
-		case AcquisitionFinished:
-		{
-			waitForRecordThread();
-			closeStream();
-			collectResults();
-
-			if ( _currentProcess->remainingChannels == 0 ) {
-				SEISCOMP_INFO("All available channels for event %s have been "
-				              "processed, stop process",
-				              _currentProcess->event->publicID().c_str());
-				stopProcess(_currentProcess.get());
-
-				if ( connection() ) {
-					DataModel::Journaling journal;
-					JournalEntryPtr entry = new JournalEntry;
-					entry->setObjectID(_currentProcess->event->publicID());
-					entry->setAction(JOURNAL_ACTION);
-					entry->setParameters(JOURNAL_ACTION_COMPLETED);
-					entry->setSender(name() + "@" + System::HostInfo().name());
-					entry->setCreated(Core::Time::UTC());
-					Notifier::Enable();
-					Notifier::Create(journal.publicID(), OP_ADD, entry.get());
-					Notifier::Disable();
-
-					Core::MessagePtr msg = Notifier::GetMessage();
-					if ( msg ) connection()->send("EVENT", msg.get());
-				}
+		case ProcessingFinished:
+			for ( auto &acq : _acquisitions ) {
+				activate(acq.get());
+				collectDeferredResults();
 			}
-
-			_acquisitionTimeout = 0;
-			_currentProcess = nullptr;
-			handleTimeout();
-
-			if ( (!_config.eventID.empty() && _crontab.empty()) ||
-			     _config.offline )
-				quit();
+			activate(nullptr);
+			break;
+		case RecordAvailable:
+			handleDeliveries();
 			break;
-		}
 		default:
 			return false;
 	}
@@ -2310,9 +2529,191 @@ bool WFParam::dispatchNotification(int type, Core::BaseObject *obj) {
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-void WFParam::acquisitionFinished() {
-	if ( _config.dumpRecords ) _recordDumpOutput.close();
-	sendNotification(Client::Notification(AcquisitionFinished, nullptr));
+void WFParam::activate(Acquisition *acq) {
+	_acquisition = acq;
+	_currentProcess = acq ? acq->process : nullptr;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool WFParam::isAcquiring(const Process *proc) const {
+	for ( auto &acq : _acquisitions ) {
+		if ( acq->process == proc ) return true;
+	}
+
+	return false;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool WFParam::startAcquisition() {
+	if ( !_acquisition->cachedRecords.empty() ) {
+		SEISCOMP_DEBUG("Serving %d records from the waveform cache",
+		               static_cast<int>(_acquisition->cachedRecords.size()));
+
+		// Queue the cached records before the acquisition thread delivers
+		// anything to keep the records of each stream in order
+		std::unique_lock<std::mutex> lock(_deliveryMutex);
+		for ( const RecordPtr &rec : _acquisition->cachedRecords )
+			_deliveries.push_back(Delivery{_acquisition, rec});
+		_acquisition->pendingCachedRecords = _acquisition->cachedRecords.size();
+		_acquisition->cachedRecords.clear();
+	}
+
+	try {
+		_acquisition->thread = std::thread(&WFParam::acquire, this, _acquisition.get());
+	}
+	catch ( std::exception &e ) {
+		SEISCOMP_ERROR("Unable to start acquisition thread: %s", e.what());
+		_acquisition->stream = nullptr;
+		return false;
+	}
+
+	_acquisitions.push_back(_acquisition);
+	SEISCOMP_DEBUG("Started acquisition, %d running",
+	               static_cast<int>(_acquisitions.size()));
+	return true;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WFParam::stopAcquisitions() {
+	for ( auto &acq : _acquisitions ) {
+		if ( acq->stream ) acq->stream->close();
+		if ( acq->thread.joinable() ) acq->thread.join();
+	}
+
+	_acquisitions.clear();
+
+	std::unique_lock<std::mutex> lock(_deliveryMutex);
+	_deliveries.clear();
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WFParam::acquire(Acquisition *acq) {
+	if ( !acq->stream ) {
+		deliver(acq, nullptr);
+		return;
+	}
+
+	IO::RecordInput input(acq->stream.get(), Array::DOUBLE,
+	                      _config.dumpRecords ? Record::SAVE_RAW : Record::DATA_ONLY);
+
+	try {
+		for ( IO::RecordIterator it = input.begin(); it != input.end(); ++it ) {
+			Record *rec = *it;
+			if ( rec ) deliver(acq, rec);
+		}
+	}
+	catch ( std::exception &e ) {
+		SEISCOMP_ERROR("Exception in acquisition: %s", e.what());
+	}
+
+	deliver(acq, nullptr);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WFParam::deliver(Acquisition *acq, Record *rec) {
+	{
+		std::unique_lock<std::mutex> lock(_deliveryMutex);
+		_deliveries.push_back(Delivery{acq, rec});
+	}
+
+	sendNotification(Client::Notification(RecordAvailable, nullptr));
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WFParam::handleDeliveries() {
+	Deliveries deliveries;
+
+	{
+		std::unique_lock<std::mutex> lock(_deliveryMutex);
+		deliveries.swap(_deliveries);
+	}
+
+	for ( Delivery &delivery : deliveries ) {
+		if ( delivery.record ) {
+			activate(delivery.acquisition.get());
+			handleRecord(delivery.record.get());
+			activate(nullptr);
+		}
+		else
+			finishAcquisition(delivery.acquisition.get());
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WFParam::finishAcquisition(Acquisition *acq) {
+	AcquisitionPtr ref(acq);
+
+	if ( acq->thread.joinable() ) acq->thread.join();
+	acq->stream = nullptr;
+
+	if ( _config.dumpRecords ) acq->recordDump.close();
+
+	activate(acq);
+	collectResults();
+	reportMetrics();
+
+	if ( _currentProcess ) {
+		if ( _currentProcess->remainingChannels == 0 ) {
+			SEISCOMP_INFO("All available channels for event %s have been "
+			              "processed, stop process",
+			              _currentProcess->event->publicID().c_str());
+			stopProcess(_currentProcess.get());
+
+			if ( connection() ) {
+				DataModel::Journaling journal;
+				JournalEntryPtr entry = new JournalEntry;
+				entry->setObjectID(_currentProcess->event->publicID());
+				entry->setAction(JOURNAL_ACTION);
+				entry->setParameters(JOURNAL_ACTION_COMPLETED);
+				entry->setSender(name() + "@" + System::HostInfo().name());
+				entry->setCreated(Core::Time::UTC());
+				Notifier::Enable();
+				Notifier::Create(journal.publicID(), OP_ADD, entry.get());
+				Notifier::Disable();
+
+				Core::MessagePtr msg = Notifier::GetMessage();
+				if ( msg ) connection()->send("EVENT", msg.get());
+			}
+		}
+	}
+
+	activate(nullptr);
+	_acquisitions.remove(ref);
+
+	// Start the next process as soon as a slot is free
+	handleTimeout();
+
+	if ( (!_config.eventID.empty() && _crontab.empty()) ||
+	     (_config.offline && _acquisitions.empty()) )
+		quit();
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -2344,91 +2745,197 @@ void WFParam::setup(PGAVResult &res, Processing::PGAV *pgav) {
 
 
 
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WFParam::addResult(const Record *rec, Processing::PGAV *pgav) {
+	_currentProcess->results.resize(_currentProcess->results.size()+1);
+	PGAVResult &res = _currentProcess->results.back();
+	res.provisional = pgav->hasProvisionalValues();
+	res.valid = res.provisional || pgav->status() == WaveformProcessor::Finished;
+	res.processed = res.provisional || pgav->processed();
+	res.streamID.setNetworkCode(rec->networkCode());
+	res.streamID.setStationCode(rec->stationCode());
+	res.streamID.setLocationCode(rec->locationCode());
+	res.streamID.setChannelCode(rec->channelCode());
+
+	if ( res.valid )
+		++_currentProcess->newValidResults;
+
+	// Only complete time windows are timed
+	if ( !res.provisional && pgav->timings().total() > 0 ) {
+		Metrics &metrics = _acquisition->metrics;
+		const PGAV::Timings &timings = pgav->timings();
+		++metrics.channels;
+		metrics.streams.push_back(Metrics::StreamTimings(rec->streamID(), timings));
+		metrics.processing.gain += timings.gain;
+		metrics.processing.stalta += timings.stalta;
+		metrics.processing.fft += timings.fft;
+		metrics.processing.deconvolution += timings.deconvolution;
+		metrics.processing.filter += timings.filter;
+		metrics.processing.spectra += timings.spectra;
+		metrics.processing.other += timings.other;
+	}
+
+	if ( res.processed ) {
+		setup(res, pgav);
+
+		// The processed data of provisional results are not available
+		if ( res.provisional ) return;
+
+		if ( _config.saveProcessedWaveforms )
+			dumpWaveforms(_currentProcess.get(), res, pgav);
+
+		if ( _config.saveSpectraFiles )
+			dumpSpectra(_currentProcess.get(), res, pgav);
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WFParam::addFinishedResult(const std::string &streamID, Processing::PGAV *pgav) {
+	if ( pgav->status() == WaveformProcessor::Finished )
+		_acquisition->result << "   + PGAV, " << streamID << endl;
+	else
+		_acquisition->result << "   - PGAV, " << streamID << " ("
+		                     << pgav->status().toString()
+		                     << ")" << endl;
+
+	addResult(pgav->lastRecord(), pgav);
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WFParam::dispatch(const std::string &streamID, Processing::PGAV *pgav) {
+	Acquisition *acq = _acquisition.get();
+	acq->deferredJobs.emplace_back(pgav, streamID);
+	DeferredJob *job = &acq->deferredJobs.back();
+
+	// The job list is only modified by the main thread and list elements
+	// do not move, so the worker can safely flag the job as done. The
+	// acquisition is kept until all of its jobs have finished.
+	acq->addJob();
+	_workerPool->push([this, acq, job] {
+		job->proc->processDeferred();
+		acq->finishJob(job);
+		sendNotification(Client::Notification(ProcessingFinished, nullptr));
+	});
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+void WFParam::collectDeferredResults() {
+	// Results are merged in the order the processors finished or were
+	// dispatched in handleRecord, the same order as without workers
+	while ( !_acquisition->deferredJobs.empty() && _acquisition->deferredJobs.front().done ) {
+		DeferredJob &job = _acquisition->deferredJobs.front();
+		PGAV *pgav = job.proc.get();
+
+		if ( pgav->isFinished() )
+			addFinishedResult(job.streamID, pgav);
+		else
+			++_currentProcess->remainingChannels;
+
+		_acquisition->deferredJobs.pop_front();
+	}
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 void WFParam::collectResults() {
-	_report << " + Data request: finished" << endl;
+	_acquisition->report << " + Data request: finished" << endl;
+
+	if ( _workerPool ) {
+		// Wait for all time windows completed during acquisition. The pool
+		// is shared with the other acquisitions, only wait for the jobs of
+		// this one.
+		_acquisition->waitForJobs();
+		collectDeferredResults();
+	}
+
+	if ( _config.offline ) {
+		// Force processing of all incomplete time windows
+		set<PGAV*> pending;
+
+		for ( ProcessorMap::iterator slot_it = _acquisition->processors.begin();
+		      slot_it != _acquisition->processors.end(); ++slot_it ) {
+			for ( ProcessorSlot::iterator it = slot_it->second.begin();
+			      it != slot_it->second.end(); ++it )
+				pending.insert(static_cast<PGAV*>((it->get())));
+		}
+
+		Acquisition *acq = _acquisition.get();
+		for ( PGAV *pgav : pending ) {
+			if ( _workerPool ) {
+				acq->addJob();
+				_workerPool->push([acq, pgav] {
+					pgav->finish();
+					acq->finishJob(nullptr);
+				});
+			}
+			else
+				pgav->finish();
+		}
 
-	for ( ProcessorMap::iterator slot_it = _processors.begin();
-	      slot_it != _processors.end(); ++slot_it ) {
+		if ( _workerPool ) acq->waitForJobs();
+	}
+
+	for ( ProcessorMap::iterator slot_it = _acquisition->processors.begin();
+	      slot_it != _acquisition->processors.end(); ++slot_it ) {
 		for ( ProcessorSlot::iterator it = slot_it->second.begin();
 		      it != slot_it->second.end(); ++it ) {
-			if ( _config.offline )
-				static_cast<PGAV*>((it->get()))->finish();
-
 			if ( (*it)->status() == WaveformProcessor::Finished ) {
-				const Record *rec = (*it)->lastRecord();
-				_result << "   + PGAV, " << slot_it->first.c_str() << endl;
-				PGAV *pgav = static_cast<PGAV*>(it->get());
-				_currentProcess->results.resize(_currentProcess->results.size()+1);
-				++_currentProcess->newValidResults;
-				PGAVResult &res = _currentProcess->results.back();
-				res.valid = true;
-				res.processed = pgav->processed();
-				res.streamID.setNetworkCode(rec->networkCode());
-				res.streamID.setStationCode(rec->stationCode());
-				res.streamID.setLocationCode(rec->locationCode());
-				res.streamID.setChannelCode(rec->channelCode());
-
-				setup(res, pgav);
-
-				if ( _config.saveProcessedWaveforms )
-					dumpWaveforms(_currentProcess.get(), res, pgav);
-
-				if ( _config.saveSpectraFiles )
-					dumpSpectra(_currentProcess.get(), res, pgav);
-
+				_acquisition->result << "   + PGAV, " << slot_it->first.c_str() << endl;
+				addResult((*it)->lastRecord(), static_cast<PGAV*>(it->get()));
 				(*it)->close();
 				continue;
 			}
 			else if ( (*it)->isFinished() ) {
-				const Record *rec = (*it)->lastRecord();
-				PGAV *pgav = static_cast<PGAV*>(it->get());
-				_currentProcess->results.resize(_currentProcess->results.size()+1);
-				PGAVResult &res = _currentProcess->results.back();
-				res.valid = false;
-				res.processed = pgav->processed();
-				res.streamID.setNetworkCode(rec->networkCode());
-				res.streamID.setStationCode(rec->stationCode());
-				res.streamID.setLocationCode(rec->locationCode());
-				res.streamID.setChannelCode(rec->channelCode());
-
-				if ( res.processed ) {
-					setup(res, pgav);
-
-					if ( _config.saveProcessedWaveforms )
-						dumpWaveforms(_currentProcess.get(), res, pgav);
-
-					if ( _config.saveSpectraFiles )
-						dumpSpectra(_currentProcess.get(), res, pgav);
-				}
-
+				addResult((*it)->lastRecord(), static_cast<PGAV*>(it->get()));
 				(*it)->close();
 			}
 			else {
 				// Processor did not receive enough data, lets try later
 				++_currentProcess->remainingChannels;
+
+				// Report the peak values of the data received so far
+				if ( static_cast<PGAV*>(it->get())->hasProvisionalValues() ) {
+					_acquisition->result << "   ~ PGAV, " << slot_it->first.c_str()
+					                     << " (provisional)" << endl;
+					addResult((*it)->lastRecord(), static_cast<PGAV*>(it->get()));
+				}
 			}
 
-			_result << "   - PGAV, " << slot_it->first.c_str()
-			        << " (" << (*it)->status().toString()
-			        << ", " << (*it)->statusValue() << ")" << endl;
+			_acquisition->result << "   - PGAV, " << slot_it->first.c_str()
+			                     << " (" << (*it)->status().toString()
+			                     << ", " << (*it)->statusValue() << ")" << endl;
 
-			_result << "     - TimeWindow: " << (*it)->safetyTimeWindow().startTime().toString("%F %T") << ", "
-			        << (*it)->safetyTimeWindow().endTime().toString("%F %T") << endl;
+			_acquisition->result << "     - TimeWindow: " << (*it)->safetyTimeWindow().startTime().toString("%F %T") << ", "
+			                     << (*it)->safetyTimeWindow().endTime().toString("%F %T") << endl;
 
 			(*it)->close();
 		}
 	}
 
-	_processors.clear();
+	_acquisition->processors.clear();
 
-	double seconds = (double)_acquisitionTimer.elapsed();
+	double seconds = (double)_acquisition->timer.elapsed();
 	SEISCOMP_INFO("Acquisition took %.2f seconds", seconds);
 
 	printReport();
 
-	_report.str(string());
-	_result.str(string());
+	_acquisition->report.str(string());
+	_acquisition->result.str(string());
 
 	StationMap stationMap;
 	StationMap::iterator sit;
@@ -2545,13 +3052,17 @@ void WFParam::collectResults() {
 	if ( !newResultsAvailable && !_config.forceShakemap )
 		SEISCOMP_DEBUG("There aren't any new station results, skip further processing (messaging, shakemap, ...)");
 
+	_acquisition->metrics.collected = _acquisition->metrics.elapsed();
+
 	if ( _config.enableMessagingOutput && newResultsAvailable ) {
+		ScopedTimer timer(_acquisition->metrics.messaging);
 		if ( !sendMessages(connection(), evt.get(), org.get(),
 		                   mag.get(), stationMap) )
 			SEISCOMP_ERROR("Sending result messages failed");
 	}
 
 	if ( _config.shakeMap.output.enable && (newResultsAvailable || _config.forceShakemap) ) {
+		ScopedTimer timer(_acquisition->metrics.shakeMap);
 		ofstream of;
 		Core::Time timestamp = Core::Time::UTC();
 		string eventPath, path;
@@ -2730,7 +3241,7 @@ void WFParam::writeShakeMapComponent(const PGAVResult *res, bool &stationTag,
 		res->streamID.stationCode(),
 		res->streamID.locationCode(),
 		res->streamID.channelCode(),
-		_originTime
+		_acquisition->originTime
 	);
 
 	if ( !stream ) {
@@ -20,6 +20,7 @@
 
 #include <seiscomp/client/streamapplication.h>
 #include <seiscomp/processing/amplitudeprocessor.h>
+#include <seiscomp/io/recordstream.h>
 #include <seiscomp/datamodel/publicobjectcache.h>
 #include <seiscomp/datamodel/eventparameters.h>
 #include <seiscomp/datamodel/amplitude.h>
@@ -32,11 +33,21 @@
 
 #include "app.h"
 #include "util.h"
-
+#include "pool.h"
+#include "stationindex.h"
+#include "waveformcache.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <fstream>
+#include <thread>
 #include <vector>
 #include <set>
 
@@ -68,27 +79,39 @@ class WFParam : public Application {
 		bool run();
 		void done();
 
-		bool storeRecord(Record *rec);
 		void handleRecord(Record *rec);
 
 		bool dispatchNotification(int type, Core::BaseObject *obj);
 
-		void acquisitionFinished();
-
 		void handleMessage(Core::Message *msg);
 		void addObject(const std::string&, DataModel::Object* object);
 		void updateObject(const std::string&, DataModel::Object* object);
+		void removeObject(const std::string&, DataModel::Object* object);
 
 		void handleTimeout();
 
 
 	private:
 		DEFINE_SMARTPOINTER(Process);
+		DEFINE_SMARTPOINTER(Acquisition);
 
 		bool addProcess(DataModel::Event *event);
 		bool startProcess(Process *proc);
 		void stopProcess(Process *proc);
 
+		// Makes acq the acquisition all processing methods work on
+		void activate(Acquisition *acq);
+		bool isAcquiring(const Process *proc) const;
+		bool startAcquisition();
+		void stopAcquisitions();
+		void finishAcquisition(Acquisition *acq);
+		// Thread function reading the records of an acquisition
+		void acquire(Acquisition *acq);
+		// Passes a record from an acquisition thread to the main thread,
+		// nullptr signals the end of the acquisition
+		void deliver(Acquisition *acq, Record *rec);
+		void handleDeliveries();
+
 		bool handle(DataModel::Event *event);
 		bool handle(DataModel::Origin *origin);
 
@@ -110,8 +133,13 @@ class WFParam : public Application {
 		              double ref) const;
 
 		void setup(PGAVResult &res, Processing::PGAV *proc);
+		void addResult(const Record *rec, Processing::PGAV *proc);
+		void addFinishedResult(const std::string &streamID, Processing::PGAV *proc);
+		void dispatch(const std::string &streamID, Processing::PGAV *proc);
+		void collectDeferredResults();
 		void collectResults();
 		void printReport();
+		void reportMetrics();
 
 		// Creates an event id from event. This id has the following format:
 		// EventOriginTime_Mag_Lat_Lon_CreationDate
@@ -139,6 +167,8 @@ class WFParam : public Application {
 			std::vector<std::string> vecMagnitudeFilterTable;
 
 			std::string processingLogfile;
+			std::string metricsFile;
+			std::string metricsGroup;
 			double      saturationThreshold;
 			double      STAlength;
 			double      LTAlength;
@@ -156,6 +186,8 @@ class WFParam : public Application {
 			double      Tmin;
 			double      Tmax;
 			bool        clipTmax;
+			std::string responseSpectrumMethodStr;
+			Processing::PGAV::Config::ResponseSpectrumMethod responseSpectrumMethod;
 
 			bool        afterShockRemoval;
 			bool        eventCutOff;
@@ -184,6 +216,9 @@ class WFParam : public Application {
 
 			bool        enableMessagingOutput;
 
+			int         processingThreads;
+			bool        incrementalProcessing;
+
 			std::string waveformOutputPath;
 			bool        waveformOutputEventDirectory;
 
@@ -191,6 +226,8 @@ class WFParam : public Application {
 			bool        spectraOutputEventDirectory;
 
 			bool        enableDeconvolution;
+			double      responseCacheSize;
+			double      waveformCacheSize;
 			bool        enableNonCausalFilters;
 			double      taperLength;
 			double      padLength;
@@ -212,6 +249,7 @@ class WFParam : public Application {
 			int         wakeupInterval;
 			int         initialAcquisitionTimeout;
 			int         runningAcquisitionTimeout;
+			int         concurrentAcquisitions;
 			int         eventMaxIdleTime;
 
 			double      magnitudeTolerance;
@@ -279,6 +317,116 @@ class WFParam : public Application {
 			bool hasBeenProcessed(DataModel::Stream *) const;
 		};
 
+		// A processor handed over to the worker pool or a processor finished
+		// in the main thread (done) whose result is merged in order with the
+		// results of the workers. The main thread keeps the reference,
+		// workers only access the raw pointer.
+		struct DeferredJob {
+			DeferredJob(Processing::PGAV *p, const std::string &id, bool d = false)
+			: proc(p), streamID(id), done(d) {}
+
+			Processing::PGAVPtr proc;
+			std::string         streamID;
+			std::atomic<bool>   done;
+		};
+
+		using DeferredJobs = std::list<DeferredJob>;
+
+		// Latencies of an acquisition in seconds since it has been started,
+		// negative if a stage has not been reached, and the processing time
+		// of each channel and accumulated over all channels
+		struct Metrics {
+			using StreamTimings = std::pair<std::string, Processing::PGAV::Timings>;
+
+			Metrics()
+			: requested(-1), firstRecord(-1), lastRecord(-1), collected(-1)
+			, records(0), channels(0), messaging(0), shakeMap(0) {}
+
+			double elapsed() const { return (double)watch.elapsed(); }
+
+			Util::StopWatch           watch;
+			double                    requested;
+			double                    firstRecord;
+			double                    lastRecord;
+			double                    collected;
+			size_t                    records;
+			int                       channels;
+			Processing::PGAV::Timings processing;
+			std::vector<StreamTimings> streams;
+			double                    messaging;
+			double                    shakeMap;
+		};
+
+		// The state of the waveform acquisition and processing of one
+		// process run. Each acquisition reads its records with its own
+		// record stream in its own thread, everything else is done in
+		// the main thread.
+		struct Acquisition : Core::BaseObject {
+			Acquisition() : pendingCachedRecords(0), firstRecord(true), timeout(0), runningJobs(0) {}
+
+			// Counts the jobs of this acquisition in the shared worker pool
+			void addJob() {
+				std::unique_lock<std::mutex> lock(jobMutex);
+				++runningJobs;
+			}
+
+			// Called by the worker, flags the deferred job (if any) as done
+			void finishJob(DeferredJob *job) {
+				std::unique_lock<std::mutex> lock(jobMutex);
+				if ( job ) job->done = true;
+				--runningJobs;
+				jobFinished.notify_all();
+			}
+
+			// Blocks until all jobs of this acquisition have finished
+			void waitForJobs() {
+				std::unique_lock<std::mutex> lock(jobMutex);
+				jobFinished.wait(lock, [this] { return runningJobs == 0; });
+			}
+
+			ProcessPtr          process;
+			IO::RecordStreamPtr stream;
+			std::thread         thread;
+
+			ProcessorMap        processors;
+			RequestMap          stationRequests;
+			DeferredJobs        deferredJobs;
+
+			// Records served from the waveform cache
+			WaveformCache::Records cachedRecords;
+			size_t              pendingCachedRecords;
+
+			Core::Time          originTime;
+			double              latitude;
+			double              longitude;
+			double              depth;
+			double              maximumEpicentralDistance;
+			double              totalTimeWindowLength;
+			FilterFreqs         filter;
+
+			bool                firstRecord;
+			int                 timeout;
+			Util::StopWatch     timer;
+			Util::StopWatch     noDataTimer;
+
+			std::stringstream   report;
+			std::stringstream   result;
+			std::ofstream       recordDump;
+
+			Metrics             metrics;
+
+			std::mutex              jobMutex;
+			std::condition_variable jobFinished;
+			int                     runningJobs;
+		};
+
+		struct Delivery {
+			AcquisitionPtr acquisition;
+			RecordPtr      record;
+		};
+
+		using Acquisitions = std::list<AcquisitionPtr>;
+		using Deliveries   = std::deque<Delivery>;
 		using ProcessQueue = std::list<ProcessPtr>;
 		using Processes    = std::map<std::string, ProcessPtr>;
 		using Todos        = std::set<DataModel::EventPtr>;
@@ -288,13 +436,18 @@ class WFParam : public Application {
 
 		DataModel::EventParametersPtr _eventParameters;
 		ProcessPtr                 _currentProcess;
+		AcquisitionPtr             _acquisition;
+		Acquisitions               _acquisitions;
+		Deliveries                 _deliveries;
+		std::mutex                 _deliveryMutex;
 
 		StreamMap                  _streams;
 		Private::StringFirewall    _streamFirewall;
 
 		TravelTimeTable            _travelTime;
-		ProcessorMap               _processors;
-		RequestMap                 _stationRequests;
+		StationIndex               _stationIndex;
+		std::unique_ptr<WorkerPool> _workerPool;
+		WaveformCache              _waveformCache;
 		KeyMap                     _keys;
 
 		Crontab                    _crontab;
@@ -303,35 +456,19 @@ class WFParam : public Application {
 
 		Cache                      _cache;
 
-		bool                       _firstRecord;
-
 		Config                     _config;
 
-		Core::Time                 _originTime;
-		double                     _latitude;
-		double                     _longitude;
-		double                     _depth;
-		double                     _maximumEpicentralDistance;
-		double                     _totalTimeWindowLength;
-		FilterFreqs                _filter;
 		int                        _cronCounter;
-		int                        _acquisitionTimeout;
 		bool                       _wantShakeMapPGA;
 		bool                       _wantShakeMapPGV;
 		std::vector<PeriodID>      _wantShakeMapPSAPeriods;
 
-		Util::StopWatch            _acquisitionTimer;
-		Util::StopWatch            _noDataTimer;
-
 		Todos                      _todos;
 
 		Logging::Channel          *_processingInfoChannel;
 		Logging::Output           *_processingInfoOutput;
-
-		std::stringstream          _report;
-		std::stringstream          _result;
-
-		std::ofstream              _recordDumpOutput;
+		std::ofstream              _metricsOutput;
+		ObjectLog                 *_outputMetrics;
 };
 
 }
@@ -232,6 +232,45 @@ int GetNextSource(char* in_line) {
 
 }
 
+/** function to add a source given as record (e.g. station passed to NLLocArrivals) */
+
+int AddSource(SourceDesc *srce_in) {
+    SourceDesc *srce;
+
+
+    /* check number of sources */
+    if (NumSources >= MAX_NUM_SOURCES) {
+        nll_puterr2("ERROR: to many sources, ignoring source", srce_in->label);
+        return (0);
+    }
+
+    if (srce_in->is_coord_latlon
+            && (checkRangeDouble("SRCE", "Lat", srce_in->dlat, 1, -90.0, 1, 90.0) != 0
+            || checkRangeDouble("SRCE", "Long", srce_in->dlong, 1, -180.0, 1, 180.0) != 0)) {
+        nll_puterr2("ERROR: invalid source coordinates, ignoring source", srce_in->label);
+        return (-1);
+    }
+
+    srce = Source + NumSources;
+    *srce = *srce_in;
+    srce->label[ARRIVAL_LABEL_LEN - 1] = '\0';
+    srce->otime = 0.0;
+
+    // check if duplicate
+    if (FindSource(srce->label) != NULL) {
+        if (message_flag >= 2) {
+            sprintf(MsgStr, "WARNING: duplicated source, ignoring source: %s", srce->label);
+            nll_putmsg(2, MsgStr);
+        }
+        return (0);
+    }
+
+    NumSources++;
+
+    return (0);
+
+}
+
 /** function to read source params fom input line */
 
 int GetSource(char* in_line, SourceDesc *srce_in, int num_sources) {
@@ -875,6 +914,75 @@ void setCascadingGrid(GridDesc* pgrid) {
 
 }
 
+/** function to determine if a grid buffer is in tiled layout */
+
+int isTiledGrid(GridDesc* pgrid) {
+
+    return (pgrid->flagGridTiled == IS_TILED);
+
+}
+
+/** function to get size in bytes of buffer for grid in tiled layout */
+
+size_t TiledGridBufferSize(GridDesc* pgrid) {
+
+    size_t ntiles;
+
+    ntiles = (size_t) ((pgrid->numx + GRID_TILE_MASK) >> GRID_TILE_BITS)
+            * (size_t) ((pgrid->numy + GRID_TILE_MASK) >> GRID_TILE_BITS)
+            * (size_t) ((pgrid->numz + GRID_TILE_MASK) >> GRID_TILE_BITS);
+
+    return (ntiles * (GRID_TILE_SIZE * GRID_TILE_SIZE * GRID_TILE_SIZE) * sizeof (GRID_FLOAT_TYPE));
+
+}
+
+/** function to get offset of node in buffer of grid in tiled layout */
+
+long TiledGridOffset(GridDesc* pgrid, int ix, int iy, int iz) {
+
+    long ntiley = (pgrid->numy + GRID_TILE_MASK) >> GRID_TILE_BITS;
+    long ntilez = (pgrid->numz + GRID_TILE_MASK) >> GRID_TILE_BITS;
+    long itile = ((long) (ix >> GRID_TILE_BITS) * ntiley + (iy >> GRID_TILE_BITS)) * ntilez + (iz >> GRID_TILE_BITS);
+
+    return ((itile << (3 * GRID_TILE_BITS))
+            + ((ix & GRID_TILE_MASK) << (2 * GRID_TILE_BITS))
+            + ((iy & GRID_TILE_MASK) << GRID_TILE_BITS)
+            + (iz & GRID_TILE_MASK));
+
+}
+
+/** function to read entire grid buffer from disk into buffer in tiled layout ***/
+
+int ReadGrid3dBufTiled(GridDesc* pgrid, FILE * fpio) {
+
+    int ix, iy, iz;
+    GRID_FLOAT_TYPE *sheetbuf, *sheet_ptr;
+    GRID_FLOAT_TYPE *buffer = (GRID_FLOAT_TYPE *) pgrid->buffer;
+
+    sheetbuf = (GRID_FLOAT_TYPE *) malloc((size_t) pgrid->numy * pgrid->numz * sizeof (GRID_FLOAT_TYPE));
+    if (sheetbuf == NULL) {
+        nll_puterr2("ERROR: allocating sheet for reading grid file", pgrid->title);
+        return (-1);
+    }
+
+    // read x-sheets and copy nodes to tiles
+    for (ix = 0; ix < pgrid->numx; ix++) {
+        if (ReadGrid3dBufSheet(sheetbuf, pgrid, fpio, ix) < 0) {
+            nll_puterr2("ERROR: reading grid file", pgrid->title);
+            free(sheetbuf);
+            return (-1);
+        }
+        sheet_ptr = sheetbuf;
+        for (iy = 0; iy < pgrid->numy; iy++)
+            for (iz = 0; iz < pgrid->numz; iz++)
+                buffer[TiledGridOffset(pgrid, ix, iy, iz)] = *sheet_ptr++;
+    }
+
+    free(sheetbuf);
+
+    return (0);
+}
+
 /** function to write grid buffer and header to disk ***/
 
 int WriteGrid3dBuf(GridDesc* pgrid, SourceDesc* psrce, char* filename, char* file_type) {
@@ -2146,6 +2254,8 @@ int ReadGrid3dHdr(GridDesc* pgrid, SourceDesc* psrce, char* filename, char* file
         }
     }
 
+    pgrid->flagGridTiled = IS_NOT_TILED;
+
     // check if cascading grid
     pgrid->flagGridCascading = IS_NOT_CASCADING;
     int num_z_merge_depths;
@@ -2308,6 +2418,8 @@ int OpenGrid3dFile(char *fname, FILE **fp_grid, FILE **fp_hdr,
         }
     }
 
+    pgrid->flagGridTiled = IS_NOT_TILED;
+
     // check if cascading grid
     pgrid->flagGridCascading = IS_NOT_CASCADING;
     int num_z_merge_depths;
@@ -2771,6 +2883,8 @@ GRID_FLOAT_TYPE ReadGrid3dValue(FILE *fpgrid, int ix, int iy, int iz, GridDesc *
         }
         if (pgrid->iSwapBytes)
             swapBytes(&fvalue, 1);
+    } else if (isTiledGrid(pgrid)) {
+        fvalue = ((GRID_FLOAT_TYPE *) pgrid->buffer)[TiledGridOffset(pgrid, ix, iy, iz)];
     } else {
 
         fvalue = ((GRID_FLOAT_TYPE ***) pgrid->array)[ix][iy][iz];
@@ -3031,6 +3145,8 @@ GRID_FLOAT_TYPE ReadAbsInterpGrid3d(FILE *fpgrid, GridDesc* pgrid, double xloc,
     if (xdiff + ydiff + zdiff < SMALL_FLOAT) {
         if (fpgrid != NULL)
             value = ReadGrid3dValue(fpgrid, ix0, iy0, iz0, pgrid, 0);
+        else if (isTiledGrid(pgrid))
+            value = buffer[TiledGridOffset(pgrid, ix0, iy0, iz0)];
         else
             value = *(buffer + ix0 * numyz + iy0 * numz + iz0);
         return (value);
@@ -3048,6 +3164,15 @@ GRID_FLOAT_TYPE ReadAbsInterpGrid3d(FILE *fpgrid, GridDesc* pgrid, double xloc,
         vval101 = ReadGrid3dValue(fpgrid, ix1, iy0, iz1, pgrid, 0);
         vval110 = ReadGrid3dValue(fpgrid, ix1, iy1, iz0, pgrid, 0);
         vval111 = ReadGrid3dValue(fpgrid, ix1, iy1, iz1, pgrid, 0);
+    } else if (isTiledGrid(pgrid)) {
+        vval000 = buffer[TiledGridOffset(pgrid, ix0, iy0, iz0)];
+        vval001 = buffer[TiledGridOffset(pgrid, ix0, iy0, iz1)];
+        vval010 = buffer[TiledGridOffset(pgrid, ix0, iy1, iz0)];
+        vval011 = buffer[TiledGridOffset(pgrid, ix0, iy1, iz1)];
+        vval100 = buffer[TiledGridOffset(pgrid, ix1, iy0, iz0)];
+        vval101 = buffer[TiledGridOffset(pgrid, ix1, iy0, iz1)];
+        vval110 = buffer[TiledGridOffset(pgrid, ix1, iy1, iz0)];
+        vval111 = buffer[TiledGridOffset(pgrid, ix1, iy1, iz1)];
     } else {
         /*
         vval000 = pgrid->array[ix0][iy0][iz0];
@@ -3224,6 +3349,207 @@ DOUBLE InterpSquareLagrange(DOUBLE xdiff, DOUBLE zdiff,
 
 }
 
+/** function to interpolate 8 cube vertex values in several grid buffers
+ *
+ * offsets and weights of the vertices are the same for all buffers,
+ * returns -VERY_LARGE_FLOAT for cubes with invalid / mask nodes */
+
+static NLL_TARGET_CLONES void InterpCubeMulti(GRID_FLOAT_TYPE** buffers, int num_grids,
+        const int* offsets, const float* weights, GRID_FLOAT_TYPE* values) {
+
+    int n;
+    float v0, v1, v2, v3, v4, v5, v6, v7, vmin;
+    const GRID_FLOAT_TYPE* buffer;
+
+    for (n = 0; n < num_grids; n++) {
+        buffer = buffers[n];
+        v0 = buffer[offsets[0]];
+        v1 = buffer[offsets[1]];
+        v2 = buffer[offsets[2]];
+        v3 = buffer[offsets[3]];
+        v4 = buffer[offsets[4]];
+        v5 = buffer[offsets[5]];
+        v6 = buffer[offsets[6]];
+        v7 = buffer[offsets[7]];
+        vmin = fminf(fminf(fminf(v0, v1), fminf(v2, v3)), fminf(fminf(v4, v5), fminf(v6, v7)));
+        values[n] = vmin < 0.0F ? -VERY_LARGE_FLOAT
+                : weights[0] * v0 + weights[1] * v1 + weights[2] * v2 + weights[3] * v3
+                + weights[4] * v4 + weights[5] * v5 + weights[6] * v6 + weights[7] * v7;
+    }
+
+}
+
+/** function to read time grid data from several regular 3D grids in memory with the same geometry at absolute location with interpolation
+ *
+ * equivalent to ReadAbsInterpGrid3d() for each buffer, all buffers must have
+ * the layout of pgrid, the enclosing cell and the interpolation weights are
+ * computed once for all grids,
+ * returns number of values that could not be interpolated */
+
+int ReadAbsInterpGrid3dMulti(GridDesc* pgrid, GRID_FLOAT_TYPE** buffers, int num_grids,
+        double xloc, double yloc, double zloc, GRID_FLOAT_TYPE* values) {
+
+    int n, nreject;
+    int ix0, ix1, iy0, iy1, iz0, iz1;
+    int numyz, offsets[8];
+    float weights[8];
+    DOUBLE xoff, yoff, zoff;
+    DOUBLE xdiff, ydiff, zdiff;
+
+    xoff = (xloc - pgrid->origx) / pgrid->dx;
+    yoff = (yloc - pgrid->origy) / pgrid->dy;
+    zoff = (zloc - pgrid->origz) / pgrid->dz;
+
+    /* calculate grid locations on edge of solid containing point */
+
+    ix0 = (int) (xoff - VERY_SMALL_DOUBLE);
+    iy0 = (int) (yoff - VERY_SMALL_DOUBLE);
+    iz0 = (int) (zoff - VERY_SMALL_DOUBLE);
+
+    ix1 = (ix0 < pgrid->numx - 1) ? ix0 + 1 : ix0;
+    iy1 = (iy0 < pgrid->numy - 1) ? iy0 + 1 : iy0;
+    iz1 = (iz0 < pgrid->numz - 1) ? iz0 + 1 : iz0;
+
+    xdiff = xoff - (DOUBLE) ix0;
+    ydiff = yoff - (DOUBLE) iy0;
+    zdiff = zoff - (DOUBLE) iz0;
+
+    if (xdiff < 0.0 || xdiff > 1.0 || ydiff < 0.0 || ydiff > 1.0 || zdiff < 0.0 || zdiff > 1.0) {
+        for (n = 0; n < num_grids; n++)
+            values[n] = -VERY_LARGE_FLOAT;
+        return (num_grids);
+    }
+
+    numyz = pgrid->numy * pgrid->numz;
+
+    /* location at grid node */
+
+    if (xdiff + ydiff + zdiff < SMALL_FLOAT) {
+        if (isTiledGrid(pgrid))
+            offsets[0] = (int) TiledGridOffset(pgrid, ix0, iy0, iz0);
+        else
+            offsets[0] = ix0 * numyz + iy0 * pgrid->numz + iz0;
+        for (n = 0; n < num_grids; n++)
+            values[n] = buffers[n][offsets[0]];
+    } else {
+
+        /* vertex offsets and weights, same order as in InterpCubeLagrange() */
+
+        if (isTiledGrid(pgrid)) {
+            offsets[0] = (int) TiledGridOffset(pgrid, ix0, iy0, iz0);
+            offsets[1] = (int) TiledGridOffset(pgrid, ix0, iy0, iz1);
+            offsets[2] = (int) TiledGridOffset(pgrid, ix0, iy1, iz0);
+            offsets[3] = (int) TiledGridOffset(pgrid, ix0, iy1, iz1);
+            offsets[4] = (int) TiledGridOffset(pgrid, ix1, iy0, iz0);
+            offsets[5] = (int) TiledGridOffset(pgrid, ix1, iy0, iz1);
+            offsets[6] = (int) TiledGridOffset(pgrid, ix1, iy1, iz0);
+            offsets[7] = (int) TiledGridOffset(pgrid, ix1, iy1, iz1);
+        } else {
+            offsets[0] = ix0 * numyz + iy0 * pgrid->numz + iz0;
+            offsets[1] = ix0 * numyz + iy0 * pgrid->numz + iz1;
+            offsets[2] = ix0 * numyz + iy1 * pgrid->numz + iz0;
+            offsets[3] = ix0 * numyz + iy1 * pgrid->numz + iz1;
+            offsets[4] = ix1 * numyz + iy0 * pgrid->numz + iz0;
+            offsets[5] = ix1 * numyz + iy0 * pgrid->numz + iz1;
+            offsets[6] = ix1 * numyz + iy1 * pgrid->numz + iz0;
+            offsets[7] = ix1 * numyz + iy1 * pgrid->numz + iz1;
+        }
+
+        weights[0] = (float) ((1.0 - xdiff) * (1.0 - ydiff) * (1.0 - zdiff));
+        weights[1] = (float) ((1.0 - xdiff) * (1.0 - ydiff) * zdiff);
+        weights[2] = (float) ((1.0 - xdiff) * ydiff * (1.0 - zdiff));
+        weights[3] = (float) ((1.0 - xdiff) * ydiff * zdiff);
+        weights[4] = (float) (xdiff * (1.0 - ydiff) * (1.0 - zdiff));
+        weights[5] = (float) (xdiff * (1.0 - ydiff) * zdiff);
+        weights[6] = (float) (xdiff * ydiff * (1.0 - zdiff));
+        weights[7] = (float) (xdiff * ydiff * zdiff);
+
+        InterpCubeMulti(buffers, num_grids, offsets, weights, values);
+    }
+
+    nreject = 0;
+    for (n = 0; n < num_grids; n++) {
+        if (values[n] < 0.0F)
+            nreject++;
+    }
+
+    return (nreject);
+
+}
+
+/** function to read time grid data from several 2D grid sheets in memory with the same geometry at absolute location with interpolation
+ *
+ * equivalent to ReadAbsInterpGrid2d() for each sheet (y-z plane of the grid
+ * in memory) at distance ylocs[n], the depth cell is computed once for all grids,
+ * returns number of values that could not be interpolated */
+
+int ReadAbsInterpGrid2dMulti(GridDesc* pgrid, GRID_FLOAT_TYPE** sheets, int num_grids,
+        double* ylocs, double zloc, DOUBLE* values) {
+
+    int n, nreject;
+    int iy0, iy1, iz0, iz1, numy, numz;
+    DOUBLE yoff, zoff;
+    DOUBLE ydiff, zdiff;
+    DOUBLE vval00, vval01, vval10, vval11;
+    const GRID_FLOAT_TYPE* sheet;
+
+    numy = pgrid->numy;
+    numz = pgrid->numz;
+
+    zoff = (zloc - pgrid->origz) / pgrid->dz;
+    iz0 = (int) (zoff - VERY_SMALL_DOUBLE);
+    iz1 = (iz0 < numz - 1) ? iz0 + 1 : iz0;
+    zdiff = zoff - (DOUBLE) iz0;
+
+    if (iz0 < 0 || iz1 >= numz || zdiff < 0.0 || zdiff > 1.0) {
+        for (n = 0; n < num_grids; n++)
+            values[n] = -VERY_LARGE_DOUBLE;
+        return (num_grids);
+    }
+
+    nreject = 0;
+    for (n = 0; n < num_grids; n++) {
+
+        yoff = (ylocs[n] - pgrid->origy) / pgrid->dy;
+        iy0 = (int) (yoff - VERY_SMALL_DOUBLE);
+        iy1 = (iy0 < numy - 1) ? iy0 + 1 : iy0;
+        ydiff = yoff - (DOUBLE) iy0;
+
+        if (iy0 < 0 || iy1 >= numy || ydiff < 0.0 || ydiff > 1.0) {
+            values[n] = -VERY_LARGE_DOUBLE;
+            nreject++;
+            continue;
+        }
+
+        sheet = sheets[n];
+
+        /* location at grid node */
+
+        if (ydiff + zdiff < SMALL_FLOAT) {
+            values[n] = sheet[iy0 * numz + iz0];
+            continue;
+        }
+
+        vval00 = sheet[iy0 * numz + iz0];
+        vval01 = sheet[iy0 * numz + iz1];
+        vval10 = sheet[iy1 * numz + iz0];
+        vval11 = sheet[iy1 * numz + iz1];
+
+        // check for invalid / mask nodes
+        if (vval00 < 0.0 || vval01 < 0.0 || vval10 < 0.0 || vval11 < 0.0) {
+            values[n] = -VERY_LARGE_DOUBLE;
+            nreject++;
+            continue;
+        }
+
+        values[n] = InterpSquareLagrange(ydiff, zdiff, vval00, vval01, vval10, vval11);
+
+    }
+
+    return (nreject);
+
+}
+
 /** function to write hypocenter/arrivals to output */
 
 int WriteLocation(FILE *fpio, HypoDesc* phypo, ArrivalDesc* parrivals,
@@ -3867,7 +4193,7 @@ int ReadArrival(char* line, ArrivalDesc* parr, int iReadType) {
     int istat, istat2;
     long int idate, ihrmin;
     char *line_calc;
-    static char label[10 * ARRIVAL_LABEL_LEN];
+    static NLL_THREAD_LOCAL char label[10 * ARRIVAL_LABEL_LEN];
 
     // new values NLL PHASE_2 format
     // 20060629 AJL - Added
@@ -4771,7 +5097,7 @@ void MonthDay(int year, int yearday, int* pmonth, int* pday) {
 
 char* CurrTimeStr(void) {
 
-    static char timestr[MAXLINE];
+    static NLL_THREAD_LOCAL char timestr[MAXLINE];
     time_t curr_time;
 
     curr_time = time(NULL);
@@ -5107,8 +5433,8 @@ int ReadTakeOffAnglesFile(char *fname, double xloc, double yloc, double zloc,
 
 double normal_dist_deviate() {
 
-    static int iset = 0;
-    static float gset;
+    static NLL_THREAD_LOCAL int iset = 0;
+    static NLL_THREAD_LOCAL float gset;
     double fac, r, v1, v2;
 
     if (iset == 0) {
@@ -5484,7 +5810,7 @@ int ReadHypStatistics(FILE **pfpio, char* fnroot_in,
         ArrivalDesc* parrivals, int *pnarrivals) {
 
     char fn_in[FILENAME_MAX];
-    static HypoDesc hypo;
+    static NLL_THREAD_LOCAL HypoDesc hypo;
 
 
     /* open hypocenter file if necessary */
@@ -5557,7 +5883,7 @@ int ReadFocalMech(FILE **pfpio, char* fnroot_in,
         ArrivalDesc* parrivals, int *pnarrivals) {
 
     char fn_in[FILENAME_MAX];
-    static HypoDesc hypo;
+    static NLL_THREAD_LOCAL HypoDesc hypo;
 
 
     /* open hypocenter file if necessary */
@@ -5599,7 +5925,7 @@ int ReadFocalMech(FILE **pfpio, char* fnroot_in,
 int ReadFirstMotionArrivals(FILE **pfpio, char* fnroot_in, ArrivalDesc* parrivals, int *pnarrivals) {
 
     char fn_in[FILENAME_MAX];
-    static HypoDesc hypo;
+    static NLL_THREAD_LOCAL HypoDesc hypo;
 
     // open hypocenter file if necessary
 
@@ -5957,7 +6283,7 @@ int ReadFpfitSum(FILE *fp_in, HypoDesc * phypo) {
     double deg, dmin;
     char strNS[2], strMagType[2];
 
-    static char line[MAXLINE_LONG];
+    static NLL_THREAD_LOCAL char line[MAXLINE_LONG];
 
 
     /* read next line */
@@ -6078,7 +6404,7 @@ int ReadHypoDDInitHypo(FILE *fp_in, HypoDesc *phypo, int n_proj) {
     char *cstat;
     double err_horiz, err_vert;
 
-    static char line[MAXLINE_LONG];
+    static NLL_THREAD_LOCAL char line[MAXLINE_LONG];
 
 
     /* read next line */
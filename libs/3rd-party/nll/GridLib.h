@@ -57,10 +57,29 @@ www.alomax.net
 #endif
  */
 
+/* Globals are thread local so that independent locations can run in
+ * parallel threads of one process. */
+#ifndef NLL_THREAD_LOCAL
+#define NLL_THREAD_LOCAL __thread
+#endif
+
 #ifdef EXTERN_MODE
-#define EXTERN_TXT extern
+#define EXTERN_TXT extern NLL_THREAD_LOCAL
 #else
-#define EXTERN_TXT
+#define EXTERN_TXT NLL_THREAD_LOCAL
+#endif
+
+/* Inner loop kernels are compiled for several instruction sets, the
+ * version for the running CPU is selected at load time. */
+#ifndef NLL_TARGET_CLONES
+#if defined(__x86_64__) && defined(__linux__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define NLL_TARGET_CLONES __attribute__((target_clones("avx2", "default")))
+#endif
+#endif
+#endif
+#ifndef NLL_TARGET_CLONES
+#define NLL_TARGET_CLONES
 #endif
 
 #include "geometry/geometry.h"
@@ -254,6 +273,18 @@ EXTERN_TXT int nll_mode;
 #define IS_CASCADING -243310898   // want value that is extremely unlikely to be in uninitialized int
 #define MAX_NUM_Z_MERGE_DEPTHS 100 // set very large, should typically be +-3
 
+/** tiled grid layout
+ *
+ * buffer is stored as cubic tiles of GRID_TILE_SIZE^3 nodes (x-major tile order,
+ * x-major node order inside a tile), padded to full tiles, so that the nodes
+ * around a location are in few cache lines and pages
+ */
+#define IS_NOT_TILED 0
+#define IS_TILED -517920342   // want value that is extremely unlikely to be in uninitialized int
+#define GRID_TILE_BITS 2
+#define GRID_TILE_SIZE (1 << GRID_TILE_BITS)
+#define GRID_TILE_MASK (GRID_TILE_SIZE - 1)
+
 typedef struct {
     int num_z_merge_depths; // array of (approx) increasing depths in km at which cells will be oct-merged by factor 2 (8 cells become 1 cell, cell side doubled)
     double z_merge_depths[MAX_NUM_Z_MERGE_DEPTHS]; // array of (approx) increasing depths in km at which cells will be oct-merged by factor 2 (8 cells become 1 cell)
@@ -285,6 +316,7 @@ typedef struct {
     GridDesc_Cascading gridDesc_Cascading; // GridDesc_Cascading description, initialized if this grid is a cascading grid (flagGridCascading==IS_CASCADING)
     // 20161021 AJL - added
     char mapProjStr[2 * MAXLINE]; // holds map projection description string from grid hdr if present
+    int flagGridTiled; // set to IS_TILED to flag that buffer is in tiled layout, grid has no array access
 }
 GridDesc;
 
@@ -679,11 +711,11 @@ EXTERN_TXT GridDesc grid_in;
 
 /* source */
 EXTERN_TXT int NumSources;
-EXTERN_TXT SourceDesc Source[MAX_NUM_SOURCES];
+EXTERN_TXT SourceDesc *Source; /* [MAX_NUM_SOURCES], see AllocThreadGlobals() */
 
 /* stations */
 //EXTERN_TXT int NumStations;
-EXTERN_TXT StationDesc Station[MAX_NUM_SOURCES];
+EXTERN_TXT StationDesc *Station; /* [MAX_NUM_SOURCES], see AllocThreadGlobals() */
 
 /* arrivals */
 EXTERN_TXT int PhaseFormat;
@@ -766,6 +798,7 @@ int display_grid_param(GridDesc*);
 int get_mcsyn(char*);
 int get_path_method(char*);
 int GetNextSource(char*);
+int AddSource(SourceDesc*);
 int GetSource(char*, SourceDesc*, int);
 SourceDesc* FindSource(char* label);
 char* projection_str2transform_str(char* trans_str, char* proj_str);
@@ -819,6 +852,10 @@ DOUBLE InterpSquareLagrange(DOUBLE, DOUBLE,
         DOUBLE, DOUBLE, DOUBLE, DOUBLE);
 DOUBLE ReadAbsInterpGrid2d(FILE *, GridDesc*,
         double, double);
+int ReadAbsInterpGrid3dMulti(GridDesc* pgrid, GRID_FLOAT_TYPE** buffers, int num_grids,
+        double xloc, double yloc, double zloc, GRID_FLOAT_TYPE* values);
+int ReadAbsInterpGrid2dMulti(GridDesc* pgrid, GRID_FLOAT_TYPE** sheets, int num_grids,
+        double* ylocs, double zloc, DOUBLE* values);
 int isOnGridBoundary(double, double, double, GridDesc*, double, double, int);
 int IsPointInsideGrid(GridDesc*, double, double, double);
 int IsGridInside(GridDesc*, GridDesc*, int);
@@ -831,6 +868,10 @@ int IsGrid2DBigEnough(GridDesc*, GridDesc*, SourceDesc*,
 // 20161019 AJL - added
 int isCascadingGrid(GridDesc* pgrid);
 void setCascadingGrid(GridDesc* pgrid);
+int isTiledGrid(GridDesc* pgrid);
+size_t TiledGridBufferSize(GridDesc* pgrid);
+long TiledGridOffset(GridDesc* pgrid, int ix, int iy, int iz);
+int ReadGrid3dBufTiled(GridDesc* pgrid, FILE* fpio);
 void* AllocateGrid_Cascading(GridDesc* pgrid, int allocate_buffer);
 void FreeGrid_Cascading(GridDesc * pgrid);
 
@@ -35,6 +35,12 @@ tel: +33(0)493752502  e-mail: anthony@alomax.net  web: http://www.alomax.net
 
 #define EXTERN_MODE 1
 
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "GridLib.h"
 //#include "ran1.h"
 #include "GridMemLib.h"
@@ -47,10 +53,380 @@ tel: +33(0)493752502  e-mail: anthony@alomax.net  web: http://www.alomax.net
 #define USE_GRID_LIST 1
 #define GRIDMEM_MESSAGE 2
 
+/* Grids in memory are shared by all threads and protected by
+ * GridMemListMutex. They are indexed by grid title in a hash table with
+ * chained buckets and linked in a list ordered by last use, most recently
+ * used first. */
+static GridMemStruct** GridMemHash = NULL;
+static int GridMemHashSize = 0;
+static GridMemStruct* GridMemListHead = NULL;
+static GridMemStruct* GridMemListTail = NULL;
+static int GridMemListNumElements = 0;
+static int GridMemListTotalNumElementsAdded = 0;
+static size_t GridMemListTotalSize = 0;
+static size_t GridMemListMaxSize = 0; // 0 = grids are released at the end of NLLoc()
+static int GridMemListMapFiles = 0;
+static int GridMemListTileGrids = 0;
+static GridMemStats GridMemListStats;
+static pthread_mutex_t GridMemListMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t GridMemListLoaded = PTHREAD_COND_INITIALIZER;
+
+#define HASH_SIZE_INITIAL 64
+
+static void GridMemList_Lock() {
+    pthread_mutex_lock(&GridMemListMutex);
+}
+
+static void GridMemList_Unlock() {
+    pthread_mutex_unlock(&GridMemListMutex);
+}
+
+/*** hash of grid title (FNV-1a) ***/
+
+static unsigned int GridMemList_Hash(const char* title) {
+
+    unsigned int hash = 2166136261u;
+
+    while (*title) {
+        hash ^= (unsigned char) *title++;
+        hash *= 16777619u;
+    }
+
+    return (hash);
+
+}
+
+/*** resize hash table, hash size is always a power of 2 ***/
+
+static void GridMemList_Rehash(int newHashSize) {
+
+    int n;
+    unsigned int ibucket;
+    GridMemStruct** newGridMemHash;
+    GridMemStruct* pGridMemStruct;
+
+    newGridMemHash = (GridMemStruct**) calloc(newHashSize, sizeof (GridMemStruct*));
+    if (newGridMemHash == NULL)
+        return;
+
+    for (n = 0; n < GridMemHashSize; n++) {
+        while ((pGridMemStruct = GridMemHash[n]) != NULL) {
+            GridMemHash[n] = pGridMemStruct->hash_next;
+            ibucket = GridMemList_Hash(pGridMemStruct->pgrid->title) & (newHashSize - 1);
+            pGridMemStruct->hash_next = newGridMemHash[ibucket];
+            newGridMemHash[ibucket] = pGridMemStruct;
+        }
+    }
+
+    free(GridMemHash);
+    GridMemHash = newGridMemHash;
+    GridMemHashSize = newHashSize;
+
+}
+
+/*** unlink element from list ordered by last use ***/
+
+static void GridMemList_Unlink(GridMemStruct* pGridMemStruct) {
+
+    if (pGridMemStruct->lru_prev != NULL)
+        pGridMemStruct->lru_prev->lru_next = pGridMemStruct->lru_next;
+    else
+        GridMemListHead = pGridMemStruct->lru_next;
+    if (pGridMemStruct->lru_next != NULL)
+        pGridMemStruct->lru_next->lru_prev = pGridMemStruct->lru_prev;
+    else
+        GridMemListTail = pGridMemStruct->lru_prev;
+    pGridMemStruct->lru_prev = pGridMemStruct->lru_next = NULL;
+
+}
+
+/*** link unlinked element at head of list ordered by last use ***/
+
+static void GridMemList_LinkFirst(GridMemStruct* pGridMemStruct) {
+
+    pGridMemStruct->lru_prev = NULL;
+    pGridMemStruct->lru_next = GridMemListHead;
+    if (GridMemListHead != NULL)
+        GridMemListHead->lru_prev = pGridMemStruct;
+    GridMemListHead = pGridMemStruct;
+    if (GridMemListTail == NULL)
+        GridMemListTail = pGridMemStruct;
+
+}
+
+/*** move element to head of list ordered by last use ***/
+
+static void GridMemList_Touch(GridMemStruct* pGridMemStruct) {
+
+    if (GridMemListHead == pGridMemStruct)
+        return;
+
+    GridMemList_Unlink(pGridMemStruct);
+    GridMemList_LinkFirst(pGridMemStruct);
+
+}
+
+/*** mark element as used by a location ***/
+
+static void GridMemList_Use(GridMemStruct* pGridMemStruct) {
+    pGridMemStruct->active++;
+    GridMemList_Touch(pGridMemStruct);
+}
+
+/*** remove least recently used inactive grids until the memory limit is met ***/
+
+static void GridMemList_Trim() {
+
+    GridMemStruct* pGridMemStruct;
+    GridMemStruct* pGridMemStructPrev;
+
+    if (GridMemListMaxSize == 0)
+        return;
+
+    pGridMemStruct = GridMemListTail;
+    while (pGridMemStruct != NULL && GridMemListTotalSize > GridMemListMaxSize) {
+        pGridMemStructPrev = pGridMemStruct->lru_prev;
+        // grids in use are kept
+        if (!pGridMemStruct->active) {
+            GridMemList_RemoveElement(pGridMemStruct);
+            GridMemListStats.evictions++;
+        }
+        pGridMemStruct = pGridMemStructPrev;
+    }
+
+}
+
+/*** map grid buffer file of an element into memory ***/
+
+/* The mapped pages are shared through the page cache with all processes
+ * using the same grid files and are not counted in the memory limit. */
+
+static void* GridMemList_MapElement(GridMemStruct* pGridMemStruct) {
+
+    int fd;
+    void* addr;
+    struct stat st;
+    char fn_grid[FILENAME_MAX];
+    GridDesc* pgrid = pGridMemStruct->pgrid;
+
+    if (!NLL_CanMapGrid(pgrid))
+        return (NULL);
+
+    // buffer size and cascading grid indices
+    if (isCascadingGrid(pgrid))
+        AllocateGrid_Cascading(pgrid, 0);
+    else
+        pgrid->buffer_size = (size_t) (pgrid->numx * pgrid->numy * pgrid->numz * sizeof (GRID_FLOAT_TYPE));
+
+    // do not map another file if the name does not fit
+    if (snprintf(fn_grid, sizeof(fn_grid), "%s.buf", pgrid->title) >= (int) sizeof(fn_grid))
+        return (NULL);
+    if ((fd = open(fn_grid, O_RDONLY)) < 0)
+        return (NULL);
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < pgrid->buffer_size) {
+        close(fd);
+        return (NULL);
+    }
+    addr = mmap(NULL, pgrid->buffer_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return (NULL);
+    // the whole grid is typically needed, start reading it ahead
+    madvise(addr, pgrid->buffer_size, MADV_WILLNEED);
+
+    pgrid->buffer = addr;
+    pGridMemStruct->mapped = 1;
+    if (message_flag >= GRIDMEM_MESSAGE)
+        printf("GridMemManager: Map grid: %s\n", fn_grid);
+
+    return (addr);
+
+}
+
+/*** unmap grid buffer file of an element ***/
+
+static void GridMemList_UnmapElement(GridMemStruct* pGridMemStruct) {
+
+    if (!pGridMemStruct->mapped)
+        return;
+
+    munmap(pGridMemStruct->pgrid->buffer, pGridMemStruct->pgrid->buffer_size);
+    pGridMemStruct->pgrid->buffer = NULL;
+    pGridMemStruct->buffer = NULL;
+    pGridMemStruct->mapped = 0;
+
+}
+
+/*** allocate buffer and array of an element read from a grid header only ***/
+
+static void* GridMemList_AllocateElement(GridMemStruct* pGridMemStruct) {
+
+    if (GridMemList_MapElement(pGridMemStruct) != NULL) {
+        pGridMemStruct->buffer = pGridMemStruct->pgrid->buffer;
+        pGridMemStruct->array = CreateGridArray(pGridMemStruct->pgrid);
+        if (pGridMemStruct->array == NULL) {
+            GridMemList_UnmapElement(pGridMemStruct);
+            FreeGrid(pGridMemStruct->pgrid);
+            return (NULL);
+        }
+        // nothing to read
+        pGridMemStruct->grid_read = 1;
+        return (pGridMemStruct->buffer);
+    }
+
+    if (GridMemListTileGrids && pGridMemStruct->pgrid->type == GRID_TIME
+            && !isCascadingGrid(pGridMemStruct->pgrid)) {
+        // tiled layout, filled by NLL_ReadGrid3dBuf(), no array access
+        pGridMemStruct->pgrid->flagGridTiled = IS_TILED;
+        pGridMemStruct->pgrid->buffer_size = TiledGridBufferSize(pGridMemStruct->pgrid);
+        pGridMemStruct->pgrid->buffer = malloc(pGridMemStruct->pgrid->buffer_size);
+        if (pGridMemStruct->pgrid->buffer == NULL) {
+            pGridMemStruct->pgrid->flagGridTiled = IS_NOT_TILED;
+            return (NULL);
+        }
+        NumAllocations++;
+        pGridMemStruct->buffer = pGridMemStruct->pgrid->buffer;
+        pGridMemStruct->array = NULL;
+        pGridMemStruct->grid_read = 0;
+
+        GridMemListTotalSize += pGridMemStruct->pgrid->buffer_size;
+        pGridMemStruct->size += pGridMemStruct->pgrid->buffer_size;
+
+        return (pGridMemStruct->buffer);
+    }
+
+    pGridMemStruct->buffer = AllocateGrid(pGridMemStruct->pgrid);
+    if (pGridMemStruct->buffer == NULL)
+        return (NULL);
+    pGridMemStruct->array = CreateGridArray(pGridMemStruct->pgrid);
+    if (pGridMemStruct->array == NULL) {
+        FreeGrid(pGridMemStruct->pgrid);
+        pGridMemStruct->buffer = NULL;
+        return (NULL);
+    }
+    pGridMemStruct->grid_read = 0;
+
+    GridMemListTotalSize += pGridMemStruct->pgrid->buffer_size;
+    pGridMemStruct->size += pGridMemStruct->pgrid->buffer_size;
+
+    return (pGridMemStruct->buffer);
+
+}
+
+/*** set maximum memory used by grids kept between NLLoc() calls ***/
+
+void NLL_SetGridMemoryLimit(size_t max_bytes) {
+
+    GridMemList_Lock();
+    GridMemListMaxSize = max_bytes;
+    GridMemList_Trim();
+    GridMemList_Unlock();
+
+}
+
+/*** set if grid buffer files are mapped into memory instead of being read ***/
+
+void NLL_SetGridMemoryMap(int map_files) {
+
+    GridMemList_Lock();
+    GridMemListMapFiles = map_files;
+    GridMemList_Unlock();
+
+}
+
+/*** set if 3D time grids read into memory are stored in tiled layout ***/
+
+void NLL_SetGridMemoryTiling(int tile_grids) {
+
+    GridMemList_Lock();
+    GridMemListTileGrids = tile_grids;
+    GridMemList_Unlock();
+
+}
+
+/*** check if grid buffer file can be mapped into memory ***/
+
+/* Only time grids stored with the native byte order and float size can be
+ * used directly from the grid file. */
+
+int NLL_CanMapGrid(GridDesc* pgrid) {
+
+    return (GridMemListMapFiles && !pgrid->iSwapBytes
+            && sizeof (GRID_FLOAT_TYPE) == sizeof (float)
+            && (pgrid->type == GRID_TIME || pgrid->type == GRID_TIME_2D));
+
+}
+
+/*** get statistics of grids in memory ***/
+
+void NLL_GetGridMemoryStats(GridMemStats* pstats) {
+
+    GridMemList_Lock();
+    *pstats = GridMemListStats;
+    pstats->num_grids = GridMemListNumElements;
+    pstats->bytes = GridMemListTotalSize;
+    GridMemList_Unlock();
+
+}
+
+/*** wrapper function to open grid files, uses header and buffer of a grid already read into memory if available ***/
+
+/* If the grid is found in memory, pgrid refers to the grid buffer and array
+ * in memory, no files are opened and the grid is used until NLL_FreeGrid()
+ * is called. 2D grids (1D model) are taken from memory if use_memory
+ * contains GRIDMEM_USE_2D, 3D grids if it contains GRIDMEM_USE_3D. */
+
+int NLL_OpenGrid3dFile(char *fname, FILE **fp_grid, FILE **fp_hdr,
+        GridDesc* pgrid, char* file_type, SourceDesc* psrce, int iSwapBytes, int use_memory) {
+
+    int istat;
+    GridMemStruct* pGridMemStruct;
+
+    if (!USE_GRID_LIST)
+        return (OpenGrid3dFile(fname, fp_grid, fp_hdr, pgrid, file_type, psrce, iSwapBytes));
+
+    GridMemList_Lock();
+    pGridMemStruct = GridMemList_Find(fname);
+    if (pGridMemStruct != NULL && pGridMemStruct->grid_read
+            && pGridMemStruct->pgrid->iSwapBytes == iSwapBytes
+            && ((pGridMemStruct->pgrid->type == GRID_TIME_2D && pGridMemStruct->pgrid->numx == 1)
+            ? (use_memory & GRIDMEM_USE_2D) : (use_memory & GRIDMEM_USE_3D))) {
+        GridMemList_Use(pGridMemStruct);
+        GridMemListStats.hits++;
+        *pgrid = *(pGridMemStruct->pgrid);
+        if (psrce != NULL)
+            *psrce = pGridMemStruct->station;
+        *fp_grid = NULL;
+        *fp_hdr = NULL;
+        if (message_flag >= GRIDMEM_MESSAGE)
+            printf("GridMemManager: Grid exists in mem (%d): %s\n", GridMemListNumElements, fname);
+        GridMemList_Unlock();
+        return (0);
+    }
+    GridMemList_Unlock();
+
+    istat = OpenGrid3dFile(fname, fp_grid, fp_hdr, pgrid, file_type, psrce, iSwapBytes);
+    if (istat < 0 || !((pgrid->type == GRID_TIME_2D && pgrid->numx == 1)
+            ? (use_memory & GRIDMEM_USE_2D) : (use_memory & GRIDMEM_USE_3D)))
+        return (istat);
+
+    // keep header and station for later use of the grid in memory
+    strcpy(pgrid->title, fname);
+    GridMemList_Lock();
+    if (GridMemList_Find(fname) == NULL) {
+        pGridMemStruct = GridMemList_AddGridDesc(pgrid);
+        if (pGridMemStruct != NULL && psrce != NULL)
+            pGridMemStruct->station = *psrce;
+    }
+    GridMemList_Unlock();
+
+    return (istat);
+
+}
+
 /*** wrapper function to allocate buffer for 3D grid ***/
 
 void* NLL_AllocateGrid(GridDesc* pgrid) {
-    int index, nactive, ngrid_read, n;
     void* fptr = NULL;
     GridMemStruct* pGridMemStruct = NULL;
 
@@ -58,71 +434,46 @@ void* NLL_AllocateGrid(GridDesc* pgrid) {
 
     if (USE_GRID_LIST) {
 
-        if ((index = GridMemList_IndexOfGridDesc(0, pgrid)) >= 0) {
+        GridMemList_Lock();
+        if ((pGridMemStruct = GridMemList_Find(pgrid->title)) != NULL) {
             // already in list
-                    //int XX_last = NumAllocations;
-            pGridMemStruct = GridMemList_ElementAt(index);
-                    //printf("XXX: Already in list: NumAllocations %d->%d\n", XX_last, NumAllocations);
-            pGridMemStruct->active = 1;
-            fptr = pGridMemStruct->buffer;
-            if (message_flag >= GRIDMEM_MESSAGE)
-                printf("GridMemManager: Grid exists in mem (%d/%d): %s\n", index, GridMemListNumElements, pGridMemStruct->pgrid->title);
-            return (fptr);
-        } else {
-            // check number of active grids in list
-            nactive = 0;
-            ngrid_read = 0;
-            for (n = 0; n < GridMemList_NumElements(); n++) {
-                pGridMemStruct = GridMemList_ElementAt(n);
-                nactive += pGridMemStruct->active;
-                ngrid_read += pGridMemStruct->grid_read;
-            }
-            // list already full of active grids, do normal allocation
-            if (MaxNum3DGridMemory > 0 && nactive >= MaxNum3DGridMemory) {
-                    //int XX_last = NumAllocations;
-                fptr = AllocateGrid(pgrid);
-                    //printf("XXX: Memory Full: NumAllocations %d->%d\n", XX_last, NumAllocations);
-                if (message_flag >= GRIDMEM_MESSAGE)
-                    printf("GridMemManager: Memory full (%d/%d): %s\n", index, GridMemListNumElements, pGridMemStruct->pgrid->title);
-                return (fptr);
-            }
-            // try to replace an inactive grid if possible
-            if (MaxNum3DGridMemory > 0 && ngrid_read >= MaxNum3DGridMemory) {
-                for (n = GridMemList_NumElements() - 1; n >= 0; n--) {
-                    pGridMemStruct = GridMemList_ElementAt(n);
-                    //int XX_last = NumAllocations;
-                    if (!pGridMemStruct->active && (fptr = GridMemList_TryToReplaceElementAt(pGridMemStruct, pgrid)) != NULL) {
-                        // found and replaced identical size grid
-                    //printf("XXX: Replaced Element: NumAllocations %d->%d\n", XX_last, NumAllocations);
-                        return (fptr);
-                    }
+            if (pGridMemStruct->buffer == NULL) {
+                // header only, allocate grid
+                if (GridMemList_AllocateElement(pGridMemStruct) == NULL) {
+                    GridMemList_Unlock();
+                    return (NULL);
                 }
+                GridMemListTotalNumElementsAdded++;
+                GridMemListStats.misses++;
+            } else {
+                GridMemListStats.hits++;
                 if (message_flag >= GRIDMEM_MESSAGE)
-                    printf("GridMemManager: Failed to re-used grid memory list element (%s)\n", pgrid->title);
-            }
-            // remove an inactive grid if necessary
-            if (MaxNum3DGridMemory > 0 && ngrid_read >= MaxNum3DGridMemory) {
-                for (n = GridMemList_NumElements() - 1; n >= 0; n--) {
-                    pGridMemStruct = GridMemList_ElementAt(n);
-                    if (!pGridMemStruct->active && pGridMemStruct->grid_read) {
-                    //int XX_last = NumAllocations;
-                        GridMemList_RemoveElementAt(n);
-                    //printf("XXX: Removed Element: NumAllocations %d->%d\n", XX_last, NumAllocations);
-                        break;
-                    }
-                }
+                    printf("GridMemManager: Grid exists in mem (%d): %s\n", GridMemListNumElements, pGridMemStruct->pgrid->title);
             }
+        } else {
             // create new list element
-                    //int XX_last = NumAllocations;
             pGridMemStruct = GridMemList_AddGridDesc(pgrid);
-                    //printf("XXX: Added Element: NumAllocations %d->%d\n", XX_last, NumAllocations);
-            fptr = pGridMemStruct->buffer;
-            if (fptr == NULL) {
+            if (pGridMemStruct == NULL) {
+                GridMemList_Unlock();
+                return (NULL);
+            }
+            if (GridMemList_AllocateElement(pGridMemStruct) == NULL) {
                 // error allocating grid memory or out of memory
-                GridMemList_RemoveElementAt(GridMemList_NumElements() - 1);
+                GridMemList_RemoveElement(pGridMemStruct);
+                GridMemList_Unlock();
+                return (NULL);
             }
-            return (fptr);
+            GridMemListStats.misses++;
         }
+        GridMemList_Use(pGridMemStruct);
+        fptr = pGridMemStruct->buffer;
+        pgrid->flagGridTiled = pGridMemStruct->pgrid->flagGridTiled;
+        pgrid->buffer_size = pGridMemStruct->pgrid->buffer_size;
+        // make room for the new grid
+        GridMemList_Trim();
+        GridMemList_Unlock();
+
+        return (fptr);
 
     } else {
         fptr = AllocateGrid(pgrid);
@@ -135,16 +486,26 @@ void* NLL_AllocateGrid(GridDesc* pgrid) {
 /*** wrapper function to free buffer for 3D grid ***/
 
 void NLL_FreeGrid(GridDesc* pgrid) {
-    int index;
     GridMemStruct* pGridMemStruct;
 
     //printf("IN: NLL_FreeGrid\n");
-    if (USE_GRID_LIST && (index = GridMemList_IndexOfGridDesc(0, pgrid)) >= 0) {
-        pGridMemStruct = GridMemList_ElementAt(index);
-        pGridMemStruct->active = 0;
-        //pgrid->buffer = NULL;
-
-        return;
+    if (USE_GRID_LIST && pgrid->buffer != NULL) {
+        GridMemList_Lock();
+        if ((pGridMemStruct = GridMemList_Find(pgrid->title)) != NULL
+                && pGridMemStruct->buffer == pgrid->buffer) {
+            if (pGridMemStruct->active > 0)
+                pGridMemStruct->active--;
+            pgrid->buffer = NULL;
+            pgrid->array = NULL;
+            pgrid->gridDesc_Cascading.zindex = NULL;
+            pgrid->gridDesc_Cascading.xyz_scale = NULL;
+            if (!pGridMemStruct->active)
+                GridMemList_Trim();
+            GridMemList_Unlock();
+
+            return;
+        }
+        GridMemList_Unlock();
     }
 
     FreeGrid(pgrid);
@@ -154,17 +515,30 @@ void NLL_FreeGrid(GridDesc* pgrid) {
 /*** free all memory used by grid memory list ***/
 // 20131227 AJL - bug fix, added this function.  Before, grid memory was not freed.
 
+/* Grids in use by other threads are kept. If a memory limit is set, all
+ * grids are kept for the next call of NLLoc(). */
+
 void NLL_FreeGridMemory() {
 
-    int index;
-    int numElements = GridMemListNumElements;
-    // 20141219 AJL - bug fix, GridMemListNumElements is decremented each time GridMemList_RemoveElementAt() called!)
-    //for (index = 0; index < GridMemListNumElements; index++) {
-    for (index = numElements; index >= 0; index--) { // 20141219 AJL - bug fix, must remove from end
-        GridMemList_RemoveElementAt(index);
+    GridMemStruct* pGridMemStruct;
+    GridMemStruct* pGridMemStructNext;
+
+    GridMemList_Lock();
+    if (GridMemListMaxSize > 0) {
+        GridMemList_Unlock();
+        return;
+    }
+    for (pGridMemStruct = GridMemListHead; pGridMemStruct != NULL; pGridMemStruct = pGridMemStructNext) {
+        pGridMemStructNext = pGridMemStruct->lru_next;
+        if (!pGridMemStruct->active)
+            GridMemList_RemoveElement(pGridMemStruct);
     }
-    free(GridMemList); // 20141219 AJL - bug fix, added this free
-    GridMemList = NULL;
+    if (GridMemListNumElements == 0) {
+        free(GridMemHash); // 20141219 AJL - bug fix, added this free
+        GridMemHash = NULL;
+        GridMemHashSize = 0;
+    }
+    GridMemList_Unlock();
 
 }
 
@@ -174,12 +548,12 @@ void*** NLL_CreateGridArray(GridDesc* pgrid) {
 
     void*** fptr = NULL;
 
-    int index;
     GridMemStruct* pGridMemStruct;
 
     //printf("IN: NLL_CreateGridArray\n");
-    if (USE_GRID_LIST && (index = GridMemList_IndexOfGridDesc(0, pgrid)) >= 0) {
-        pGridMemStruct = GridMemList_ElementAt(index);
+    GridMemList_Lock();
+    if (USE_GRID_LIST && (pGridMemStruct = GridMemList_Find(pgrid->title)) != NULL
+            && pGridMemStruct->buffer == pgrid->buffer) {
         fptr = pGridMemStruct->array;
         if (isCascadingGrid(pgrid)) {
             pgrid->gridDesc_Cascading.num_z_merge_depths = pGridMemStruct->pgrid->gridDesc_Cascading.num_z_merge_depths;
@@ -189,7 +563,9 @@ void*** NLL_CreateGridArray(GridDesc* pgrid) {
             pgrid->gridDesc_Cascading.xyz_scale = pGridMemStruct->pgrid->gridDesc_Cascading.xyz_scale;
             pgrid->gridDesc_Cascading.zindex = pGridMemStruct->pgrid->gridDesc_Cascading.zindex;
         }
+        GridMemList_Unlock();
     } else {
+        GridMemList_Unlock();
         fptr = CreateGridArray(pgrid);
     }
 
@@ -202,39 +578,66 @@ void NLL_DestroyGridArray(GridDesc* pgrid) {
 
     //printf("NLL_DestroyGridArray: %s\n", pgrid->title);
 
-    int index;
+    GridMemStruct* pGridMemStruct;
 
     //printf("IN: NLL_DestroyGridArray\n");
-    if (USE_GRID_LIST && (index = GridMemList_IndexOfGridDesc(0, pgrid)) >= 0) {
+    GridMemList_Lock();
+    if (USE_GRID_LIST && pgrid->buffer != NULL && (pGridMemStruct = GridMemList_Find(pgrid->title)) != NULL
+            && pGridMemStruct->buffer == pgrid->buffer) {
         pgrid->array = NULL;
+        GridMemList_Unlock();
 
         return;
     }
+    GridMemList_Unlock();
 
     DestroyGridArray(pgrid);
 }
 
 /*** wrapper function to read entire grid buffer from disk ***/
 
+/* A grid in the memory list is read once. The list is unlocked while the
+ * grid is read, other threads reading the same grid wait until it is
+ * loaded. The element cannot be removed meanwhile since the calling
+ * locations use it (NLL_AllocateGrid()). */
+
 int NLL_ReadGrid3dBuf(GridDesc* pgrid, FILE* fpio) {
 
-    int istat;
+    int istat = 0;
 
-    int index;
     GridMemStruct* pGridMemStruct;
 
     //printf("IN: NLL_ReadGrid3dBuf\n");
-    if (USE_GRID_LIST && (index = GridMemList_IndexOfGridDesc(0, pgrid)) >= 0) {
-        pGridMemStruct = GridMemList_ElementAt(index);
+    GridMemList_Lock();
+    if (USE_GRID_LIST && (pGridMemStruct = GridMemList_Find(pgrid->title)) != NULL
+            && pGridMemStruct->buffer == pgrid->buffer) {
+        while (pGridMemStruct->loading)
+            pthread_cond_wait(&GridMemListLoaded, &GridMemListMutex);
+        // read once, retried by the next thread if reading failed
         if (!pGridMemStruct->grid_read) {
-            istat = ReadGrid3dBuf(pGridMemStruct->pgrid, fpio);
-            pGridMemStruct->grid_read = 1;
+            if (fpio == NULL) {
+                istat = -1;
+            } else {
+                pGridMemStruct->loading = 1;
+                GridMemList_Unlock();
+                if (isTiledGrid(pGridMemStruct->pgrid))
+                    istat = ReadGrid3dBufTiled(pGridMemStruct->pgrid, fpio);
+                else
+                    istat = ReadGrid3dBuf(pGridMemStruct->pgrid, fpio);
+                GridMemList_Lock();
+                pGridMemStruct->loading = 0;
+                if (istat >= 0)
+                    pGridMemStruct->grid_read = 1;
+                pthread_cond_broadcast(&GridMemListLoaded);
+            }
         }
+        GridMemList_Unlock();
     } else {
+        GridMemList_Unlock();
         istat = ReadGrid3dBuf(pgrid, fpio);
     }
 
-    return (0);
+    return (istat < 0 ? -1 : 0);
 }
 
 /*** add GridDescription to GridMemList ***/
@@ -243,15 +646,24 @@ GridMemStruct* GridMemList_AddGridDesc(GridDesc* pgrid) {
     GridMemStruct* pnewGridMemStruct;
 
     //printf("IN: GridMemList_AddGridDesc\n");
-    pnewGridMemStruct = (GridMemStruct*) malloc(sizeof (GridMemStruct));
+    pnewGridMemStruct = (GridMemStruct*) calloc(1, sizeof (GridMemStruct));
+    if (pnewGridMemStruct == NULL)
+        return (NULL);
     pnewGridMemStruct->pgrid = (GridDesc*) malloc(sizeof (GridDesc));
+    if (pnewGridMemStruct->pgrid == NULL) {
+        free(pnewGridMemStruct);
+        return (NULL);
+    }
     *(pnewGridMemStruct->pgrid) = *pgrid;
     strcpy(pnewGridMemStruct->pgrid->chr_type, pgrid->chr_type);
     strcpy(pnewGridMemStruct->pgrid->title, pgrid->title);
-    pnewGridMemStruct->buffer = AllocateGrid(pnewGridMemStruct->pgrid);
-    pnewGridMemStruct->array = CreateGridArray(pnewGridMemStruct->pgrid);
-    pnewGridMemStruct->active = 1;
-    pnewGridMemStruct->grid_read = 0;
+    // allocations are owned by the element
+    pnewGridMemStruct->pgrid->buffer = NULL;
+    pnewGridMemStruct->pgrid->array = NULL;
+    pnewGridMemStruct->pgrid->gridDesc_Cascading.zindex = NULL;
+    pnewGridMemStruct->pgrid->gridDesc_Cascading.xyz_scale = NULL;
+    pnewGridMemStruct->size = sizeof (GridMemStruct) + sizeof (GridDesc);
+    GridMemListTotalSize += pnewGridMemStruct->size;
 
     GridMemList_AddElement(pnewGridMemStruct);
 
@@ -263,37 +675,19 @@ GridMemStruct* GridMemList_AddGridDesc(GridDesc* pgrid) {
 
 /*** add element to GridMemList ***/
 
-#define LIST_SIZE_INCREMENT 10
-
 void GridMemList_AddElement(GridMemStruct* pnewGridMemStruct) {
-    int n;
-    int newGridMemListSize;
-    GridMemStruct** newGridMemList;
+    unsigned int ibucket;
 
     //printf("IN: GridMemList_AddElement\n");
-    if (GridMemListSize <= GridMemListNumElements) {
-        // allocate enlarged list
-        newGridMemListSize = GridMemListSize + LIST_SIZE_INCREMENT;
-        if (newGridMemListSize > MaxNum3DGridMemory) {
-            newGridMemListSize = MaxNum3DGridMemory;
-        }
-        newGridMemList = (GridMemStruct**)
-                malloc(newGridMemListSize * sizeof (GridMemStruct*));
-        // load old list to new list
-        for (n = 0; n < GridMemListSize; n++)
-            newGridMemList[n] = GridMemList[n];
-        for (n = GridMemListSize; n < newGridMemListSize; n++)
-            newGridMemList[n] = NULL;
-        GridMemListSize = newGridMemListSize;
-        if (GridMemList != NULL) {
-            free(GridMemList);
-            GridMemList = NULL;
-        }
-        GridMemList = newGridMemList;
-    }
+    // keep average bucket length below 1
+    if (GridMemHashSize <= GridMemListNumElements)
+        GridMemList_Rehash(GridMemHashSize > 0 ? 2 * GridMemHashSize : HASH_SIZE_INITIAL);
 
     // load new element
-    GridMemList[GridMemListNumElements] = pnewGridMemStruct;
+    ibucket = GridMemList_Hash(pnewGridMemStruct->pgrid->title) & (GridMemHashSize - 1);
+    pnewGridMemStruct->hash_next = GridMemHash[ibucket];
+    GridMemHash[ibucket] = pnewGridMemStruct;
+    GridMemList_LinkFirst(pnewGridMemStruct);
     GridMemListNumElements++;
     GridMemListTotalNumElementsAdded++;
 
@@ -303,161 +697,71 @@ void GridMemList_AddElement(GridMemStruct* pnewGridMemStruct) {
 
 /*** remove element from GridMemList ***/
 
-void GridMemList_RemoveElementAt(int index) {
+void GridMemList_RemoveElement(GridMemStruct* pGridMemStruct) {
 
-    int n;
-    GridMemStruct* pGridMemStruct;
+    unsigned int ibucket;
+    GridMemStruct** ppGridMemStruct;
 
-    //printf("IN: GridMemList_RemoveElementAt\n");
-    // check ranges
-    if (index < 0 || index >= GridMemListNumElements)
-        return;
+    //printf("IN: GridMemList_RemoveElement\n");
+    // unlink from hash bucket
+    ibucket = GridMemList_Hash(pGridMemStruct->pgrid->title) & (GridMemHashSize - 1);
+    for (ppGridMemStruct = GridMemHash + ibucket; *ppGridMemStruct != NULL; ppGridMemStruct = &((*ppGridMemStruct)->hash_next)) {
+        if (*ppGridMemStruct == pGridMemStruct) {
+            *ppGridMemStruct = pGridMemStruct->hash_next;
+            break;
+        }
+    }
+    GridMemList_Unlink(pGridMemStruct);
+    GridMemListNumElements--;
 
     // free allocated memory
-    pGridMemStruct = GridMemList[index];
     if (message_flag >= GRIDMEM_MESSAGE)
-        printf("GridMemManager: Remove grid (%d/%d): %s\n", index, GridMemListNumElements, pGridMemStruct->pgrid->title);
+        printf("GridMemManager: Remove grid (%d): %s\n", GridMemListNumElements, pGridMemStruct->pgrid->title);
+    GridMemListTotalSize -= pGridMemStruct->size;
     DestroyGridArray(pGridMemStruct->pgrid);
+    GridMemList_UnmapElement(pGridMemStruct);
     FreeGrid(pGridMemStruct->pgrid);
     free(pGridMemStruct->pgrid);
     pGridMemStruct->pgrid = NULL;
     free(pGridMemStruct);
-    pGridMemStruct = NULL;
-
-
-    // shift down element references
-    for (n = index; n < GridMemListNumElements - 1; n++)
-        GridMemList[n] = GridMemList[n + 1];
-
-    GridMemList[n] = NULL;
-    GridMemListNumElements--;
 
     return;
 }
 
-/** try to replace element to GridMemList
- *
- * requires that grid are identical in size,
- * returns pointer to grid buffer if identical, returns NULL if not
- *
- */
+/*** find element with grid title in GridMemList ***/
 
-GridMemStruct* GridMemList_TryToReplaceElementAt(GridMemStruct* pGridMemStruct, GridDesc* pgrid) {
+GridMemStruct* GridMemList_Find(const char* title) {
 
-    //printf("DEBUG: GridMemList_TryToReplaceElementAt: test %s / %s\n", pGridMemStruct->pgrid->title, pgrid->title);
+    GridMemStruct* pGridMemStruct;
 
-    // check all relevant grid parameters are identical
-    if (pgrid->dx != pGridMemStruct->pgrid->dx
-            || pgrid->dy != pGridMemStruct->pgrid->dy
-            || pgrid->dz != pGridMemStruct->pgrid->dz
-            ) {
-        //printf("return 0 %f %f %f : %f %f %f\n", pgrid->dx, pgrid->dy, pgrid->dz, pGridMemStruct->pgrid->dx, pGridMemStruct->pgrid->dy, pGridMemStruct->pgrid->dz);
-        return (NULL);
-    }
-    if (pgrid->numx != pGridMemStruct->pgrid->numx
-            || pgrid->numy != pGridMemStruct->pgrid->numy
-            || pgrid->numz != pGridMemStruct->pgrid->numz
-            ) {
-        //printf("return 1 %d %d %d : %d %d %d\n", pgrid->numx, pgrid->numy, pgrid->numz, pGridMemStruct->pgrid->numx, pGridMemStruct->pgrid->numy, pGridMemStruct->pgrid->numz);
-        return (NULL);
-    }
-    if (strcmp(pgrid->float_type, pGridMemStruct->pgrid->float_type)) {
-        //printf("return 3\n");
-        return (NULL);
-    }
-    if (strcmp(pgrid->chr_type, pGridMemStruct->pgrid->chr_type)) {
-        //printf("return 4\n");
-        return (NULL);
-    }
-    if (pgrid->flagGridCascading != pGridMemStruct->pgrid->flagGridCascading) {
-        //printf("return 5\n");
-        return (NULL);
-    }
-    if (pgrid->flagGridCascading) {
-        if (pgrid->gridDesc_Cascading.num_z_merge_depths != pGridMemStruct->pgrid->gridDesc_Cascading.num_z_merge_depths) {
-            //printf("return 6\n");
-            return (NULL);
-        }
-        for (int n = 0; n < pgrid->gridDesc_Cascading.num_z_merge_depths; n++) {
-            if (pgrid->gridDesc_Cascading.z_merge_depths[n] != pGridMemStruct->pgrid->gridDesc_Cascading.z_merge_depths[n]) {
-                //printf("return 7\n");
-                return (NULL);
-            }
-        }
-    }
-    /* following should not be needed, since only dependent (?) on above parameters
-     * also, makes allocations and probably inefficient*/
-    size_t buffer_size = (size_t) (pgrid->numx * pgrid->numy * pgrid->numz * sizeof (GRID_FLOAT_TYPE));
-    if (pgrid->flagGridCascading) {
-        AllocateGrid_Cascading(pgrid, 0); // sets buffer size but does not allocate buffer
-        buffer_size = pgrid->buffer_size;
-    }
-    if (buffer_size != pGridMemStruct->pgrid->buffer_size) {
-        FreeGrid_Cascading(pgrid);
-        //printf("return 2 %ld != %ld\n", buffer_size, pGridMemStruct->pgrid->buffer_size);
+    //printf("IN: GridMemList_Find\n");
+    if (GridMemHashSize == 0)
         return (NULL);
-    }
 
-    // grids are identical, can re-use allocated memory for new grid
-    if (message_flag >= GRIDMEM_MESSAGE)
-        printf("GridMemManager: Successfully re-used grid memory list element allocations (%s -> %s)\n",
-            pgrid->title, pGridMemStruct->pgrid->title);
-    // make sure all previous allocations in GridDesc copy are freed
-    if (isCascadingGrid(pGridMemStruct->pgrid)) {
-        FreeGrid_Cascading(pGridMemStruct->pgrid);
+    pGridMemStruct = GridMemHash[GridMemList_Hash(title) & (GridMemHashSize - 1)];
+    for (; pGridMemStruct != NULL; pGridMemStruct = pGridMemStruct->hash_next) {
+        if (strcmp(pGridMemStruct->pgrid->title, title) == 0)
+            return (pGridMemStruct);
     }
-    //size_t buffer_size = pGridMemStruct->pgrid->buffer_size;
-    *(pGridMemStruct->pgrid) = *pgrid;
-    pGridMemStruct->pgrid->buffer = pGridMemStruct->buffer;
-    pGridMemStruct->pgrid->buffer_size = buffer_size;
-    pGridMemStruct->pgrid->array = pGridMemStruct->array;
-    strcpy(pGridMemStruct->pgrid->chr_type, pgrid->chr_type);
-    strcpy(pGridMemStruct->pgrid->title, pgrid->title);
-    pGridMemStruct->active = 1;
-    pGridMemStruct->grid_read = 0;
-
-    GridMemListTotalNumElementsAdded++;
 
-    return (pGridMemStruct->buffer);
-
-}
-
-/*** return element from GridMemList ***/
-
-GridMemStruct* GridMemList_ElementAt(int index) {
-
-    //printf("IN: GridMemList_ElementAt\n");
-    // check ranges
-    if (index < 0 || index >= GridMemListNumElements)
-        return (NULL);
+    return (NULL);
 
-    return (GridMemList[index]);
 }
 
-/*** find index of grid desc in GridMemList ***/
-
-int GridMemList_IndexOfGridDesc(int verbose, GridDesc* pgrid) {
-
-    //printf("IN: GridMemList_IndexOfGridDesc\n");
-    int n;
-    for (n = 0; n < GridMemListNumElements; n++) {
-        if (verbose) printf("indexOf: %s ==? %s\n", GridMemList[n]->pgrid->title, pgrid->title);
-        if (strcmp(GridMemList[n]->pgrid->title, pgrid->title) == 0)
-            return (n);
-    }
+/*** return size of GridMemList ***/
 
-    if (verbose) printf("indexOf: NOT FOUND\n");
+int GridMemList_NumElements() {
 
-    return (-1);
+    //printf("IN: GridMemList_NumElements\n");
+    return (GridMemListNumElements);
 
 }
 
-/*** return size of GridMemList ***/
+/*** return number of grids added to GridMemList ***/
 
-int GridMemList_NumElements() {
+int GridMemList_NumElementsAdded() {
 
-    //printf("IN: GridMemList_NumElements\n");
-    return (GridMemListNumElements);
+    return (GridMemListTotalNumElementsAdded);
 
 }
 
@@ -465,5 +769,3 @@ int GridMemList_NumElements() {
 
 /** end of 3D grid memory management routines */
 /*------------------------------------------------------------/ */
-
-
@@ -7,32 +7,60 @@ typedef struct gridMem {	/* 3D grid data in memory */
 	void* buffer;		/* corresponding buffer (contiguous floats) */
 	void*** array;		/* corresponding array access to buffer */
 	int grid_read;		/* grid read flag  = 1 if grid has been read from disk */
-	int active;		/* active flag  = 1 if grid is being used in current location */
+	int loading;		/* grid is being read from disk by a thread */
+	int active;		/* number of locations currently using the grid */
+	int mapped;		/* buffer is mapped read-only from the grid buffer file */
+	SourceDesc station;	/* station/source read from the grid header */
+	size_t size;		/* memory used by the element (bytes) */
+	struct gridMem* hash_next;	/* next element in hash bucket */
+	struct gridMem* lru_prev;	/* more recently used element */
+	struct gridMem* lru_next;	/* less recently used element */
 
 
 } GridMemStruct;
 
-/* array of gridMem structure pointers for storing list of grids in memory */
-EXTERN_TXT GridMemStruct** GridMemList;
-EXTERN_TXT int GridMemListSize;
-EXTERN_TXT int GridMemListNumElements;
+typedef struct {	/* statistics of grids in memory */
+
+	unsigned long hits;	/* grids used from memory */
+	unsigned long misses;	/* grids read or mapped into memory */
+	unsigned long evictions;	/* grids released to meet the memory limit */
+	int num_grids;		/* grids currently in memory */
+	size_t bytes;		/* memory currently used (bytes, without mapped grids) */
+
+} GridMemStats;
+
+/* The list of grids in memory is shared by all threads. Grids are kept
+ * between calls of NLLoc() if a memory limit is set with
+ * NLL_SetGridMemoryLimit(), otherwise they are released at the end of
+ * each call. */
 EXTERN_TXT int Num3DGridReadToMemory, MaxNum3DGridMemory;
-EXTERN_TXT int GridMemListTotalNumElementsAdded;
+
+/* flags for NLL_OpenGrid3dFile */
+#define GRIDMEM_USE_3D 1
+#define GRIDMEM_USE_2D 2
 
 /* GridLib wrapper functions */
+void NLL_SetGridMemoryLimit(size_t max_bytes);
+void NLL_SetGridMemoryMap(int map_files);
+void NLL_SetGridMemoryTiling(int tile_grids);
+int NLL_CanMapGrid(GridDesc* pgrid);
+void NLL_GetGridMemoryStats(GridMemStats* pstats);
+int NLL_OpenGrid3dFile(char *fname, FILE **fp_grid, FILE **fp_hdr,
+		GridDesc* pgrid, char* file_type, SourceDesc* psrce, int iSwapBytes, int use_memory);
 void* NLL_AllocateGrid(GridDesc* pgrid);
 void NLL_FreeGrid(GridDesc* pgrid);
 void NLL_FreeGridMemory();
 void*** NLL_CreateGridArray(GridDesc* pgrid);
 void NLL_DestroyGridArray(GridDesc* pgrid);
 int NLL_ReadGrid3dBuf(GridDesc* pgrid, FILE* fpio);
+
+/* GridMemList functions, elements must only be accessed with the list locked */
 GridMemStruct* GridMemList_AddGridDesc(GridDesc* pgrid);
 void GridMemList_AddElement(GridMemStruct* pnewGridMemStruct);
-void GridMemList_RemoveElementAt(int index);
-GridMemStruct* GridMemList_TryToReplaceElementAt(GridMemStruct* pGridMemStruct, GridDesc* pgrid);
-GridMemStruct* GridMemList_ElementAt(int index);
-int GridMemList_IndexOfGridDesc(int verbose, GridDesc* pgrid);
+void GridMemList_RemoveElement(GridMemStruct* pGridMemStruct);
+GridMemStruct* GridMemList_Find(const char* title);
 int GridMemList_NumElements();
+int GridMemList_NumElementsAdded();
 
 
 /** end of grid memory management routines */
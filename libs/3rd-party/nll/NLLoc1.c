@@ -84,7 +84,7 @@ tel: +33(0)493752502  e-mail: anthony@alomax.net  web: http://www.alomax.net
 
 /** function to perform global search event locations */
 
-int NLLoc
+static int NLLoc_main
 (
 
         // calling parameters
@@ -94,6 +94,10 @@ int NLLoc
         int n_param_lines, // number of elements (parameter lines) in array param_line_array (use 0 if fn_control_main not NULL)
         char **obs_line_array, // array of observations file lines (set to NULL if obs file name is read from NLLoc control file)
         int n_obs_lines, // number of elements (obs file lines) in array obs_line_array (set to 0 if obs file name is read from NLLoc control file)
+        ObsArrivalDesc *obs_arrival_array, // array of observation records (set to NULL if observations are given as lines or file)
+        int n_obs_arrivals, // number of elements in array obs_arrival_array
+        SourceDesc *station_array, // array of station coordinates added as sources after reading control statements (may be NULL)
+        int n_stations, // number of elements in array station_array
         int return_locations, // if = 1, return Locations with basic information (HypoDesc* phypo, ArrivalDesc* parrivals, int narrivals, GridDesc* pgrid
         int return_oct_tree_grid, // if = 1 and LOCSEARCH OCT used, includes location probabily density oct-tree structure in Locations (Tree3D* poctTree)
         int return_scatter_sample, // if = 1, includes location location scatter sample data in Locations (float* pscatterSample)
@@ -120,6 +124,13 @@ int NLLoc
     int return_value = EXIT_NORMAL;
 
 
+    /* allocate large globals of this thread on first call */
+    if (AllocThreadGlobals() < 0)
+        return (EXIT_ERROR_MEMORY);
+
+    /* octree memory statistics of this call */
+    resetOctreeMemPeak();
+
     /* set program name */
     strcpy(prog_name, PNAME);
 
@@ -168,10 +179,6 @@ int NLLoc
 
     // GridMemLib
     MaxNum3DGridMemory = -1;
-    GridMemList = NULL;
-    GridMemListSize = 0;
-    GridMemListNumElements = 0;
-    GridMemListTotalNumElementsAdded = 0;
 
     // otime limits
     OtimeLimitList = NULL;
@@ -185,6 +192,10 @@ int NLLoc
     iUseGauss2 = 0;
 
 
+    // observation records
+    ObsRecords = NULL;
+    NumObsRecords = NextObsRecord = 0;
+
     // output
     iSaveNLLocEvent = iSaveNLLocSum = iSaveHypo71Event = iSaveHypo71Sum
             = iSaveHypoEllEvent = iSaveHypoEllSum
@@ -239,9 +250,19 @@ int NLLoc
     }
 
 
-    /* read observation lines into memory stream (must read control file first) */
+    /* add stations passed as records */
+
+    for (n = 0; n < n_stations; n++)
+        AddSource(station_array + n);
+
+
+    /* take observation records or read observation lines into memory stream (must read control file first) */
 
-    if (n_obs_lines > 0) {
+    if (n_obs_arrivals > 0) {
+        ObsRecords = obs_arrival_array;
+        NumObsRecords = n_obs_arrivals;
+        NumObsFiles = 1;
+    } else if (n_obs_lines > 0) {
 #if defined(_GNU_SOURCE) || defined(__APPLE__)
         size_t memory_stream_size;
         FILE *fp_memory_stream = NULL;
@@ -357,7 +378,7 @@ int NLLoc
         nll_putmsg(1, MsgStr);
 
         // check if observations are read from file(s)
-        if ((n_obs_lines <= 0)) {
+        if (n_obs_lines <= 0 && n_obs_arrivals <= 0) {
             /* open observation file */
             if ((fp_obs = fopen(fn_loc_obs[nObsFile], "r")) == NULL) {
                 nll_puterr2("ERROR: opening observations file",
@@ -515,7 +536,7 @@ int NLLoc
 
             sprintf(MsgStr,
                     "Locating... (Files open: Tot:%d Buf:%d Hdr:%d  Alloc: %d  3DMem: used:%d/avail:%d/load:%d) ...",
-                    NumFilesOpen, NumGridBufFilesOpen, NumGridHdrFilesOpen, NumAllocations, Num3DGridReadToMemory, GridMemListSize, GridMemListTotalNumElementsAdded);
+                    NumFilesOpen, NumGridBufFilesOpen, NumGridHdrFilesOpen, NumAllocations, Num3DGridReadToMemory, GridMemList_NumElements(), GridMemList_NumElementsAdded());
             nll_putmsg(1, MsgStr);
 
             for (ngrid = 0; ngrid < NumLocGrids; ngrid++) {
@@ -552,8 +573,11 @@ cleanup:
                 //if (Arrival[narr].n_time_grid < 0) {
                 //if (Arrival[narr].n_time_grid < 0 && !Arrival[narr].flag_ignore) { // 20160925 AJL - bug fix, ignored arrivals should already have grids freed
                 if (Arrival[narr].n_companion < 0 && Arrival[narr].n_time_grid < 0 && !Arrival[narr].flag_ignore) { // 20170207 AJL - bug fix
-                    DestroyGridArray(&(Arrival[narr].sheetdesc));
-                    FreeGrid(&(Arrival[narr].sheetdesc));
+                    // 2D grids in memory are used directly as sheet
+                    if (Arrival[narr].sheetdesc.buffer != Arrival[narr].gdesc.buffer) {
+                        DestroyGridArray(&(Arrival[narr].sheetdesc));
+                        FreeGrid(&(Arrival[narr].sheetdesc));
+                    }
                     NLL_DestroyGridArray(&(Arrival[narr].gdesc));
                     NLL_FreeGrid(&(Arrival[narr].gdesc));
                 }
@@ -589,10 +613,10 @@ cleanup:
         sprintf(MsgStr, "...end of observation file detected.");
         nll_putmsg(1, MsgStr);
 
-        if ((n_obs_lines <= 0)) { // observations are read from file(s)
+        if (n_obs_lines <= 0 && n_obs_arrivals <= 0) { // observations are read from file(s)
             fclose(fp_obs);
             NumFilesOpen--;
-        } else { // observation lines are read from memory stream (20101110 AJL)
+        } else if (fp_obs != NULL) { // observation lines are read from memory stream (20101110 AJL)
             // AJL 20101110 - Bug fix for function version
             fclose(fp_obs);
         }
@@ -720,15 +744,33 @@ cleanup_return:
         free(bp_memory_stream);
         bp_memory_stream = NULL;
     }
+    ObsRecords = NULL;
 
     return (return_value);
 
 }
 
+/** function to perform global search event locations, observations given as file or text lines */
 
+int NLLoc(char *pid_main, char *fn_control_main, char **param_line_array, int n_param_lines, char **obs_line_array, int n_obs_lines,
+        int return_locations, int return_oct_tree_grid, int return_scatter_sample, LocNode **ploc_list_head) {
 
+    return (NLLoc_main(pid_main, fn_control_main, param_line_array, n_param_lines, obs_line_array, n_obs_lines,
+            NULL, 0, NULL, 0, return_locations, return_oct_tree_grid, return_scatter_sample, ploc_list_head));
 
+}
 
+/** function to perform global search event locations, observations and station coordinates given as records
+ *
+ * avoids formatting and re-parsing NLLOC_OBS and LOCSRCE text lines for each call
+ */
 
+int NLLocArrivals(char *pid_main, char *fn_control_main, char **param_line_array, int n_param_lines,
+        ObsArrivalDesc *obs_arrival_array, int n_obs_arrivals, SourceDesc *station_array, int n_stations,
+        int return_locations, int return_oct_tree_grid, int return_scatter_sample, LocNode **ploc_list_head) {
 
+    return (NLLoc_main(pid_main, fn_control_main, param_line_array, n_param_lines, NULL, 0,
+            obs_arrival_array, n_obs_arrivals, station_array, n_stations,
+            return_locations, return_oct_tree_grid, return_scatter_sample, ploc_list_head));
 
+}
@@ -119,6 +119,9 @@ e-mail: anthony@alomax.net  web: http://www.alomax.net
 #include "custom_eth/eth_functions.h"
 #endif
 
+#include <pthread.h>
+#include <stdint.h>
+
 
 // AJL - 20080710 (valgrind)
 /* locally allocated memory which must be cleaned up */
@@ -127,14 +130,99 @@ int clean_memory(int istat);
 
 // EDT_OT_WT_ML allocations
 #define EDT_OT_WT_FLOOR log(0.00001)
-double *ot_ml_arrival = NULL; // array of ot estimate for each arrival
-double *ot_ml_arrival_edt_sum = NULL; // array of weight of ot estimate for each arrival
-int isize_ot_ml_array = 0;
+NLL_THREAD_LOCAL double *ot_ml_arrival = NULL; // array of ot estimate for each arrival
+NLL_THREAD_LOCAL double *ot_ml_arrival_edt_sum = NULL; // array of weight of ot estimate for each arrival
+NLL_THREAD_LOCAL int isize_ot_ml_array = 0;
+
+// CalcSolutionQuality_EDT() fast kernel allocations
+typedef struct {
+    int size;
+    int num;
+    int *index; // arrival index
+    double *block;
+    double *obs_centered, *pred_centered, *sigma2, *amplitude;
+    double *station_weight; // sqrt of station weight
+    double *prior_weight; // sqrt of a priori weight
+    double *prior_valid; // 1.0 if a priori weight is used, else 0.0
+    double *corr; // 1 - correlation coefficient with current row
+    double *prob, *weight; // of the pairs with current row
+    double *prob_sum; // sum of the probabilities of the pairs with rows before
+}
+EDTArrays;
+NLL_THREAD_LOCAL EDTArrays edt_arrays = {0};
 
 // ConstWeightMatrix() allocations
-MatrixDouble wt_matrix = NULL;
-MatrixDouble edt_matrix = NULL;
-int last_matrix_alloc_size = -1;
+NLL_THREAD_LOCAL MatrixDouble wt_matrix = NULL;
+NLL_THREAD_LOCAL MatrixDouble edt_matrix = NULL;
+NLL_THREAD_LOCAL int last_matrix_alloc_size = -1;
+
+// GetNLLoc_SearchPdfGrid() file names
+static NLL_THREAD_LOCAL char (*fn_pdf_grid)[FILENAME_MAX] = NULL; // [MAX_NUM_PDF_GRID_FILES]
+
+// Large globals are allocated per thread on the first call of NLLoc() in a
+// thread and released when the thread exits. Untouched pages of these
+// allocations are not committed, as it was the case for the static arrays.
+static pthread_key_t thread_globals_key;
+static pthread_once_t thread_globals_once = PTHREAD_ONCE_INIT;
+
+static void FreeThreadGlobals(void *unused) {
+
+    free(Source);
+    Source = NULL;
+    free(Station);
+    Station = NULL;
+    free(fn_loc_obs);
+    fn_loc_obs = NULL;
+    free(TimeDelay);
+    TimeDelay = NULL;
+    free(StationPhaseList);
+    StationPhaseList = NULL;
+    free(arrivals_tmp);
+    arrivals_tmp = NULL;
+    free(fn_pdf_grid);
+    fn_pdf_grid = NULL;
+
+    clean_memory(0);
+    CleanWeightMatrix();
+
+}
+
+static void CreateThreadGlobalsKey(void) {
+
+    pthread_key_create(&thread_globals_key, FreeThreadGlobals);
+
+}
+
+/** function to allocate the large globals of the calling thread */
+
+int AllocThreadGlobals() {
+
+    if (Station != NULL)
+        return (0);
+
+    pthread_once(&thread_globals_once, CreateThreadGlobalsKey);
+
+    Source = (SourceDesc *) calloc(MAX_NUM_SOURCES, sizeof (SourceDesc));
+    Station = (StationDesc *) calloc(MAX_NUM_SOURCES, sizeof (StationDesc));
+    fn_loc_obs = calloc(MAX_NUM_OBS_FILES, sizeof (*fn_loc_obs));
+    TimeDelay = (TimeDelayDesc *) calloc(MAX_NUM_STA_DELAYS, sizeof (TimeDelayDesc));
+    StationPhaseList = (SourceDesc *) calloc(X_MAX_NUM_ARRIVALS, sizeof (SourceDesc));
+    arrivals_tmp = (ArrivalDesc *) calloc(MAX_NUM_PHASES_PER_LOC, sizeof (ArrivalDesc));
+    fn_pdf_grid = calloc(MAX_NUM_PDF_GRID_FILES, sizeof (*fn_pdf_grid));
+
+    if (Source == NULL || Station == NULL || fn_loc_obs == NULL || TimeDelay == NULL
+            || StationPhaseList == NULL || arrivals_tmp == NULL || fn_pdf_grid == NULL) {
+        nll_puterr("ERROR: allocating memory for globals.");
+        FreeThreadGlobals(NULL);
+        return (-1);
+    }
+
+    // any non NULL value makes the key destructor run at thread exit
+    pthread_setspecific(thread_globals_key, Station);
+
+    return (0);
+
+}
 
 /** function to perform grid search location */
 
@@ -248,8 +336,9 @@ int Locate(int ngrid, char* fn_loc_obs, char* fn_root_out, int numArrivalsReject
                 Arrival, NumArrivalsLocation, &Metrop,
                 MetLearn + MetEquil, MetStepInit);
 
-        /* allocate scatter array for saved samples */
-        iSizeOfFdata = (1 + MetUse / MetSkip) * 4 * sizeof (float);
+        /* allocate scatter array for saved samples,
+           each chain may save one sample more than its share */
+        iSizeOfFdata = (MetNumChains + MetNumChains + MetUse / MetSkip) * 4 * sizeof (float);
         if ((fdata = (float *) malloc(iSizeOfFdata)) == NULL) {
             nll_puterr("ERROR: creating array for scatter samples.");
             return (clean_memory(EXIT_ERROR_LOCATE));
@@ -850,6 +939,10 @@ int clean_memory(int istat) {
         free(ot_ml_arrival_edt_sum);
     ot_ml_arrival_edt_sum = NULL;
     isize_ot_ml_array = 0;
+    // free EDT fast kernel memory
+    free(edt_arrays.index);
+    free(edt_arrays.block);
+    memset(&edt_arrays, 0, sizeof (edt_arrays));
 
     return (istat);
 
@@ -922,7 +1015,7 @@ void InitializeMetropolisWalk(GridDesc* ptgrid, ArrivalDesc* parrivals, int
 
 }
 
-static int save_location_count = 0;
+static NLL_THREAD_LOCAL int save_location_count = 0;
 
 /** function to display and save minimum misfit location to file */
 
@@ -1328,6 +1421,7 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
     char tmp_phase[PHASE_LABEL_LEN];
     int read_2d_sheets;
     int i_need_elev_corr, n_phs_try;
+    int use_grid_memory;
 
     SourceDesc* pstation;
 
@@ -1350,7 +1444,10 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
 
     // 20180907 AJL - added phypo to recover location information (e.g. magntiude) from observation file
     // 20180907 AJL while ((istat = GetNextObs(fp_obs, arrival + nobs, ftype_obs, ntry++ == 0)) != EOF) {
-    while ((istat = GetNextObs(phypo, fp_obs, arrival + nobs, ftype_obs, ntry++ == 0)) != EOF) {
+    // observation records passed to NLLocArrivals() are taken without text parsing
+    while ((istat = (ObsRecords != NULL
+            ? GetNextObsRecord(arrival + nobs, ftype_obs)
+            : GetNextObs(phypo, fp_obs, arrival + nobs, ftype_obs, ntry++ == 0))) != EOF) {
 
 
         if (istat == OBS_FILE_INTERNAL_ERROR) {
@@ -1476,6 +1573,12 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
         // set some flags
         read_2d_sheets = 1;
         i_need_elev_corr = 0;
+        // take 3D grids from memory only if they would be read to memory below
+        use_grid_memory = ((SearchType == SEARCH_MET || SearchType == SEARCH_OCTTREE)
+                && (MaxNum3DGridMemory < 0 || Num3DGridReadToMemory < MaxNum3DGridMemory)) ? GRIDMEM_USE_3D : 0;
+        // grid-search reads sheets from the open grid file during the search
+        if (SearchType != SEARCH_GRID)
+            use_grid_memory |= GRIDMEM_USE_2D;
 
         strcpy(arrival_phase, arrival[nobs].phase);
 
@@ -1570,12 +1673,12 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
                     arrival_phase, arrival[nobs].time_grid_label);
             sprintf(filename, "%s.time", arrival[nobs].fileroot);
             // try opening time grid file for this phase
-            istat = OpenGrid3dFile(filename,
+            istat = NLL_OpenGrid3dFile(filename,
                     &(arrival[nobs].fpgrid),
                     &(arrival[nobs].fphdr),
                     &(arrival[nobs].gdesc), "time",
                     &(arrival[nobs].station),
-                    arrival[nobs].gdesc.iSwapBytes);
+                    arrival[nobs].gdesc.iSwapBytes, use_grid_memory);
 
             if (istat < 0) {
                 // try to open time grid file using LOCPHASEID mapped phase ID
@@ -1584,12 +1687,12 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
                         eval_phase, arrival[nobs].time_grid_label);
                 sprintf(filename, "%s.time", arrival[nobs].fileroot);
                 /* try opening time grid file for this phase */
-                istat = OpenGrid3dFile(filename,
+                istat = NLL_OpenGrid3dFile(filename,
                         &(arrival[nobs].fpgrid),
                         &(arrival[nobs].fphdr),
                         &(arrival[nobs].gdesc), "time",
                         &(arrival[nobs].station),
-                        arrival[nobs].gdesc.iSwapBytes);
+                        arrival[nobs].gdesc.iSwapBytes, use_grid_memory);
             }
 
             /* try opening P time grid file for S if no P companion phase */
@@ -1598,12 +1701,12 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
                 sprintf(arrival[nobs].fileroot, "%s.%s.%s", fn_grids,
                         "P", arrival[nobs].time_grid_label);
                 sprintf(filename, "%s.time", arrival[nobs].fileroot);
-                istat = OpenGrid3dFile(filename,
+                istat = NLL_OpenGrid3dFile(filename,
                         &(arrival[nobs].fpgrid),
                         &(arrival[nobs].fphdr),
                         &(arrival[nobs].gdesc), "time",
                         &(arrival[nobs].station),
-                        arrival[nobs].gdesc.iSwapBytes);
+                        arrival[nobs].gdesc.iSwapBytes, use_grid_memory);
                 if (message_flag >= 3) {
                     sprintf(MsgStr,
                             "INFO: S phase: using P phase travel time grid file: %s", filename);
@@ -1660,12 +1763,12 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
                             strcpy(arrival[nobs].gdesc.title, arrival[n_time_grid].gdesc.title);
                             istat = 1;
                         } else {
-                            istat = OpenGrid3dFile(filename,
+                            istat = NLL_OpenGrid3dFile(filename,
                                     &(arrival[nobs].fpgrid),
                                     &(arrival[nobs].fphdr),
                                     &(arrival[nobs].gdesc), "time",
                                     &(arrival[nobs].station),
-                                    arrival[nobs].gdesc.iSwapBytes);
+                                    arrival[nobs].gdesc.iSwapBytes, use_grid_memory);
                             if (istat >= 0 && message_flag >= 3) {
                                 sprintf(MsgStr,
                                         "INFO: using DEFAULT travel time grid file: %s", filename);
@@ -1839,12 +1942,37 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
 
         /** prepare time grids access in memory or on disk */
 
+        /* use 2D grids (1D model) directly from memory (not for grid-search) */
+
+        if (read_2d_sheets && SearchType != SEARCH_GRID && arrival[nobs].gdesc.type == GRID_TIME_2D
+                && arrival[nobs].gdesc.numx == 1) {
+            if (arrival[nobs].gdesc.buffer == NULL) {
+                arrival[nobs].gdesc.buffer = NLL_AllocateGrid(&(arrival[nobs].gdesc));
+                if (arrival[nobs].gdesc.buffer != NULL) {
+                    arrival[nobs].gdesc.array = NLL_CreateGridArray(&(arrival[nobs].gdesc));
+                    if (arrival[nobs].gdesc.array == NULL
+                            || NLL_ReadGrid3dBuf(&(arrival[nobs].gdesc), arrival[nobs].fpgrid) < 0) {
+                        sprintf(MsgStr,
+                                "ERROR: reading arrival travel time grid (2D grid), rejecting observation: %s %s",
+                                arrival[nobs].label, arrival[nobs].phase);
+                        nll_puterr(MsgStr);
+                        goto RejectArrival;
+                    }
+                }
+            }
+            if (arrival[nobs].gdesc.buffer != NULL) {
+                CloseGrid3dFile(&(Arrival[nobs].gdesc), &(Arrival[nobs].fpgrid), &(arrival[nobs].fphdr));
+                arrival[nobs].sheetdesc = arrival[nobs].gdesc;
+            }
+        }
+
         /* construct dual-sheet description
         (2D grids for all search types,
         and 3D grids for grid-search) */
 
         if (SearchType == SEARCH_GRID
-                || (read_2d_sheets && arrival[nobs].gdesc.type == GRID_TIME_2D)) {
+                || (read_2d_sheets && arrival[nobs].gdesc.type == GRID_TIME_2D
+                && arrival[nobs].sheetdesc.buffer == NULL)) {
 
             arrival[nobs].sheetdesc = arrival[nobs].gdesc;
             //INGV ??
@@ -1876,9 +2004,14 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
         /* read 3D grid into memory (3D grids for Metropolis or Octtree search) */
 
         //int XX_last = NumAllocations;
-        if ((SearchType == SEARCH_MET || SearchType == SEARCH_OCTTREE)
+        if (arrival[nobs].gdesc.buffer != NULL && arrival[nobs].gdesc.type == GRID_TIME) {
+            /* grid taken from memory in NLL_OpenGrid3dFile() */
+            Num3DGridReadToMemory++;
+        } else if ((SearchType == SEARCH_MET || SearchType == SEARCH_OCTTREE)
                 && arrival[nobs].gdesc.type == GRID_TIME
-                && (MaxNum3DGridMemory < 0 || Num3DGridReadToMemory < MaxNum3DGridMemory)) {
+                && (MaxNum3DGridMemory < 0 || Num3DGridReadToMemory < MaxNum3DGridMemory
+                || NLL_CanMapGrid(&(arrival[nobs].gdesc)))) {
+            // mapped grids use no heap memory and are not limited by MaxNum3DGridMemory
 
             /* allocate grid */
             arrival[nobs].gdesc.buffer = NLL_AllocateGrid(&(arrival[nobs].gdesc));
@@ -1889,7 +2022,8 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
             } else {
                 /* create array access pointers */
                 arrival[nobs].gdesc.array = NLL_CreateGridArray(&(arrival[nobs].gdesc));
-                if (arrival[nobs].gdesc.array == NULL) {
+                // tiled grids are only accessed through the buffer
+                if (arrival[nobs].gdesc.array == NULL && !isTiledGrid(&(arrival[nobs].gdesc))) {
                     nll_puterr(
                             "ERROR: creating array for accessing arrival time grid buffer.");
                     goto RejectArrival;
@@ -1911,8 +2045,10 @@ int GetObservations(FILE* fp_obs, char* ftype_obs, char* fn_grids,
 
         /* read time grid and close file (2D grids)*/
 
-        if (read_2d_sheets && arrival[nobs].gdesc.type == GRID_TIME_2D) {
-            istat = ReadArrivalSheets(1, &(arrival[nobs]), 0.0);
+        if (read_2d_sheets && arrival[nobs].gdesc.type == GRID_TIME_2D
+                && arrival[nobs].sheetdesc.buffer != arrival[nobs].gdesc.buffer) {
+            // sheets can only be read from an open grid file
+            istat = arrival[nobs].fpgrid != NULL ? ReadArrivalSheets(1, &(arrival[nobs]), 0.0) : -1;
             CloseGrid3dFile(&(Arrival[nobs].gdesc), &(Arrival[nobs].fpgrid), &(arrival[nobs].fphdr));
             if (istat < 0) {
                 sprintf(MsgStr,
@@ -1934,6 +2070,13 @@ AcceptArrival:
         /* arrival accepted, ignore for location */
 IgnoreArrival:
 
+        // release grid in memory
+        if (arrival[nobs].flag_ignore && arrival[nobs].n_companion < 0 && arrival[nobs].n_time_grid < 0
+                && arrival[nobs].gdesc.buffer != NULL) {
+            NLL_DestroyGridArray(&(arrival[nobs].gdesc));
+            NLL_FreeGrid(&(arrival[nobs].gdesc));
+        }
+
         *pnignore += arrival[nobs].flag_ignore;
 
         continue;
@@ -1944,6 +2087,12 @@ RejectArrival:
 
         (*pnreject)++;
         arrival[nobs].flag_ignore = 999;
+        // release grid in memory
+        if (arrival[nobs].n_companion < 0 && arrival[nobs].n_time_grid < 0
+                && arrival[nobs].gdesc.buffer != NULL) {
+            NLL_DestroyGridArray(&(arrival[nobs].gdesc));
+            NLL_FreeGrid(&(arrival[nobs].gdesc));
+        }
         if (message_flag >= 3) {
             sprintf(MsgStr, "   Rejected Arrival %d:  %s (%s)  %s %s %s %d",
                     nobs,
@@ -2453,6 +2602,37 @@ int ExtractFilenameInfo(char *filename, char *type_obs) {
 
 }
 
+/** function to set arrival field defaults before reading an observation */
+
+static void InitObsArrival(ArrivalDesc *arrival) {
+
+    strcpy(arrival->label, ARRIVAL_NULL_STR);
+    strcpy(arrival->network, ARRIVAL_NULL_STR);
+    strcpy(arrival->inst, ARRIVAL_NULL_STR);
+    strcpy(arrival->comp, ARRIVAL_NULL_STR);
+    strcpy(arrival->onset, ARRIVAL_NULL_STR);
+    strcpy(arrival->phase, ARRIVAL_NULL_STR);
+    strcpy(arrival->first_mot, ARRIVAL_NULL_STR);
+    arrival->quality = 99;
+    arrival->first_mot_quality = 1.0; // 20200829 AJL - is initialized to 1.0 but may be changed (e.g. )
+    strcpy(arrival->error_type, "GAU");
+    arrival->error = ARRIVAL_ERROR_NULL;
+    arrival->coda_dur = CODA_DUR_NULL;
+    arrival->amplitude = AMPLITUDE_NULL;
+    arrival->period = PERIOD_NULL;
+    arrival->amp_mag = MAGNITUDE_NULL;
+    arrival->dur_mag = MAGNITUDE_NULL;
+    arrival->apriori_weight = 1.0;
+
+    arrival->dd_event_id_1 = -1;
+    arrival->flag_ignore = 0; // 20150521 AJL
+
+    // 20211211 AJL - Bug fix?
+    arrival->sheetdesc.array = NULL;
+    arrival->sheetdesc.buffer = NULL;
+
+}
+
 /** function to read arrival from observation file */
 
 int GetNextObs(HypoDesc* phypo, FILE* fp_obs, ArrivalDesc *arrival, char* ftype_obs, int nfirst) {
@@ -2469,12 +2649,12 @@ int GetNextObs(HypoDesc* phypo, FILE* fp_obs, ArrivalDesc *arrival, char* ftype_
 
     int ioff;
 
-    static char line[MAXLINE_LONG];
+    static NLL_THREAD_LOCAL char line[MAXLINE_LONG];
 
-    static int date_saved, year_save, month_save, day_save;
-    static int check_for_S_arrival;
+    static NLL_THREAD_LOCAL int date_saved, year_save, month_save, day_save;
+    static NLL_THREAD_LOCAL int check_for_S_arrival;
 
-    static int in_hypocenter_event;
+    static NLL_THREAD_LOCAL int in_hypocenter_event;
 
     int ifound;
 
@@ -2486,18 +2666,18 @@ int GetNextObs(HypoDesc* phypo, FILE* fp_obs, ArrivalDesc *arrival, char* ftype_
     double vpvs;
 
     // NEIC / ISC format
-    static char last_label[10];
+    static NLL_THREAD_LOCAL char last_label[10];
     char cmonth[4];
     char* pchr;
-    static int origin_hour = 0;
+    static NLL_THREAD_LOCAL int origin_hour = 0;
 
     // ISC format
     char isc_time_str[10];
 
     // DD
-    static int hypo_cc_flag;
-    static long int dd_event_id_1, dd_event_id_2;
-    static double dd_otime_corr;
+    static NLL_THREAD_LOCAL int hypo_cc_flag;
+    static NLL_THREAD_LOCAL long int dd_event_id_1, dd_event_id_2;
+    static NLL_THREAD_LOCAL double dd_otime_corr;
     double tt_sta1, tt_sta2;
 
     // HYPOINVERSE_Y2000_ARC
@@ -2554,30 +2734,7 @@ int GetNextObs(HypoDesc* phypo, FILE* fp_obs, ArrivalDesc *arrival, char* ftype_
 
 
     /* set field defaults */
-    strcpy(arrival->label, ARRIVAL_NULL_STR);
-    strcpy(arrival->network, ARRIVAL_NULL_STR);
-    strcpy(arrival->inst, ARRIVAL_NULL_STR);
-    strcpy(arrival->comp, ARRIVAL_NULL_STR);
-    strcpy(arrival->onset, ARRIVAL_NULL_STR);
-    strcpy(arrival->phase, ARRIVAL_NULL_STR);
-    strcpy(arrival->first_mot, ARRIVAL_NULL_STR);
-    arrival->quality = 99;
-    arrival->first_mot_quality = 1.0; // 20200829 AJL - is initialized to 1.0 but may be changed (e.g. )
-    strcpy(arrival->error_type, "GAU");
-    arrival->error = ARRIVAL_ERROR_NULL;
-    arrival->coda_dur = CODA_DUR_NULL;
-    arrival->amplitude = AMPLITUDE_NULL;
-    arrival->period = PERIOD_NULL;
-    arrival->amp_mag = MAGNITUDE_NULL;
-    arrival->dur_mag = MAGNITUDE_NULL;
-    arrival->apriori_weight = 1.0;
-
-    arrival->dd_event_id_1 = -1;
-    arrival->flag_ignore = 0; // 20150521 AJL
-
-    // 20211211 AJL - Bug fix?
-    arrival->sheetdesc.array = NULL;
-    arrival->sheetdesc.buffer = NULL;
+    InitObsArrival(arrival);
 
     /* attempt to read obs based on obs file type */
 
@@ -4348,7 +4505,7 @@ int GetNextObs(HypoDesc* phypo, FILE* fp_obs, ArrivalDesc *arrival, char* ftype_
         pchr = arrival->onset;
         // onset 'x' added by AJL to allow zero weighting of phases
         if (!(*pchr == ' ' || *pchr == 'i' || *pchr == 'e' || *pchr == 'q' || *pchr == 'x')) {
-            sprintf(chrtmp, "%c%s", *pchr, arrival->phase);
+            snprintf(chrtmp, sizeof(chrtmp), "%c%.*s", *pchr, (int) sizeof(chrtmp) - 2, arrival->phase);
             strcpy(arrival->phase, chrtmp);
             *pchr = ARRIVAL_NULL_CHR;
         }
@@ -6166,6 +6323,72 @@ arrival->error = 0.2;
     }
 }
 
+/** function to take next arrival from observation records passed to NLLocArrivals()
+ *
+ * fills the same fields as ReadArrival() does for an NLLOC_OBS line, without the text round trip
+ */
+
+int GetNextObsRecord(ArrivalDesc *arrival, char* ftype_obs) {
+
+    ObsArrivalDesc *record;
+    char eval_phase_tmp[PHASE_LABEL_LEN];
+
+
+    if (ObsRecords == NULL || NextObsRecord >= NumObsRecords)
+        return (OBS_FILE_END_OF_INPUT);
+
+    record = ObsRecords + NextObsRecord++;
+
+    /* set field defaults */
+    InitObsArrival(arrival);
+
+    /* copy observation part */
+    strncpy(arrival->label, record->label, ARRIVAL_LABEL_LEN - 1);
+    arrival->label[ARRIVAL_LABEL_LEN - 1] = '\0';
+    strncpy(arrival->inst, record->inst, INST_LABEL_LEN - 1);
+    arrival->inst[INST_LABEL_LEN - 1] = '\0';
+    strncpy(arrival->comp, record->comp, COMP_LABEL_LEN - 1);
+    arrival->comp[COMP_LABEL_LEN - 1] = '\0';
+    strncpy(arrival->onset, record->onset, 1);
+    arrival->onset[1] = '\0';
+    strncpy(arrival->phase, record->phase, PHASE_LABEL_LEN - 1);
+    arrival->phase[PHASE_LABEL_LEN - 1] = '\0';
+    strncpy(arrival->first_mot, record->first_mot, 1);
+    arrival->first_mot[1] = '\0';
+    arrival->year = record->year;
+    arrival->month = record->month;
+    arrival->day = record->day;
+    arrival->hour = record->hour;
+    arrival->min = record->min;
+    arrival->sec = record->sec;
+    strncpy(arrival->error_type, record->error_type, sizeof (record->error_type) - 1);
+    arrival->error_type[sizeof (record->error_type) - 1] = '\0';
+    arrival->error = record->error;
+    arrival->coda_dur = record->coda_dur;
+    arrival->amplitude = record->amplitude;
+    arrival->period = record->period;
+    arrival->apriori_weight = record->apriori_weight;
+
+    // check for QUAL error type and convert to GAU error using LOCQUAL2ERR (see ReadArrival)
+    if (strcmp(arrival->error_type, "QUAL") == 0) {
+        arrival->quality = (int) lround(arrival->error);
+        Qual2Err(arrival);
+    }
+
+    /* convert error to quality */
+    if ((arrival->quality = Err2Qual(arrival)) < 0)
+        arrival->quality = 99;
+
+    // convert phase name using LOCPHASEID if requested (see GetNextObs)
+    if (strstr(ftype_obs, "_LOCPHASEID") != NULL) {
+        EvalPhaseID(eval_phase_tmp, arrival->phase);
+        strcpy(arrival->phase, eval_phase_tmp);
+    }
+
+    return (1);
+
+}
+
 /** function to check if a date is reasonable */
 
 int IsGoodDate(int iyear, int imonth, int iday) {
@@ -6623,6 +6846,11 @@ int LocGridSearch(int ngrid, int num_arr_total, int num_arr_loc,
 
 #define MAX_NUM_MET_TRIES 1000
 
+static int LocMetropolisChains(int ngrid, int num_arr_total, int num_arr_loc,
+        ArrivalDesc *arrival,
+        GridDesc* ptgrid, GaussLocParams* gauss_par, HypoDesc* phypo,
+        WalkParams* pMetrop, float* fdata);
+
 int LocMetropolis(int ngrid, int num_arr_total, int num_arr_loc,
         ArrivalDesc *arrival,
         GridDesc* ptgrid, GaussLocParams* gauss_par, HypoDesc* phypo,
@@ -6657,6 +6885,10 @@ int LocMetropolis(int ngrid, int num_arr_total, int num_arr_loc,
     double dsamp = 0.0, dsamp2;
 
 
+    if (MetNumChains > 1)
+        return (LocMetropolisChains(ngrid, num_arr_total, num_arr_loc, arrival,
+            ptgrid, gauss_par, phypo, pMetrop, fdata));
+
 
     /* get solution quality at each sample on random walk */
 
@@ -7972,6 +8204,215 @@ double CalcSolutionQuality(double hypo_x, double hypo_y, double hypo_z, OctNode*
 
 
 
+/** fast EDT kernel
+ *
+ * CalcSolutionQuality_EDT() sums a probability over all pairs of arrivals,
+ * with an exp() per pair. With fast EDT the arrivals with predicted times are
+ * copied to arrays (structure of arrays) and the pairs of a row are evaluated
+ * in loops the compiler can vectorize, with an exp() approximation and double
+ * instead of long double sums. The misfit differs from the exact kernel by
+ * rounding only (relative error of the exp() approximation < 1e-15), the
+ * default is the exact kernel. */
+
+// use fast EDT kernel, shared by all threads
+static int EDTFastKernel = 0;
+
+/** function to select the fast EDT kernel */
+
+void NLL_SetFastEDT(int fast_edt) {
+
+    EDTFastKernel = fast_edt ? 1 : 0;
+
+}
+
+/** function to calculate exp(x) for x <= 0, 0.0 below -708 instead of a denormal
+ *
+ * range reduction x = k ln2 + r, |r| <= ln2/2, exp(r) by Taylor polynomial of degree 12 */
+
+static inline double edt_exp(double x) {
+
+    const double shift = 6755399441055744.0; // 1.5 * 2^52, rounds to integer
+    const double ln2_hi = 6.93147180369123816490e-01;
+    const double ln2_lo = 1.90821492927058770002e-10;
+    double xc, kd, r, p, scale;
+    uint64_t ki;
+
+    xc = x < -708.0 ? -708.0 : x;
+    kd = xc * 1.44269504088896340736 + shift;
+    memcpy(&ki, &kd, sizeof (ki));
+    kd -= shift;
+    r = xc - kd * ln2_hi - kd * ln2_lo;
+    p = 1.0 + r * (1.0 + r * (1.0 / 2.0 + r * (1.0 / 6.0 + r * (1.0 / 24.0 + r * (1.0 / 120.0
+            + r * (1.0 / 720.0 + r * (1.0 / 5040.0 + r * (1.0 / 40320.0 + r * (1.0 / 362880.0
+            + r * (1.0 / 3628800.0 + r * (1.0 / 39916800.0 + r * (1.0 / 479001600.0))))))))))));
+    // low bits of kd + shift are k, 2^k has exponent k + 1023
+    ki = (ki - (uint64_t) 0x4338000000000000ULL + 1023) << 52;
+    memcpy(&scale, &ki, sizeof (scale));
+
+    return (x < -708.0 ? 0.0 : p * scale);
+
+}
+
+/** function to copy the arrivals with predicted times to the fast EDT kernel arrays
+ *
+ * returns the number of arrivals copied or -1 on allocation error */
+
+static int EDT_SetArrays(EDTArrays *pedt, int num_arrivals, ArrivalDesc *arrival, MatrixDouble edtmtx) {
+
+    int narr, n;
+    double tt_error, *pblock;
+
+    if (pedt->size < num_arrivals) {
+        free(pedt->index);
+        free(pedt->block);
+        memset(pedt, 0, sizeof (EDTArrays));
+        pedt->index = (int *) malloc(num_arrivals * sizeof (int));
+        pedt->block = (double *) malloc((size_t) 11 * num_arrivals * sizeof (double));
+        if (pedt->index == NULL || pedt->block == NULL) {
+            nll_puterr("ERROR: allocating arrays for fast EDT kernel, using exact kernel.");
+            free(pedt->index);
+            free(pedt->block);
+            memset(pedt, 0, sizeof (EDTArrays));
+            return (-1);
+        }
+        pedt->size = num_arrivals;
+        pblock = pedt->block;
+        pedt->obs_centered = pblock;
+        pedt->pred_centered = pblock += num_arrivals;
+        pedt->sigma2 = pblock += num_arrivals;
+        pedt->amplitude = pblock += num_arrivals;
+        pedt->station_weight = pblock += num_arrivals;
+        pedt->prior_weight = pblock += num_arrivals;
+        pedt->prior_valid = pblock += num_arrivals;
+        pedt->corr = pblock += num_arrivals;
+        pedt->prob = pblock += num_arrivals;
+        pedt->weight = pblock += num_arrivals;
+        pedt->prob_sum = pblock += num_arrivals;
+    }
+
+    n = 0;
+    for (narr = 0; narr < num_arrivals; narr++) {
+        if (arrival[narr].pred_travel_time <= 0.0)
+            continue; // ignore obs without predicted times
+        // same error as in CalcSolutionQuality_EDT()
+        if (iUseGauss2) {
+            tt_error = arrival[narr].pred_travel_time * Gauss2.SigmaTfraction;
+            if (tt_error < Gauss2.SigmaTmin)
+                tt_error = Gauss2.SigmaTmin;
+            if (tt_error > Gauss2.SigmaTmax)
+                tt_error = Gauss2.SigmaTmax;
+            tt_error *= tt_error;
+            edtmtx[narr][narr] = arrival[narr].error * arrival[narr].error + tt_error;
+        }
+        pedt->index[n] = narr;
+        pedt->obs_centered[n] = arrival[narr].obs_centered;
+        pedt->pred_centered[n] = arrival[narr].pred_centered;
+        pedt->sigma2[n] = edtmtx[narr][narr];
+        pedt->amplitude[n] = arrival[narr].amplitude;
+        pedt->station_weight[n] = iSetStationDistributionWeights ? sqrt(arrival[narr].station_weight) : 1.0;
+        if (iUseArrivalPriorWeights && arrival[narr].apriori_weight >= -VERY_SMALL_DOUBLE) {
+            pedt->prior_weight[n] = sqrt(fabs(arrival[narr].apriori_weight));
+            pedt->prior_valid[n] = 1.0;
+        } else {
+            pedt->prior_weight[n] = 0.0;
+            pedt->prior_valid[n] = 0.0;
+        }
+        pedt->prob_sum[n] = 0.0;
+        n++;
+    }
+    pedt->num = n;
+
+    return (n);
+
+}
+
+/** functions to calculate the EDT probabilities and weights of the pairs of a row with columns n0..num-1
+ *
+ * station and a priori weights are products of the square roots, the
+ * probability of each pair is added to prob_sum of the column. The arrays are
+ * restrict parameters, so that the loops can be vectorized. */
+
+static void EDT_PairsGauss(int n0, int num, double obs_minus_pred, double sigma2_row, double sigma2_add,
+        double weight_row, double prior_weight_row, double prior_valid_row,
+        const double * restrict obs_centered, const double * restrict pred_centered,
+        const double * restrict sigma2, const double * restrict station_weight,
+        const double * restrict prior_weight, const double * restrict prior_valid,
+        const double * restrict corr, double * restrict prob, double * restrict weight,
+        double * restrict prob_sum) {
+
+    int n;
+    double edt_misfit, weight2, valid;
+
+    for (n = n0; n < num; n++) {
+        edt_misfit = obs_minus_pred + pred_centered[n] - obs_centered[n];
+        weight2 = 1.0 / (sigma2_row + sigma2[n] + sigma2_add);
+        valid = prior_valid_row * prior_valid[n];
+        weight[n] = sqrt(weight2) * corr[n] * weight_row * station_weight[n]
+                * (valid * prior_weight_row * prior_weight[n] + 1.0 - valid);
+        prob[n] = edt_exp(-0.5 * edt_misfit * edt_misfit * weight2) * weight[n];
+        prob_sum[n] += prob[n];
+    }
+
+}
+
+static void EDT_PairsBox(int n0, int num, double obs_minus_pred, double amp_row,
+        double weight_row, double prior_weight_row, double prior_valid_row,
+        const double * restrict obs_centered, const double * restrict pred_centered,
+        const double * restrict amplitude, const double * restrict station_weight,
+        const double * restrict prior_weight, const double * restrict prior_valid,
+        const double * restrict corr, double * restrict prob, double * restrict weight,
+        double * restrict prob_sum) {
+
+    int n;
+    double edt_misfit, valid;
+
+    for (n = n0; n < num; n++) {
+        edt_misfit = obs_minus_pred + pred_centered[n] - obs_centered[n];
+        valid = prior_valid_row * prior_valid[n];
+        weight[n] = amp_row * amplitude[n] * corr[n] * weight_row * station_weight[n]
+                * (valid * prior_weight_row * prior_weight[n] + 1.0 - valid);
+        prob[n] = fabs(edt_misfit) <= amp_row + amplitude[n] ? weight[n] : 0.0;
+        prob_sum[n] += prob[n];
+    }
+
+}
+
+/** function to sum the EDT probabilities and weights of the pairs of row irow with the rows after it */
+
+static void EDT_RowKernel(EDTArrays *pedt, int irow, MatrixDouble edtmtx,
+        double sigma2_row, double sigma2_add, int method_box,
+        double *pprob_sum, double *pweight_sum) {
+
+    int n, num = pedt->num;
+    double *corr_row = edtmtx[pedt->index[irow]];
+    double obs_minus_pred = pedt->obs_centered[irow] - pedt->pred_centered[irow];
+    double sum_prob, sum_weight;
+
+    // correlation coefficients of the row
+    for (n = irow + 1; n < num; n++)
+        pedt->corr[n] = 1.0 - corr_row[pedt->index[n]];
+
+    if (method_box)
+        EDT_PairsBox(irow + 1, num, obs_minus_pred, pedt->amplitude[irow],
+            pedt->station_weight[irow], pedt->prior_weight[irow], pedt->prior_valid[irow],
+            pedt->obs_centered, pedt->pred_centered, pedt->amplitude, pedt->station_weight,
+            pedt->prior_weight, pedt->prior_valid, pedt->corr, pedt->prob, pedt->weight, pedt->prob_sum);
+    else
+        EDT_PairsGauss(irow + 1, num, obs_minus_pred, sigma2_row, sigma2_add,
+            pedt->station_weight[irow], pedt->prior_weight[irow], pedt->prior_valid[irow],
+            pedt->obs_centered, pedt->pred_centered, pedt->sigma2, pedt->station_weight,
+            pedt->prior_weight, pedt->prior_valid, pedt->corr, pedt->prob, pedt->weight, pedt->prob_sum);
+
+    sum_prob = sum_weight = 0.0;
+    for (n = irow + 1; n < num; n++) {
+        sum_prob += pedt->prob[n];
+        sum_weight += pedt->weight[n];
+    }
+    *pprob_sum = sum_prob;
+    *pweight_sum = sum_weight;
+
+}
+
 /** function to calculate probability density */
 
 /*	EDT - sum of probabilities of difference of obs - difference of travel times
@@ -8017,6 +8458,10 @@ double CalcSolutionQuality_EDT(int num_arrivals, ArrivalDesc *arrival,
     //double error_row;
     double amp_row, unc_limit;
 
+    // fast kernel
+    int iuse_fast_edt, iedt, ncol_start;
+    double edt_row_prob, edt_row_weight;
+
     // search pdf different from true
     int iuse_cell_diagonal_time_var;
     //double sigma2_row_search = 0.0;
@@ -8069,6 +8514,9 @@ double CalcSolutionQuality_EDT(int num_arrivals, ArrivalDesc *arrival,
     /*		(TV82, eq. A-38) */
     CalcCenteredTimesPred(num_arrivals, arrival, gauss_par); // not used for EDT
 
+    iuse_fast_edt = EDTFastKernel && EDT_SetArrays(&edt_arrays, num_arrivals, arrival, edtmtx) >= 0;
+    iedt = 0;
+
 
     /* calculate EDT prop sum */
 
@@ -8144,7 +8592,26 @@ double CalcSolutionQuality_EDT(int num_arrivals, ArrivalDesc *arrival,
             ot_error_2 += sigma2_row;
             num_otime_error++;
         }
-        for (ncol = nrow + 1; ncol < num_arrivals; ncol++) {
+        ncol_start = nrow + 1;
+        if (iuse_fast_edt && !no_abs_time_row) {
+            // pairs with all rows after this row in one pass
+            EDT_RowKernel(&edt_arrays, iedt++, edtmtx, sigma2_row,
+                    iuse_cell_diagonal_time_var ? cell_diagonal_time_var : 0.0, method_box,
+                    &edt_row_prob, &edt_row_weight);
+            edt_sum += edt_row_prob;
+            edt_weight += edt_row_weight;
+            if (icalc_otime)
+                arrival[nrow].weight += edt_row_prob;
+            if (EDT_use_otime_weight == 2 || icalc_otime_default) { // EDT_OT_WT_ML or otime
+                ot_ml_arrival_edt_sum[nrow] += edt_row_prob;
+            } else if (EDT_use_otime_weight == 1 || icalc_otime_force_ml) { // EDT_OT_WT or EDT
+                ot_prob += edt_row_prob;
+            }
+            ncol_start = num_arrivals; // pairs done
+        } else if (iuse_fast_edt) {
+            iedt++;
+        }
+        for (ncol = ncol_start; ncol < num_arrivals; ncol++) {
             // AJL 20041115 bug fix!
             if (arrival[ncol].pred_travel_time <= 0.0)
                 continue; // ignore obs without predicted times
@@ -8235,6 +8702,17 @@ double CalcSolutionQuality_EDT(int num_arrivals, ArrivalDesc *arrival,
         }
     }
 
+    // fast kernel, probabilities of the pairs with the rows before each arrival
+    if (iuse_fast_edt) {
+        for (iedt = 0; iedt < edt_arrays.num; iedt++) {
+            nrow = edt_arrays.index[iedt];
+            if (icalc_otime)
+                arrival[nrow].weight += edt_arrays.prob_sum[iedt];
+            if (EDT_use_otime_weight == 2 || icalc_otime_default)
+                ot_ml_arrival_edt_sum[nrow] += edt_arrays.prob_sum[iedt];
+        }
+    }
+
     // OT_WT methods
     if (EDT_use_otime_weight == 2 || icalc_otime_default) { // EDT_OT_WT_ML
         // EDT_OT_WT_ML method
@@ -8442,7 +8920,7 @@ double calc_maximum_likelihood_ot_sort(
 
     // initalize data
     if (poct_node->pdata == NULL)
-        poct_node->pdata = (void *) malloc(sizeof (double));
+        poct_node->pdata = newOctNodeData(poct_node, sizeof (double));
     if (poct_node->pdata != NULL) {
      *((double *) poct_node->pdata) = 0.0;
     } else {
@@ -10337,17 +10815,19 @@ int GetNLLoc_SearchType(char* line1) {
     } else if (strcmp(search_type, "MET") == 0) {
 
         SearchType = SEARCH_MET;
-        istat = sscanf(line1, "%s %d %d %d %d %d %lf %lf %lf %lf",
+        MetNumChains = 1;
+        istat = sscanf(line1, "%s %d %d %d %d %d %lf %lf %lf %lf %d",
                 search_type, &MetNumSamples, &MetLearn, &MetEquil,
                 &MetStartSave, &MetSkip,
-                &MetStepInit, &MetStepMin, &MetStepFact, &MetProbMin);
+                &MetStepInit, &MetStepMin, &MetStepFact, &MetProbMin,
+                &MetNumChains);
         ierr = 0;
 
         sprintf(MsgStr,
-                "LOCSEARCH:  Type: %s  numSamples %d  numLearn %d  numEquilibrate %d  startSave %d  numSkip %d  stepInit %lf  stepMin %lf  stepFact %lf  probMin %lf",
+                "LOCSEARCH:  Type: %s  numSamples %d  numLearn %d  numEquilibrate %d  startSave %d  numSkip %d  stepInit %lf  stepMin %lf  stepFact %lf  probMin %lf  numChains %d",
                 search_type, MetNumSamples, MetLearn, MetEquil,
                 MetStartSave, MetSkip,
-                MetStepInit, MetStepMin, MetStepFact, MetProbMin);
+                MetStepInit, MetStepMin, MetStepFact, MetProbMin, MetNumChains);
         nll_putmsg(3, MsgStr);
 
         if (checkRangeInt("LOCSEARCH", "numSamples", MetNumSamples, 1, 0, 0, 0) != 0)
@@ -10362,9 +10842,11 @@ int GetNLLoc_SearchType(char* line1) {
             ierr = -1;
         if (checkRangeDouble("LOCSEARCH", "stepMin", MetStepMin, 1, 0.0, 0, 0.0) != 0)
             ierr = -1;
+        if (checkRangeInt("LOCSEARCH", "numChains", MetNumChains, 1, 1, 1, MET_MAX_NUM_CHAINS) != 0)
+            ierr = -1;
         if (ierr < 0)
             return (-1);
-        if (istat != 10)
+        if (istat != 10 && istat != 11)
             return (-1);
 
         //?? AJL 17JAN2000 MetUse = MetNumSamples - MetEquil;
@@ -10472,7 +10954,7 @@ int GetNLLoc_PdfGrid(char* line1, int prior_type) {
     }
 
     char grid_type[MAXLINE];
-    static char file_line[MAXLINE_LONG];
+    static NLL_THREAD_LOCAL char file_line[MAXLINE_LONG];
 
     istat = sscanf(line1, "%s", grid_type);
 
@@ -10505,8 +10987,7 @@ int GetNLLoc_PdfGrid(char* line1, int prior_type) {
 
         // read oct-tree grids
         // check for wildcards in observation file name
-        static char fn_pdf_grid[MAX_NUM_PDF_GRID_FILES][FILENAME_MAX];
-        static double coherence[MAX_NUM_PDF_GRID_FILES];
+        static NLL_THREAD_LOCAL double coherence[MAX_NUM_PDF_GRID_FILES];
         int numPdfGridFiles = ExpandWildCards(searchPdfGrid->grid_file_path, fn_pdf_grid, MAX_NUM_PDF_GRID_FILES);
         if (numPdfGridFiles >= MAX_NUM_PDF_GRID_FILES) {
             sprintf(MsgStr, "WARNING: maximum number of pdf grid files files exceeded, only first %d will be processed.", MAX_NUM_PDF_GRID_FILES);
@@ -10532,7 +11013,7 @@ int GetNLLoc_PdfGrid(char* line1, int prior_type) {
                         found_valid_stream_coherences = 0;
                     }
                     // check min_mag
-                    static HypoDesc hypo_self;
+                    static NLL_THREAD_LOCAL HypoDesc hypo_self;
                     if (ReadHypoDesc(file_line, &hypo_self) < -1) {
                         nll_puterr2("ERROR: opening or reading self event hypo file", file_line);
                     }
@@ -10557,7 +11038,7 @@ int GetNLLoc_PdfGrid(char* line1, int prior_type) {
                         // next lines are coherence and oct-tree file root for each child
                         while (fscanf(fp_coherence_test, "%lf %s", &(coherence[numPdfGridFiles]), file_line) > 1) {
                             // check hypo filters
-                            static HypoDesc hypo_other;
+                            static NLL_THREAD_LOCAL HypoDesc hypo_other;
                             if (searchPdfGrid->max_se3 > 0.0 || searchPdfGrid->max_mag_diff > 0.0) {
                                 if (ReadHypoDesc(file_line, &hypo_other) < -1) {
                                     nll_puterr2("ERROR: opening or reading other event hypo file", file_line);
@@ -13581,6 +14062,780 @@ int setStationDistributionWeights(SourceDesc *stations, int numStations, Arrival
 
 /** function to get travel times for all observed arrivals */
 
+/** function to interpolate travel times of arrivals with time grids in memory together
+ *
+ * Regular 3D grids and 2D grids with the same geometry as the first such grid
+ * of the arrivals are interpolated in one pass, tt_ready[narr] is set for these
+ * arrivals and the interpolated time (without tfact and corrections) is
+ * returned in tt[narr], the epicentral grid distance for 2D grids in ydist[narr]. */
+
+#define TT_BATCH_SIZE 64
+
+static void getTravelTimesInMemory(ArrivalDesc *arrival, int num_arr, double xval, double yval, double zval,
+        DOUBLE *tt, double *ydist, char *tt_ready) {
+
+    int narr, n3d, n2d;
+    int index3d[TT_BATCH_SIZE], index2d[TT_BATCH_SIZE];
+    GRID_FLOAT_TYPE *buffers[TT_BATCH_SIZE], *sheets[TT_BATCH_SIZE];
+    GRID_FLOAT_TYPE values3d[TT_BATCH_SIZE];
+    double ylocs[TT_BATCH_SIZE];
+    DOUBLE values2d[TT_BATCH_SIZE];
+    GridDesc *pgrid, *pgrid3d = NULL, *pgrid2d = NULL;
+
+    n3d = n2d = 0;
+    for (narr = 0; narr < num_arr; narr++) {
+        tt_ready[narr] = 0;
+        if (arrival[narr].n_companion >= 0)
+            continue;
+        if (arrival[narr].gdesc.type == GRID_TIME) {
+            pgrid = &(arrival[narr].gdesc);
+            if (pgrid->buffer == NULL || isCascadingGrid(pgrid))
+                continue;
+            if (pgrid3d == NULL)
+                pgrid3d = pgrid;
+            else if (pgrid->numx != pgrid3d->numx || pgrid->numy != pgrid3d->numy || pgrid->numz != pgrid3d->numz
+                    || pgrid->origx != pgrid3d->origx || pgrid->origy != pgrid3d->origy || pgrid->origz != pgrid3d->origz
+                    || pgrid->dx != pgrid3d->dx || pgrid->dy != pgrid3d->dy || pgrid->dz != pgrid3d->dz
+                    || isTiledGrid(pgrid) != isTiledGrid(pgrid3d))
+                continue;
+            buffers[n3d] = (GRID_FLOAT_TYPE *) pgrid->buffer;
+            index3d[n3d++] = narr;
+        } else {
+            pgrid = &(arrival[narr].sheetdesc);
+            if (pgrid->buffer == NULL || isCascadingGrid(pgrid))
+                continue;
+            if (pgrid2d == NULL)
+                pgrid2d = pgrid;
+            else if (pgrid->numy != pgrid2d->numy || pgrid->numz != pgrid2d->numz
+                    || pgrid->origy != pgrid2d->origy || pgrid->origz != pgrid2d->origz
+                    || pgrid->dy != pgrid2d->dy || pgrid->dz != pgrid2d->dz)
+                continue;
+            ydist[narr] = GetEpiDist(&(arrival[narr].station), xval, yval);
+            if (GeometryMode == MODE_GLOBAL)
+                ydist[narr] *= KM2DEG;
+            // y-z plane of grid or of lower sheet
+            sheets[n2d] = ((GRID_FLOAT_TYPE ***) pgrid->array)[0][0];
+            ylocs[n2d] = ydist[narr];
+            index2d[n2d++] = narr;
+        }
+    }
+
+    if (n3d > 0) {
+        ReadAbsInterpGrid3dMulti(pgrid3d, buffers, n3d, xval, yval, zval, values3d);
+        for (narr = 0; narr < n3d; narr++) {
+            tt[index3d[narr]] = (DOUBLE) values3d[narr];
+            tt_ready[index3d[narr]] = 1;
+        }
+    }
+    if (n2d > 0) {
+        ReadAbsInterpGrid2dMulti(pgrid2d, sheets, n2d, ylocs, zval, values2d);
+        for (narr = 0; narr < n2d; narr++) {
+            tt[index2d[narr]] = values2d[narr];
+            tt_ready[index2d[narr]] = 1;
+        }
+    }
+
+}
+
+/** travel times of the arrivals at a batch of oct-tree cells interpolated in parallel
+ *
+ * The cells are given by their center, the same batches serve the proposals of
+ * the chains of a multi-chain Metropolis search. The worker threads only interpolate time grids in memory with
+ * getTravelTimesInMemory(), which does not depend on the library state of
+ * the calling thread apart from GeometryMode. The misfit of the cells is still
+ * evaluated in order by the calling thread, getTravelTimes() takes the
+ * interpolated times of cell oct_tt_cell instead of interpolating again. */
+
+#define OCT_TT_MAX_CELLS 256
+
+typedef struct {
+    ArrivalDesc *arrival;
+    int num_arr;
+    int geometry_mode;
+    Vect3D *cells[OCT_TT_MAX_CELLS]; // cell centers, NULL cells are skipped
+    int num_cells;
+    DOUBLE *tt; // [OCT_TT_MAX_CELLS * num_arr]
+    double *ydist;
+    char *tt_ready;
+    int next_cell;
+    int num_busy;
+    int generation;
+    int quit;
+    int num_threads;
+    pthread_t *threads;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond_work;
+    pthread_cond_t cond_done;
+}
+OctTravelTimes;
+
+// number of threads used for oct-tree cell travel times, shared by all threads
+static int OctreeNumThreads = 1;
+
+static NLL_THREAD_LOCAL OctTravelTimes *oct_tt = NULL;
+static NLL_THREAD_LOCAL int oct_tt_cell = -1;
+
+/** function to set the number of threads interpolating travel times of oct-tree cells */
+
+void NLL_SetOctreeThreads(int num_threads) {
+
+    OctreeNumThreads = num_threads > 1 ? num_threads : 1;
+
+}
+
+static void OctTravelTimes_Cell(OctTravelTimes *ptt, int ncell) {
+
+    int narr;
+    size_t offset;
+    Vect3D *pcenter = ptt->cells[ncell];
+
+    if (pcenter == NULL)
+        return;
+
+    // same batches of arrivals as in getTravelTimes()
+    offset = (size_t) ncell * ptt->num_arr;
+    for (narr = 0; narr < ptt->num_arr; narr += TT_BATCH_SIZE)
+        getTravelTimesInMemory(ptt->arrival + narr,
+            ptt->num_arr - narr < TT_BATCH_SIZE ? ptt->num_arr - narr : TT_BATCH_SIZE,
+            pcenter->x, pcenter->y, pcenter->z,
+            ptt->tt + offset + narr, ptt->ydist + offset + narr, ptt->tt_ready + offset + narr);
+
+}
+
+/** function to process cells of the current batch, called with ptt->mutex locked */
+
+static void OctTravelTimes_Process(OctTravelTimes *ptt) {
+
+    int ncell;
+
+    while ((ncell = ptt->next_cell) < ptt->num_cells) {
+        ptt->next_cell++;
+        pthread_mutex_unlock(&ptt->mutex);
+        OctTravelTimes_Cell(ptt, ncell);
+        pthread_mutex_lock(&ptt->mutex);
+    }
+
+}
+
+static void *OctTravelTimes_Worker(void *arg) {
+
+    OctTravelTimes *ptt = (OctTravelTimes *) arg;
+    int generation = 0;
+
+    // library state is thread local
+    GeometryMode = ptt->geometry_mode;
+
+    pthread_mutex_lock(&ptt->mutex);
+    while (1) {
+        while (ptt->generation == generation && !ptt->quit)
+            pthread_cond_wait(&ptt->cond_work, &ptt->mutex);
+        if (ptt->quit)
+            break;
+        generation = ptt->generation;
+        OctTravelTimes_Process(ptt);
+        if (--ptt->num_busy == 0)
+            pthread_cond_signal(&ptt->cond_done);
+    }
+    pthread_mutex_unlock(&ptt->mutex);
+
+    return (NULL);
+
+}
+
+/** function to interpolate travel times of cells ptt->cells[0..num_cells-1] */
+
+static void OctTravelTimes_Run(OctTravelTimes *ptt, int num_cells) {
+
+    pthread_mutex_lock(&ptt->mutex);
+    ptt->num_cells = num_cells;
+    ptt->next_cell = 0;
+    ptt->num_busy = ptt->num_threads;
+    ptt->generation++;
+    pthread_cond_broadcast(&ptt->cond_work);
+    // calling thread works on the batch too
+    OctTravelTimes_Process(ptt);
+    while (ptt->num_busy > 0)
+        pthread_cond_wait(&ptt->cond_done, &ptt->mutex);
+    pthread_mutex_unlock(&ptt->mutex);
+
+}
+
+/** function to interpolate travel times of the initial cells of an oct-tree starting at index ncell_start */
+
+static void OctTravelTimes_RunTree(OctTravelTimes *ptt, Tree3D* pOctTree, int ncell_start) {
+
+    int ncell, num_cells, ix, iy, iz;
+
+    num_cells = pOctTree->numx * pOctTree->numy * pOctTree->numz - ncell_start;
+    if (num_cells > OCT_TT_MAX_CELLS)
+        num_cells = OCT_TT_MAX_CELLS;
+    for (ncell = 0; ncell < num_cells; ncell++) {
+        iz = (ncell_start + ncell) % pOctTree->numz;
+        iy = ((ncell_start + ncell) / pOctTree->numz) % pOctTree->numy;
+        ix = (ncell_start + ncell) / (pOctTree->numz * pOctTree->numy);
+        ptt->cells[ncell] = pOctTree->nodeArray[ix][iy][iz] != NULL ? &pOctTree->nodeArray[ix][iy][iz]->center : NULL;
+    }
+
+    OctTravelTimes_Run(ptt, num_cells);
+
+}
+
+static void OctTravelTimes_Stop(OctTravelTimes *ptt) {
+
+    int n;
+
+    if (ptt == NULL)
+        return;
+
+    pthread_mutex_lock(&ptt->mutex);
+    ptt->quit = 1;
+    pthread_cond_broadcast(&ptt->cond_work);
+    pthread_mutex_unlock(&ptt->mutex);
+    for (n = 0; n < ptt->num_threads; n++)
+        pthread_join(ptt->threads[n], NULL);
+
+    pthread_cond_destroy(&ptt->cond_done);
+    pthread_cond_destroy(&ptt->cond_work);
+    pthread_mutex_destroy(&ptt->mutex);
+    free(ptt->threads);
+    free(ptt->tt);
+    free(ptt->ydist);
+    free(ptt->tt_ready);
+    free(ptt);
+
+}
+
+/** function to start threads interpolating travel times of oct-tree cells
+ *
+ * returns NULL if the travel times are interpolated sequentially */
+
+static OctTravelTimes *OctTravelTimes_Start(ArrivalDesc *arrival, int num_arr) {
+
+    int narr;
+    size_t size;
+    OctTravelTimes *ptt;
+
+    if (OctreeNumThreads < 2 || num_arr < 1)
+        return (NULL);
+
+    // check for time grids in memory
+    for (narr = 0; narr < num_arr; narr++) {
+        if (arrival[narr].n_companion >= 0)
+            continue;
+        if (arrival[narr].gdesc.type == GRID_TIME ? arrival[narr].gdesc.buffer != NULL
+                : arrival[narr].sheetdesc.buffer != NULL)
+            break;
+    }
+    if (narr == num_arr)
+        return (NULL);
+
+    if ((ptt = (OctTravelTimes *) calloc(1, sizeof (OctTravelTimes))) == NULL)
+        return (NULL);
+    ptt->arrival = arrival;
+    ptt->num_arr = num_arr;
+    ptt->geometry_mode = GeometryMode;
+    size = (size_t) OCT_TT_MAX_CELLS * num_arr;
+    ptt->tt = (DOUBLE *) malloc(size * sizeof (DOUBLE));
+    ptt->ydist = (double *) malloc(size * sizeof (double));
+    ptt->tt_ready = (char *) malloc(size * sizeof (char));
+    ptt->threads = (pthread_t *) calloc(OctreeNumThreads - 1, sizeof (pthread_t));
+    pthread_mutex_init(&ptt->mutex, NULL);
+    pthread_cond_init(&ptt->cond_work, NULL);
+    pthread_cond_init(&ptt->cond_done, NULL);
+    if (ptt->tt == NULL || ptt->ydist == NULL || ptt->tt_ready == NULL || ptt->threads == NULL) {
+        nll_puterr("WARNING: allocating memory for oct-tree travel times, interpolating sequentially.");
+        OctTravelTimes_Stop(ptt);
+        return (NULL);
+    }
+
+    for (ptt->num_threads = 0; ptt->num_threads < OctreeNumThreads - 1; ptt->num_threads++) {
+        if (pthread_create(ptt->threads + ptt->num_threads, NULL, OctTravelTimes_Worker, ptt) != 0)
+            break;
+    }
+    if (ptt->num_threads == 0) {
+        OctTravelTimes_Stop(ptt);
+        return (NULL);
+    }
+
+    return (ptt);
+
+}
+
+/** state of a chain of a multi-chain Metropolis search */
+
+typedef struct {
+    WalkParams walk;
+    UniState rng; // random number stream of the chain
+    Vect3D sample; // proposed sample
+    int above_topo;
+    int active;
+    int ntry, nSamples, nSampStat, numAcceptDeepMinima, numSave;
+    long int ngenerated;
+    double currentMetStepFact;
+    double misfit_min, dlike_max;
+    double xmean_sum, ymean_sum, zmean_sum;
+    double xvar_sum, yvar_sum, zvar_sum;
+    double save_sum[3], save_sum2[3]; // sums of saved samples
+}
+MetChain;
+
+/** function to perform Metropolis location with MetNumChains independent chains
+ *
+ * All chains start at the initial walk sample, each draws from its own stream
+ * of the random number generator seeded from the stream of the calling thread.
+ * The chains advance in lockstep: the next sample of every chain is proposed
+ * first, so that the travel times of the proposals can be interpolated in
+ * parallel with the oct-tree travel time threads, then the samples are
+ * evaluated and tested chain by chain in order. Each chain saves its share
+ * of the MetUse samples after MetStartSave, a chain failing the learning
+ * stage or the maximum number of tries is dropped. The Gelman-Rubin statistic
+ * of the saved samples and the acceptance rates of the chains are added to
+ * the search information. */
+
+static int LocMetropolisChains(int ngrid, int num_arr_total, int num_arr_loc,
+        ArrivalDesc *arrival,
+        GridDesc* ptgrid, GaussLocParams* gauss_par, HypoDesc* phypo,
+        WalkParams* pMetrop, float* fdata) {
+
+    int istat, n, ncomp, narr, ipos;
+    int num_chains, num_active, num_complete, num_stat;
+    int numSamplesChain, maxNumTries;
+    int iGridType;
+    int nReject, numClipped = 0, numGridReject = 0, numStaReject = 0;
+    int iAbort = 0, iReject = 0;
+    int iBoundary = 0;
+    int iAccept;
+    long int ngenerated = 0;
+    int nSamples = 0;
+    double xval, yval, zval;
+
+    double value, dlike;
+
+    double misfit;
+    double misfit_min = VERY_LARGE_DOUBLE, misfit_max = -VERY_LARGE_DOUBLE;
+
+    double xmin, xmax, ymin, ymax, zmin, zmax;
+    double dx_init, dx_test, dx_mean;
+
+    int nScatterSaved;
+
+    double xvar, yvar, zvar;
+    double dsamp, dsamp2;
+    double mean, mean_mean, within, between, rhat, rhat_max;
+    double acc, acc_min, acc_max;
+
+    MetChain *chains, *pchain;
+    WalkParams *pwalk;
+    UniState rng_main;
+    OctTravelTimes *poct_tt;
+
+
+    /* get solution quality at each sample on random walks */
+
+    if (message_flag >= 4) {
+        nll_putmsg(4, "");
+        nll_putmsg(4, "Calculating solution along Metropolis walks...");
+    }
+
+    iGridType = GRID_PROB_DENSITY;
+
+    /* set walk limits equal to grid limits */
+    xmin = ptgrid->origx;
+    xmax = xmin + (double) (ptgrid->numx - 1) * ptgrid->dx;
+    ymin = ptgrid->origy;
+    ymax = ymin + (double) (ptgrid->numy - 1) * ptgrid->dy;
+    zmin = ptgrid->origz;
+    zmax = zmin + (double) (ptgrid->numz - 1) * ptgrid->dz;
+
+    /* save intiial values */
+    dx_init = pMetrop->dx;
+
+    num_chains = MetNumChains;
+    if (num_chains > OCT_TT_MAX_CELLS)
+        num_chains = OCT_TT_MAX_CELLS;
+    /* each chain saves its share of the samples after MetStartSave */
+    numSamplesChain = MetStartSave + (MetUse + num_chains - 1) / num_chains;
+
+    if ((chains = (MetChain *) calloc(num_chains, sizeof (MetChain))) == NULL) {
+        nll_puterr("ERROR: allocating memory for Metropolis chains.");
+        return (-1);
+    }
+
+    /* initialize chains, seeds are drawn from the stream of the calling thread */
+    for (n = 0; n < num_chains; n++) {
+        pchain = chains + n;
+        istat = get_rand_int(0, 900000000);
+        uni_get_state(&rng_main);
+        rinit(istat);
+        uni_get_state(&pchain->rng);
+        uni_set_state(&rng_main);
+        pchain->walk = *pMetrop;
+        pchain->active = 1;
+        pchain->currentMetStepFact = MetStepFact;
+        pchain->misfit_min = VERY_LARGE_DOUBLE;
+        pchain->dlike_max = -VERY_LARGE_DOUBLE;
+    }
+
+    oct_tt = poct_tt = OctTravelTimes_Start(arrival, num_arr_loc);
+
+
+    /* loop over walk samples */
+
+    nScatterSaved = 0;
+    ipos = 0;
+    maxNumTries = MAX_NUM_MET_TRIES;
+    num_active = num_chains;
+    num_complete = 0;
+    while (num_active > 0) {
+
+        /* propose next sample of each chain */
+        for (n = 0; n < num_chains; n++) {
+            pchain = chains + n;
+            if (poct_tt != NULL)
+                poct_tt->cells[n] = NULL;
+            if (!pchain->active)
+                continue;
+            pchain->ntry++;
+            pchain->ngenerated++;
+            uni_set_state(&pchain->rng);
+            istat = GetNextMetropolisSample(&pchain->walk,
+                    xmin, xmax, ymin, ymax,
+                    zmin, zmax, &pchain->sample.x, &pchain->sample.y, &pchain->sample.z);
+            uni_get_state(&pchain->rng);
+            if (pchain->nSamples > MetEquil && istat > 0)
+                numClipped += istat;
+            pchain->above_topo = isAboveTopo(pchain->sample.x, pchain->sample.y, pchain->sample.z);
+            if (poct_tt != NULL && !pchain->above_topo)
+                poct_tt->cells[n] = &pchain->sample;
+        }
+        if (poct_tt != NULL)
+            OctTravelTimes_Run(poct_tt, num_chains);
+
+        /* evaluate and test samples in chain order */
+        for (n = 0; n < num_chains; n++) {
+
+            pchain = chains + n;
+            if (!pchain->active)
+                continue;
+            pwalk = &pchain->walk;
+            xval = pchain->sample.x;
+            yval = pchain->sample.y;
+            zval = pchain->sample.z;
+
+            /* get travel times for observed arrivals */
+
+            if (!pchain->above_topo) {
+
+                oct_tt_cell = poct_tt != NULL ? n : -1;
+                nReject = getTravelTimes(arrival, num_arr_loc, xval, yval, zval);
+                oct_tt_cell = -1;
+
+                if (nReject) {
+                    numGridReject++;
+                    numStaReject += nReject;
+                } else {
+
+                    /* calc misfit or prob density */
+                    double log_prior;
+                    value = CalcSolutionQuality(xval, yval, zval, NULL, num_arr_loc, arrival, gauss_par,
+                            iGridType, &misfit, NULL, NULL, 0.0, 0.0, 0.0, NULL, NULL, &log_prior);
+                    value += log_prior;
+                    dlike = gauss_par->WtMtrxSum * exp(value);
+
+                    /* apply Metropolis test */
+                    uni_set_state(&pchain->rng);
+                    iAccept = MetropolisTest(pwalk->likelihood, dlike);
+                    uni_get_state(&pchain->rng);
+
+                    /* if not accepted, but at maxNumTries... */
+                    if (!iAccept && pchain->ntry == maxNumTries) {
+                        /* if not learning, accept anyway since
+                        may be stuck in a deep minima */
+                        if (pchain->nSamples >= MetLearn && pchain->numAcceptDeepMinima++ < 5) {
+                            iAccept = 1;
+                            /* try reducing step size */
+                            pchain->currentMetStepFact /= 2.0;
+                            pchain->ntry = 0;
+                            /* if learning, try reducing step size */
+                        } else if (pchain->nSamples < MetLearn && pwalk->dx > MetStepMin) {
+                            pwalk->dx /= 2.0;
+                            pchain->ntry = 0;
+                        }
+                    }
+
+
+                    if (iAccept) {
+
+                        pchain->ntry = 0;
+                        pchain->nSamples++;
+
+                        /* check for minimum misfit */
+                        if (misfit < pchain->misfit_min) {
+                            pchain->misfit_min = misfit;
+                            pchain->dlike_max = dlike;
+                        }
+                        if (misfit < misfit_min) {
+                            misfit_min = misfit;
+                            phypo->misfit = misfit;
+                            phypo->x = xval;
+                            phypo->y = yval;
+                            phypo->z = zval;
+                            for (narr = 0; narr < num_arr_loc; narr++)
+                                arrival[narr].pred_travel_time_best =
+                                    arrival[narr].pred_travel_time;
+                        }
+                        if (misfit > misfit_max)
+                            misfit_max = misfit;
+
+                        /* update sample location */
+                        pwalk->x = xval;
+                        pwalk->y = yval;
+                        pwalk->z = zval;
+                        pwalk->likelihood = dlike;
+
+                        /* if learning, update sample statistics */
+                        if (pchain->nSamples > MetLearn / 2 && pchain->nSamples <= MetLearn + MetEquil) {
+
+                            pchain->xmean_sum += xval;
+                            pchain->ymean_sum += yval;
+                            pchain->zmean_sum += zval;
+                            pchain->xvar_sum += xval * xval;
+                            pchain->yvar_sum += yval * yval;
+                            pchain->zvar_sum += zval * zval;
+                            pchain->nSampStat++;
+                        }
+
+                        /* if equilibrating, update Met step */
+                        if (pchain->nSamples > MetLearn
+                                && pchain->nSamples <= MetLearn + MetEquil) {
+
+                            dsamp = (double) pchain->nSampStat;
+                            dsamp2 = dsamp * dsamp;
+                            xvar = pchain->xvar_sum / dsamp -
+                                    pchain->xmean_sum * pchain->xmean_sum / dsamp2;
+                            yvar = pchain->yvar_sum / dsamp -
+                                    pchain->ymean_sum * pchain->ymean_sum / dsamp2;
+                            zvar = pchain->zvar_sum / dsamp -
+                                    pchain->zmean_sum * pchain->zmean_sum / dsamp2;
+                            dx_test = pchain->currentMetStepFact * pow(
+                                    sqrt(xvar) * sqrt(yvar) * sqrt(zvar)
+                                    / (double) MetUse, 1.0 / 3.0);
+
+                            if (dx_test > MetStepMin)
+                                pwalk->dx = dx_test;
+                            else
+                                pwalk->dx = MetStepMin;
+                        }
+
+                        /* if saving samples */
+                        if (pchain->nSamples > MetStartSave
+                                && pchain->nSamples % MetSkip == 0) {
+
+                            /* save sample to scatter file */
+                            fdata[ipos++] = xval;
+                            fdata[ipos++] = yval;
+                            fdata[ipos++] = zval;
+                            fdata[ipos++] = dlike;
+
+                            /* update  probabilitic residuals */
+                            UpdateProbabilisticResiduals(
+                                    num_arr_loc, arrival, 1.0);
+
+                            pchain->save_sum[0] += xval;
+                            pchain->save_sum[1] += yval;
+                            pchain->save_sum[2] += zval;
+                            pchain->save_sum2[0] += xval * xval;
+                            pchain->save_sum2[1] += yval * yval;
+                            pchain->save_sum2[2] += zval * zval;
+                            pchain->numSave++;
+                            nScatterSaved++;
+                        }
+
+                        if (message_flag >= 4 && (pchain->nSamples % 1000 == 1
+                                || pchain->nSamples == MetLearn / 2)) {
+                            sprintf(MsgStr,
+                                    "Metropolis: chain %d n %d x %.2lf y %.2lf z %.2lf  dx %.2lf  li %.2le",
+                                    n, pchain->nSamples, pwalk->x, pwalk->y, pwalk->z, pwalk->dx, pwalk->likelihood);
+                            nll_putmsg(4, MsgStr);
+                        }
+
+                    }
+
+                }
+            }
+
+
+            /* check chain termination */
+
+            /* failure to accept sample after maxNumTries */
+            if (pchain->nSamples > MetLearn && pchain->ntry >= maxNumTries) {
+                sprintf(MsgStr,
+                        "WARNING: Metropolis chain %d failed to accept new sample after %d tries, dropping chain.",
+                        n, pchain->ntry);
+                nll_putmsg(1, MsgStr);
+                pchain->active = 0;
+                num_active--;
+                continue;
+            }
+
+            /* maximum likelihood too low after learning stage */
+            if (pchain->nSamples == MetLearn && pchain->dlike_max < MetProbMin) {
+                sprintf(MsgStr,
+                        "WARNING: Metropolis chain %d after learning stage (%d samples), best probability = %.2le is less than ProbMin = %.2le, dropping chain.",
+                        n, MetLearn, pchain->dlike_max, MetProbMin);
+                nll_putmsg(1, MsgStr);
+                pchain->active = 0;
+                num_active--;
+                continue;
+            }
+
+            if (pchain->nSamples >= numSamplesChain) {
+                pchain->active = 0;
+                num_active--;
+                num_complete++;
+            }
+
+        }
+
+    }
+
+    OctTravelTimes_Stop(poct_tt);
+    oct_tt = NULL;
+
+    /* continue the stream of the calling thread */
+    uni_set_state(&rng_main);
+
+
+    /* chain statistics */
+
+    dx_mean = 0.0;
+    acc_min = VERY_LARGE_DOUBLE;
+    acc_max = -VERY_LARGE_DOUBLE;
+    dsamp = 0.0;
+    num_stat = 0;
+    for (n = 0; n < num_chains; n++) {
+        pchain = chains + n;
+        ngenerated += pchain->ngenerated;
+        nSamples += pchain->nSamples;
+        dx_mean += pchain->walk.dx / (double) num_chains;
+        acc = (double) pchain->nSamples / (double) pchain->ngenerated;
+        if (acc < acc_min)
+            acc_min = acc;
+        if (acc > acc_max)
+            acc_max = acc;
+        if (pchain->numSave > 1) {
+            dsamp += (double) pchain->numSave;
+            num_stat++;
+        }
+    }
+
+    /* Gelman-Rubin potential scale reduction of saved samples, max over x, y and z */
+    rhat_max = -1.0;
+    if (num_stat > 1) {
+        dsamp /= (double) num_stat;
+        for (ncomp = 0; ncomp < 3; ncomp++) {
+            mean_mean = 0.0;
+            for (n = 0; n < num_chains; n++) {
+                pchain = chains + n;
+                if (pchain->numSave > 1)
+                    mean_mean += pchain->save_sum[ncomp] / (double) pchain->numSave;
+            }
+            mean_mean /= (double) num_stat;
+            within = between = 0.0;
+            for (n = 0; n < num_chains; n++) {
+                pchain = chains + n;
+                if (pchain->numSave < 2)
+                    continue;
+                mean = pchain->save_sum[ncomp] / (double) pchain->numSave;
+                within += (pchain->save_sum2[ncomp] - (double) pchain->numSave * mean * mean)
+                        / (double) (pchain->numSave - 1);
+                between += (mean - mean_mean) * (mean - mean_mean);
+            }
+            within /= (double) num_stat;
+            between /= (double) (num_stat - 1);
+            if (within > 0.0) {
+                rhat = sqrt(((dsamp - 1.0) / dsamp * within + between) / within);
+                if (rhat > rhat_max)
+                    rhat_max = rhat;
+            }
+        }
+    }
+
+    free(chains);
+
+    pMetrop->dx = dx_mean;
+
+
+    /* give warning if sample points clipped */
+
+    if (numClipped > 0) {
+        sprintf(MsgStr, "WARNING: %d Metropolis samples clipped at search grid boundary.",
+                numClipped);
+        nll_putmsg(1, MsgStr);
+    }
+
+
+    /* give warning if grid points rejected */
+
+    if (numGridReject > 0) {
+        sprintf(MsgStr, "WARNING: %d Metropolis samples rejected; travel times for an average of %.2lf arrival observations were not valid.",
+                numGridReject, (double) numStaReject / numGridReject);
+        nll_putmsg(1, MsgStr);
+    }
+
+
+    /* check abort search conditions */
+
+    /* all chains dropped */
+    if (num_complete == 0) {
+        sprintf(MsgStr,
+                "ERROR: all %d Metropolis chains dropped, aborting location.", num_chains);
+        nll_puterr(MsgStr);
+        snprintf(phypo->locStatComm, sizeof(phypo->locStatComm), "%.*s", (int) sizeof(phypo->locStatComm) - 1, MsgStr);
+        iAbort = 1;
+    }
+
+
+    /* check reject location conditions */
+
+    /* maximum like hypo on edge of grid */
+    if (!iAbort && (iBoundary = isOnGridBoundary(phypo->x, phypo->y, phypo->z,
+            ptgrid, dx_mean, dx_mean, 0))) {
+        sprintf(MsgStr, "WARNING: max prob location on grid boundary %d, rejecting location.", iBoundary);
+        nll_putmsg(1, MsgStr);
+        snprintf(phypo->locStatComm, sizeof(phypo->locStatComm), "%.*s", (int) sizeof(phypo->locStatComm) - 1, MsgStr);
+        iReject = 1;
+    }
+
+    /* construct search information string */
+    sprintf(phypo->searchInfo,
+            "METROPOLIS nSamp %ld nAcc %d nSave %d nClip %d Dstep0 %lf Dstep %lf nChain %d nChainOk %d Rhat %lf AccMin %lf AccMax %lf%c",
+            ngenerated, nSamples, nScatterSaved, numClipped, dx_init, dx_mean,
+            num_chains, num_complete, rhat_max, acc_min, acc_max, '\0');
+    /* write message */
+    nll_putmsg(2, phypo->searchInfo);
+
+
+    /* check for termination */
+    if (iAbort) {
+        sprintf(Hypocenter.locStat, "ABORTED");
+    } else if (iReject) {
+        sprintf(Hypocenter.locStat, "REJECTED");
+    }
+
+
+    /* re-calculate solution and arrival statistics for best location */
+
+    double cell_diagonal_time_var_best = 0.0; // TODO: add to Metropolis Search ?
+    double cell_diagonal_best = 0.0; // TODO: add to Metropolis Search ?
+    double cell_volume_best = 0.0; // TODO: add to Metropolis Search ?
+    SaveBestLocation(NULL, num_arr_total, num_arr_loc, arrival, ptgrid,
+            gauss_par, phypo, misfit_max, iGridType, 0, cell_diagonal_time_var_best, cell_diagonal_best, cell_volume_best);
+
+    return (nScatterSaved);
+
+}
+
 int getTravelTimes(ArrivalDesc *arrival, int num_arr_loc, double xval, double yval, double zval) {
 
     int nReject;
@@ -13588,6 +14843,14 @@ int getTravelTimes(ArrivalDesc *arrival, int num_arr_loc, double xval, double yv
     FILE* fp_grid;
     double yval_grid = 0.0;
     GridDesc* ptgrid;
+    int nbatch;
+    DOUBLE tt_batch[TT_BATCH_SIZE];
+    double ydist_batch[TT_BATCH_SIZE];
+    char tt_ready[TT_BATCH_SIZE];
+    DOUBLE *tt_mem = tt_batch;
+    double *ydist_mem = ydist_batch;
+    char *tt_mem_ready = tt_ready;
+    int use_oct_tt;
 
     // 20101005 AJL - added calculation of mean slowness
     double slowness_P = -1.0;
@@ -13633,8 +14896,23 @@ int getTravelTimes(ArrivalDesc *arrival, int num_arr_loc, double xval, double yv
 
     /* loop over observed arrivals */
 
+    /* travel times of oct-tree cell already interpolated in parallel */
+    use_oct_tt = oct_tt_cell >= 0 && oct_tt != NULL && oct_tt->arrival == arrival && oct_tt->num_arr == num_arr_loc;
+
     nReject = 0;
     for (narr = 0; narr < num_arr_loc; narr++) {
+        /* interpolate grids in memory for the next arrivals together */
+        if ((nbatch = narr % TT_BATCH_SIZE) == 0) {
+            if (use_oct_tt) {
+                tt_mem = oct_tt->tt + (size_t) oct_tt_cell * num_arr_loc + narr;
+                ydist_mem = oct_tt->ydist + (size_t) oct_tt_cell * num_arr_loc + narr;
+                tt_mem_ready = oct_tt->tt_ready + (size_t) oct_tt_cell * num_arr_loc + narr;
+            } else {
+                getTravelTimesInMemory(arrival + narr,
+                    num_arr_loc - narr < TT_BATCH_SIZE ? num_arr_loc - narr : TT_BATCH_SIZE,
+                    xval, yval, zval, tt_batch, ydist_batch, tt_ready);
+            }
+        }
         /* check for companion */
         if ((n_compan = arrival[narr].n_companion) >= 0) {
             if ((arrival[narr].pred_travel_time = arrival[n_compan].pred_travel_time) < 0.0)
@@ -13642,7 +14920,13 @@ int getTravelTimes(ArrivalDesc *arrival, int num_arr_loc, double xval, double yv
             arrival[narr].pred_travel_time *= arrival[narr].tfact;
             /* else check grid type */
         } else {
-            if (arrival[narr].gdesc.type == GRID_TIME) {
+            if (tt_mem_ready[nbatch]) {
+                /* interpolated from grid in memory */
+                if (arrival[narr].gdesc.type != GRID_TIME)
+                    yval_grid = ydist_mem[nbatch];
+                if ((arrival[narr].pred_travel_time = tt_mem[nbatch]) < 0.0)
+                    nReject++;
+            } else if (arrival[narr].gdesc.type == GRID_TIME) {
                 /* 3D grid */
                 if (arrival[narr].gdesc.buffer == NULL) {
                     /* read time grid from disk */
@@ -13861,6 +15145,10 @@ int LocOctree(int ngrid, int num_arr_total, int num_arr_loc,
     double smallest_node_size_y = -1.0;
     double smallest_node_size_z = -1.0;
 
+    OctTravelTimes *poct_tt;
+    OctNode* neighbor_nodes[7];
+    int num_neighbors, n_cell;
+
     //double stationDensityWeight = 0.0;
 
 
@@ -13895,11 +15183,17 @@ int LocOctree(int ngrid, int num_arr_total, int num_arr_loc,
 
     /* first get solutions at each cell in Tree3D */
 
+    // interpolate travel times of the cells of each batch in parallel
+    oct_tt = poct_tt = OctTravelTimes_Start(arrival, num_arr_loc);
+
     nSamples = 0;
     resultTreeRoot = NULL;
     for (ix = 0; ix < pOctTree->numx; ix++) {
         for (iy = 0; iy < pOctTree->numy; iy++) {
             for (iz = 0; iz < pOctTree->numz; iz++) {
+                n_cell = (ix * pOctTree->numy + iy) * pOctTree->numz + iz;
+                if (poct_tt != NULL && n_cell % OCT_TT_MAX_CELLS == 0)
+                    OctTravelTimes_RunTree(poct_tt, pOctTree, n_cell);
                 poct_node = pOctTree->nodeArray[ix][iy][iz];
                 if (poct_node == NULL) // case of Tree3D_spherical
                     continue;
@@ -13907,9 +15201,11 @@ int LocOctree(int ngrid, int num_arr_total, int num_arr_loc,
                 xval = poct_node->center.x;
                 yval = poct_node->center.y;
                 zval = poct_node->center.z;
+                oct_tt_cell = poct_tt != NULL ? n_cell % OCT_TT_MAX_CELLS : -1;
                 value = LocOctree_core(ngrid, xval, yval, zval, num_arr_loc, arrival, poct_node,
                         icalc_cell_diagonal_time_var, &volume_min, &diagonal,
                         &cell_half_diagonal_time_range, pParams, gauss_par, iGridType, &misfit, logWtMtrxSum);
+                oct_tt_cell = -1;
                 nSamples++;
                 // END - this block must be identical to block $$$ below
 
@@ -13958,8 +15254,9 @@ int LocOctree(int ngrid, int num_arr_total, int num_arr_loc,
 
         pparent_oct_node = presult_node->pnode;
 
-        // subdivide all HighestLeafValue neighbors
+        // subdivide all HighestLeafValue neighbors, then evaluate solution at their children
 
+        num_neighbors = 0;
         int n_neigh_max = 7;
         if (LocMethod == METH_OT_STACK) // this is in warning monitor for speed and efficiency in convergence, with the risk of less thorough search
             n_neigh_max = 1;
@@ -14009,8 +15306,9 @@ int LocOctree(int ngrid, int num_arr_total, int num_arr_loc,
             }
 
 
-            // subdivide node and evaluate solution at each child
+            // subdivide node
             subdivide(neighbor_node, OCTREE_UNDEF_VALUE, NULL);
+            neighbor_nodes[num_neighbors++] = neighbor_node;
 
             for (ix = 0; ix < 2; ix++) {
                 for (iy = 0; iy < 2; iy++) {
@@ -14029,13 +15327,39 @@ int LocOctree(int ngrid, int num_arr_total, int num_arr_loc,
                         if (poct_node->ds.z < smallest_node_size_z)
                             smallest_node_size_z = poct_node->ds.z;
 
+                        if (poct_tt != NULL)
+                            poct_tt->cells[(num_neighbors - 1) * 8 + ix * 4 + iy * 2 + iz] = &poct_node->center;
+
+                    }
+                }
+            }
+
+        } // end loop over HighestLeafValue neighbors
+
+        if (poct_tt != NULL)
+            OctTravelTimes_Run(poct_tt, num_neighbors * 8);
+
+        // evaluate solution at each child of the subdivided nodes, in order of subdivision
+
+        for (n_neigh = 0; n_neigh < num_neighbors; n_neigh++) {
+
+            neighbor_node = neighbor_nodes[n_neigh];
+
+            for (ix = 0; ix < 2; ix++) {
+                for (iy = 0; iy < 2; iy++) {
+                    for (iz = 0; iz < 2; iz++) {
+
+                        poct_node = neighbor_node->child[ix][iy][iz];
+
                         // $$$ NOTE: this block must be identical to block $$$ above
                         xval = poct_node->center.x;
                         yval = poct_node->center.y;
                         zval = poct_node->center.z;
+                        oct_tt_cell = poct_tt != NULL ? n_neigh * 8 + ix * 4 + iy * 2 + iz : -1;
                         value = LocOctree_core(ngrid, xval, yval, zval, num_arr_loc, arrival, poct_node,
                                 icalc_cell_diagonal_time_var, &volume_min, &diagonal,
                                 &cell_half_diagonal_time_range, pParams, gauss_par, iGridType, &misfit, logWtMtrxSum);
+                        oct_tt_cell = -1;
                         nSamples++;
                         // END - this block must be identical to block $$$ above
 
@@ -14101,7 +15425,7 @@ int LocOctree(int ngrid, int num_arr_total, int num_arr_loc,
                 }
             }
 
-        } // end loop over HighestLeafValue neighbors
+        } // end loop over subdivided nodes
 
         // check if minimum node size reached
         if (pParams->stop_on_min_node_size && (smallest_node_size_x < min_node_size_x
@@ -14117,6 +15441,9 @@ int LocOctree(int ngrid, int num_arr_total, int num_arr_loc,
     if (message_flag >= 1)
         fprintf(stdout, "\n");
 
+    OctTravelTimes_Stop(poct_tt);
+    oct_tt = NULL;
+
 
 
 
@@ -14343,7 +15670,7 @@ double getOctTreeStationDensityWeight_OLD1(OctNode* poct_node, SourceDesc *stati
     }
 
     if (poct_node->pdata == NULL)
-        poct_node->pdata = (void *) malloc(sizeof (int));
+        poct_node->pdata = newOctNodeData(poct_node, sizeof (int));
     if (poct_node->pdata != NULL)
         *((int *) poct_node->pdata) = n_inside;
     else
@@ -14407,7 +15734,7 @@ double getOctTreeStationDensityWeight_OLD2(OctNode* poct_node, SourceDesc *stati
     }
 
     if (poct_node->pdata == NULL)
-        poct_node->pdata = (void *) malloc(sizeof (int));
+        poct_node->pdata = newOctNodeData(poct_node, sizeof (int));
     if (poct_node->pdata != NULL)
         *((int *) poct_node->pdata) = n_inside;
     else
@@ -14434,7 +15761,7 @@ double getOctTreeStationDensityWeight(OctNode* poct_node, SourceDesc *stations,
     double x_node_cent, y_node_cent, z_node_cent, mean_node_horiz_ds;
     OctNode* pnode;
 
-    static double mean_root_node_horiz_ds = -VERY_LARGE_DOUBLE;
+    static NLL_THREAD_LOCAL double mean_root_node_horiz_ds = -VERY_LARGE_DOUBLE;
     // !!! shoud be initialized for each event????
 
 
@@ -14539,7 +15866,7 @@ double getOctTreeStationDensityWeight(OctNode* poct_node, SourceDesc *stations,
     }
 
     if (poct_node->pdata == NULL)
-        poct_node->pdata = (void *) malloc(sizeof (double));
+        poct_node->pdata = newOctNodeData(poct_node, sizeof (double));
     if (poct_node->pdata != NULL)
         *((double *) poct_node->pdata) = log_station_density_weight;
     else
@@ -213,6 +213,28 @@ SearchPdfGridDesc;
 
 
 
+/* observation record passed to NLLocArrivals() in place of an NLLOC_OBS line */
+
+typedef struct {
+    char label[ARRIVAL_LABEL_LEN]; /* char label (i.e. station or site code), must match a source label */
+    char inst[INST_LABEL_LEN]; /* instrument code */
+    char comp[COMP_LABEL_LEN]; /* component (ie Z N 128) */
+    char onset[2]; /* char onset (ie E I) */
+    char phase[PHASE_LABEL_LEN]; /* char phase id */
+    char first_mot[2]; /* char first motion id */
+    int year, month, day, hour, min; /* arrival date and time */
+    double sec;
+    char error_type[8]; /* error type (GAU or QUAL) */
+    double error; /* error value */
+    double coda_dur; /* coda duration reading */
+    double amplitude; /* amplitude reading */
+    double period; /* period of amplitude reading */
+    double apriori_weight; /* a priori weight */
+}
+ObsArrivalDesc;
+
+
+
 /*------------------------------------------------------------*/
 /* globals  */
 
@@ -244,9 +266,13 @@ EXTERN_TXT int NumArrivalsRead;
 EXTERN_TXT int NumArrivalsLocation;
 
 /* observations filenames */
-EXTERN_TXT char fn_loc_obs[MAX_NUM_OBS_FILES][FILENAME_MAX];
+EXTERN_TXT char (*fn_loc_obs)[FILENAME_MAX]; /* [MAX_NUM_OBS_FILES] */
 /* filetype */
 EXTERN_TXT char ftype_obs[MAXLINE];
+/* observation records passed to NLLocArrivals(), NULL if reading text observations */
+EXTERN_TXT ObsArrivalDesc *ObsRecords;
+EXTERN_TXT int NumObsRecords;
+EXTERN_TXT int NextObsRecord;
 
 /* filenames */
 EXTERN_TXT char fn_loc_grids[FILENAME_MAX], fn_path_output[FILENAME_MAX];
@@ -386,7 +412,7 @@ EXTERN_TXT int NumLocInclude;
 #define WRITE_PDF_RESIDUALS 2
 #define WRITE_PDF_DELAYS 3
 #define MAX_NUM_STA_DELAYS 10000
-EXTERN_TXT TimeDelayDesc TimeDelay[MAX_NUM_STA_DELAYS];
+EXTERN_TXT TimeDelayDesc *TimeDelay; /* [MAX_NUM_STA_DELAYS] */
 EXTERN_TXT int NumTimeDelays;
 
 EXTERN_TXT char TimeDelaySurfacePhase[MAX_SURFACES][PHASE_LABEL_LEN];
@@ -408,12 +434,13 @@ EXTERN_TXT int topo_surface_index; // topo surface index is velmod.h.MAX_SURFACE
 
 /* station list */
 EXTERN_TXT int NumStationPhases;
-EXTERN_TXT SourceDesc StationPhaseList[X_MAX_NUM_ARRIVALS];
+EXTERN_TXT SourceDesc *StationPhaseList; /* [X_MAX_NUM_ARRIVALS] */
 
 /* fixed origin time parameters */
 EXTERN_TXT int FixOriginTimeFlag;
 
 /* Metropolis */
+#define MET_MAX_NUM_CHAINS 64 /* max number of independent chains */
 EXTERN_TXT WalkParams Metrop; /* walk parameters */
 EXTERN_TXT int MetNumSamples; /* number of samples to evaluate */
 EXTERN_TXT int MetLearn; /* learning length in number of samples for
@@ -430,13 +457,14 @@ EXTERN_TXT double MetVelocity; /* velocity for conversion of distance to time */
 EXTERN_TXT double MetInititalTemperature; /* initial temperature */
 EXTERN_TXT int MetUse; /* number of samples to use
 					= MetNumSamples - MetEquil */
+EXTERN_TXT int MetNumChains; /* number of independent chains */
 
 
 /* Octtree */
 EXTERN_TXT OcttreeParams octtreeParams; /* Octtree parameters */
 EXTERN_TXT Tree3D* octTree; /* Octtree */
-EXTERN_TXT ResultTreeNode* resultTreeRoot; /* Octtree likelihood*volume results tree root node */
-//EXTERN_TXT ResultTreeNode* resultTreeLikelihoodRoot;	/* Octtree likelihood results tree root node */
+EXTERN_TXT ResultTree* resultTreeRoot; /* Octtree likelihood*volume results tree root node */
+//EXTERN_TXT ResultTree* resultTreeLikelihoodRoot;	/* Octtree likelihood results tree root node */
 
 
 /* take-off angles */
@@ -512,7 +540,13 @@ void UpdateStaStat(int, ArrivalDesc *, int, double, double, double, double);
 
 int NLLoc(char *pid_main, char *fn_control_main, char **param_line_array, int n_param_lines, char **obs_line_array, int n_obs_lines,
         int return_locations, int return_oct_tree_grid, int return_scatter_sample, LocNode **ploc_list_head);
+int NLLocArrivals(char *pid_main, char *fn_control_main, char **param_line_array, int n_param_lines,
+        ObsArrivalDesc *obs_arrival_array, int n_obs_arrivals, SourceDesc *station_array, int n_stations,
+        int return_locations, int return_oct_tree_grid, int return_scatter_sample, LocNode **ploc_list_head);
 
+int AllocThreadGlobals();
+void NLL_SetOctreeThreads(int num_threads);
+void NLL_SetFastEDT(int fast_edt);
 int Locate(int ngrid, char* fn_loc_obs, char* fn_root_out, int numArrivalsReject, int return_locations, int return_oct_tree_grid, int return_scatter_sample, LocNode **ploc_list_head);
 
 int checkObs(ArrivalDesc *arrival, int nobs);
@@ -534,6 +568,7 @@ int GetNLLoc_PdfGrid(char*, int);
 int GetNLLoc_FixOriginTime(char*);
 int GetObservations(FILE*, char*, char*, ArrivalDesc*, int*, int*, int*, int, HypoDesc*, int*, int*, int);
 int GetNextObs(HypoDesc* phypo, FILE*, ArrivalDesc *, char*, int);
+int GetNextObsRecord(ArrivalDesc *, char*);
 int IsGoodDate(int, int, int);
 int ReadArrivalSheets(int, ArrivalDesc*, double);
 int IsSameArrival(ArrivalDesc *, int, int, char *);
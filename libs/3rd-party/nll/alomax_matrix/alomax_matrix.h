@@ -5,6 +5,10 @@
  *
  */
 
+#ifndef NLL_THREAD_LOCAL
+#define NLL_THREAD_LOCAL __thread
+#endif
+
 typedef double**  MatrixDouble;
 typedef double*  VectorDouble;
 
@@ -61,20 +61,20 @@ rank can be computed from this decomposition.
 @serial internal storage of U.
 @serial internal storage of V.
  */
-static MatrixDouble U_matrix = NULL;
-static MatrixDouble V_matrix = NULL;
-static MatrixDouble S_matrix = NULL;
+static NLL_THREAD_LOCAL MatrixDouble U_matrix = NULL;
+static NLL_THREAD_LOCAL MatrixDouble V_matrix = NULL;
+static NLL_THREAD_LOCAL MatrixDouble S_matrix = NULL;
 
 /** Array for internal storage of singular values.
 @serial internal storage of singular values.
  */
-static VectorDouble singular_values = NULL;
+static NLL_THREAD_LOCAL VectorDouble singular_values = NULL;
 
 /** Row and column dimensions.
 @serial row dimension.
 @serial column dimension.
  */
-static int num_rows, num_columns;
+static NLL_THREAD_LOCAL int num_rows, num_columns;
 
 /**
 Constructs and returns a new singular value decomposition object;
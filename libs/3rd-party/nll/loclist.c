@@ -298,8 +298,8 @@ void writeLocNode(LocNode *addr, FILE *out)
 
 /** function to convert hypocenter date/time to double time value */
 
-static struct tm time_1970 = {0, 0, 1, 1, 0, 70};
-static time_t time_1970_seconds = LONG_MIN;
+static NLL_THREAD_LOCAL struct tm time_1970 = {0, 0, 1, 1, 0, 70};
+static NLL_THREAD_LOCAL time_t time_1970_seconds = LONG_MIN;
 static time_t TIME_T_INVALID = LONG_MIN;
 
 double getLocTimeValue(HypoDesc *phypo)
@@ -344,7 +344,7 @@ double getLocTimeValue(HypoDesc *phypo)
 
 /** function to find all locations with first phase in a specified time window */
 
-static LocNode *locNodesTmp[MAX_NUM_LOCATIONS];
+static NLL_THREAD_LOCAL LocNode *locNodesTmp[MAX_NUM_LOCATIONS];
 
 LocNode **findLocsWithFirstPhaseInTimeWindow(LocNode *head, double tmin, double tmax)
 {
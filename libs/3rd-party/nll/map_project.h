@@ -1,4 +1,8 @@
 
+#ifndef NLL_THREAD_LOCAL
+#define NLL_THREAD_LOCAL __thread
+#endif
+
 int map_setup_proxy(int n_proj, char* ellipsoid_name);
 
 // Lambert Conformal Conic projection
@@ -49,15 +49,97 @@ tel: +33(0)493752502  e-mail: anthony@alomax.net  web: http://www.alomax.net
 #include "ran1.h"
 #include "octtree.h"
 
+
+/* octree memory of the calling thread */
+static NLL_THREAD_LOCAL OctreeMemStats octreeMemStats;
+
+#define OCT_ARENA_ALIGN(size) (((size) + 15) & ~((size_t) 15))
+
+/*** function to create an arena for the nodes of a Tree3D */
+
+static OctArena* newOctArena() {
+
+    return ((OctArena*) calloc(1, sizeof (OctArena)));
+}
+
+/*** function to allocate memory from an arena, memory is released with the arena only */
+
+static void* allocOctArena(OctArena* arena, size_t size) {
+
+    size_t block_size;
+    OctArenaBlock* block;
+    char* ptr;
+
+    size = OCT_ARENA_ALIGN(size);
+
+    block = arena->blocks;
+    if (block == NULL || block->used + size > block->size) {
+        block_size = size > OCT_ARENA_BLOCK_SIZE ? size : OCT_ARENA_BLOCK_SIZE;
+        if ((block = (OctArenaBlock*) malloc(OCT_ARENA_ALIGN(sizeof (OctArenaBlock)) + block_size)) == NULL)
+            return (NULL);
+        block->next = arena->blocks;
+        block->size = block_size;
+        block->used = 0;
+        arena->blocks = block;
+        arena->bytes += block_size;
+        octreeMemStats.bytes += block_size;
+        if (octreeMemStats.bytes > octreeMemStats.peak_bytes)
+            octreeMemStats.peak_bytes = octreeMemStats.bytes;
+    }
+
+    ptr = (char*) block + OCT_ARENA_ALIGN(sizeof (OctArenaBlock)) + block->used;
+    block->used += size;
+
+    return (ptr);
+}
+
+/*** function to free an arena and all memory allocated from it */
+
+static void freeOctArena(OctArena* arena) {
+
+    OctArenaBlock* block;
+
+    if (arena == NULL)
+        return;
+
+    while ((block = arena->blocks) != NULL) {
+        arena->blocks = block->next;
+        free(block);
+    }
+    octreeMemStats.bytes -= arena->bytes < octreeMemStats.bytes ? arena->bytes : octreeMemStats.bytes;
+    octreeMemStats.num_nodes -= arena->num_nodes < octreeMemStats.num_nodes ? arena->num_nodes : octreeMemStats.num_nodes;
+    free(arena);
+}
+
+/*** function to get octree memory statistics of the calling thread */
+
+void getOctreeMemStats(OctreeMemStats* pstats) {
+
+    *pstats = octreeMemStats;
+}
+
+/*** function to reset octree memory peak values of the calling thread to the current values */
+
+void resetOctreeMemPeak() {
+
+    octreeMemStats.peak_bytes = octreeMemStats.bytes;
+    octreeMemStats.peak_num_nodes = octreeMemStats.num_nodes;
+}
+
 /*** function to create a new OctNode */
 
-OctNode* newOctNode(OctNode* parent, Vect3D center, Vect3D ds, double value, void *pdata) {
+OctNode* newOctNode(OctArena* arena, OctNode* parent, Vect3D center, Vect3D ds, double value, void *pdata) {
 
     int l, m, n;
     OctNode* node;
 
-    node = (OctNode*) malloc(sizeof (OctNode));
+    if ((node = (OctNode*) allocOctArena(arena, sizeof (OctNode))) == NULL)
+        return (NULL);
+    arena->num_nodes++;
+    if (++octreeMemStats.num_nodes > octreeMemStats.peak_num_nodes)
+        octreeMemStats.peak_num_nodes = octreeMemStats.num_nodes;
 
+    node->arena = arena;
     node->parent = parent;
     node->center = center;
     node->ds = ds;
@@ -78,8 +160,17 @@ OctNode* newOctNode(OctNode* parent, Vect3D center, Vect3D ds, double value, voi
     return (node);
 }
 
+/*** function to allocate additional data of an OctNode, released with the Tree3D containing the node */
+
+void* newOctNodeData(OctNode* node, size_t size) {
+
+    return (allocOctArena(node->arena, size));
+}
+
 /*** function to free a Tree3D ***/
 
+// nodes and node data are released with the arena of the tree, freeDataPointer has no effect
+
 void freeTree3D(Tree3D* tree, int freeDataPointer) {
 
     // AEH/AJL 20080709
@@ -90,14 +181,10 @@ void freeTree3D(Tree3D* tree, int freeDataPointer) {
         free(tree->num_x);
     }
 
-    int ix, iy, iz;
+    int ix, iy;
 
     for (ix = 0; ix < tree->numx; ix++) {
         for (iy = 0; iy < tree->numy; iy++) {
-            for (iz = 0; iz < tree->numz; iz++) {
-                if (tree->nodeArray[ix][iy][iz] != NULL) // case of Tree3D_spherical
-                    freeNode(tree->nodeArray[ix][iy][iz], freeDataPointer);
-            }
             free(tree->nodeArray[ix][iy]);
         }
         free(tree->nodeArray[ix]);
@@ -106,6 +193,8 @@ void freeTree3D(Tree3D* tree, int freeDataPointer) {
     // AJL - 20080710  (valgrind)
     free(tree->nodeArray);
 
+    freeOctArena(tree->arena);
+
     free(tree);
 
 }
@@ -134,6 +223,12 @@ Tree3D* newTree3D(int data_code, int numx, int numy, int numz,
     }
     tree->ds_x = NULL;
     tree->num_x = NULL;
+    // allocate arena for nodes
+    if ((tree->arena = newOctArena()) == NULL) {
+        free(garray);
+        free(tree);
+        return (NULL);
+    }
 
     ds.x = dx;
     ds.y = dy;
@@ -151,7 +246,7 @@ Tree3D* newTree3D(int data_code, int numx, int numy, int numz,
                 return (NULL);
             for (iz = 0; iz < numz; iz++) {
                 center.z = origz + (double) iz * dz + dz / 2.0;
-                garray[ix][iy][iz] = newOctNode(NULL, center, ds, value, pdata);
+                garray[ix][iy][iz] = newOctNode(tree->arena, NULL, center, ds, value, pdata);
             }
         }
     }
@@ -218,6 +313,14 @@ Tree3D* newTree3D_spherical(int data_code, int numx_nominal, int numy, int numz,
         free(tree);
         return (NULL);
     }
+    // allocate arena for nodes
+    if ((tree->arena = newOctArena()) == NULL) {
+        free(garray);
+        free(tree->ds_x);
+        free(tree->num_x);
+        free(tree);
+        return (NULL);
+    }
 
     ds.x = dx_nominal;
     ds.y = dy;
@@ -248,7 +351,7 @@ Tree3D* newTree3D_spherical(int data_code, int numx_nominal, int numy, int numz,
                     ds.x = dx;
                     center.x = origx + (double) ix * dx + dx / 2.0;
                     center.z = origz + (double) iz * dz + dz / 2.0;
-                    garray[ix][iy][iz] = newOctNode(NULL, center, ds, value, pdata);
+                    garray[ix][iy][iz] = newOctNode(tree->arena, NULL, center, ds, value, pdata);
                 } else {
                     garray[ix][iy][iz] = NULL;
                 }
@@ -306,7 +409,7 @@ void subdivide(OctNode* parent, double value, void *pdata) {
             center.y = parent->center.y + (double) (2 * iy - 1) * ds.y / 2.0;
             for (iz = 0; iz < 2; iz++) {
                 center.z = parent->center.z + (double) (2 * iz - 1) * ds.z / 2.0;
-                parent->child[ix][iy][iz] = newOctNode(parent, center, ds, value, pdata);
+                parent->child[ix][iy][iz] = newOctNode(parent->arena, parent, center, ds, value, pdata);
             }
         }
     }
@@ -316,27 +419,6 @@ void subdivide(OctNode* parent, double value, void *pdata) {
 
 }
 
-/*** function to free an OctNode and all its child nodes ***/
-
-void freeNode(OctNode* node, int freeDataPointer) {
-
-    int ix, iy, iz;
-    for (ix = 0; ix < 2; ix++) {
-        for (iy = 0; iy < 2; iy++) {
-            for (iz = 0; iz < 2; iz++) {
-                if (node->child[ix][iy][iz] != NULL)
-                    freeNode(node->child[ix][iy][iz], freeDataPointer);
-            }
-        }
-    }
-
-    // try to free data
-    if (freeDataPointer && node->pdata != NULL)
-        free(node->pdata);
-    free(node);
-
-}
-
 /*** function to get the leaf node in a Tree3D containing the given x, y, z coordinates ***/
 
 OctNode* getTreeNodeContaining(Tree3D* tree, Vect3D coords, double *padjusted_coords_x) {
@@ -521,119 +603,233 @@ int extendedNodeContains(OctNode* node, double x, double y, double z, int checkZ
 
 }
 
+/*** function to get result node with index in results tree */
+
+static ResultTreeNode* getResultNode(ResultTree* prtree, int index) {
+
+    return (prtree->blocks[index / RESULT_TREE_BLOCK_SIZE] + index % RESULT_TREE_BLOCK_SIZE);
+}
+
+/*** function to compare result nodes, results with same value are in order of addition */
+
+static int isHigherResult(ResultTreeNode* presult1, ResultTreeNode* presult2) {
+
+    if (presult1->value > presult2->value)
+        return (1);
+    if (presult1->value < presult2->value)
+        return (0);
+    return (presult1->index > presult2->index);
+}
+
+static int compareResults(const void *p1, const void *p2) {
+
+    ResultTreeNode* presult1 = *(ResultTreeNode**) p1;
+    ResultTreeNode* presult2 = *(ResultTreeNode**) p2;
+
+    if (isHigherResult(presult1, presult2))
+        return (1);
+    if (isHigherResult(presult2, presult1))
+        return (-1);
+    return (0);
+}
+
+/*** function to add result node to heap of results tree */
+
+static void pushResultHeap(ResultTree* prtree, ResultTreeNode* presult) {
+
+    int n, nparent;
+    ResultTreeNode** heap = prtree->heap;
+
+    n = prtree->num_heap++;
+    while (n > 0) {
+        nparent = (n - 1) / 2;
+        if (!isHigherResult(presult, heap[nparent]))
+            break;
+        heap[n] = heap[nparent];
+        n = nparent;
+    }
+    heap[n] = presult;
+}
+
+/*** function to remove result node with highest value from heap of results tree */
+
+static ResultTreeNode* popResultHeap(ResultTree* prtree) {
+
+    int n, nchild;
+    ResultTreeNode** heap = prtree->heap;
+    ResultTreeNode* ptop;
+    ResultTreeNode* plast;
+
+    if (prtree->num_heap < 1)
+        return (NULL);
+
+    ptop = heap[0];
+    plast = heap[--prtree->num_heap];
+    n = 0;
+    while ((nchild = 2 * n + 1) < prtree->num_heap) {
+        if (nchild + 1 < prtree->num_heap && isHigherResult(heap[nchild + 1], heap[nchild]))
+            nchild++;
+        if (!isHigherResult(heap[nchild], plast))
+            break;
+        heap[n] = heap[nchild];
+        n = nchild;
+    }
+    heap[n] = plast;
+
+    return (ptop);
+}
+
+/*** function to get all results in order of increasing value */
+
+static ResultTreeNode** getSortedResults(ResultTree* prtree) {
+
+    int n;
+
+    if (prtree->num_sorted != prtree->num_nodes) {
+        for (n = 0; n < prtree->num_nodes; n++)
+            prtree->sorted[n] = getResultNode(prtree, n);
+        qsort(prtree->sorted, prtree->num_nodes, sizeof (ResultTreeNode*), compareResults);
+        prtree->num_sorted = prtree->num_nodes;
+    }
+
+    return (prtree->sorted);
+}
+
+/*** function to resize a list of result nodes */
+
+static int reallocResultList(ResultTreeNode*** plist, int size) {
+
+    ResultTreeNode** list;
+
+    if ((list = (ResultTreeNode**) realloc(*plist, size * sizeof (ResultTreeNode*))) == NULL)
+        return (0);
+    *plist = list;
+
+    return (1);
+}
+
 /*** function to put Octtree node in results tree in order of value */
 
-ResultTreeNode* addResult(ResultTreeNode* prtree, double value, double volume, OctNode* pnode) {
+ResultTree* addResult(ResultTree* prtree, double value, double volume, OctNode* pnode) {
 
-    // put address in result tree based on value
+    int max_num_nodes;
+    ResultTreeNode* presult;
+    ResultTreeNode** pblocks;
 
-    if (prtree == NULL) { // at empty node
-        if ((prtree = (ResultTreeNode*) malloc(sizeof (ResultTreeNode))) == NULL)
+    if (prtree == NULL) { // empty results tree
+        if ((prtree = (ResultTree*) calloc(1, sizeof (ResultTree))) == NULL) {
+            fprintf(stderr, "ERROR allocating memory for result-tree.\n");
+            return (NULL);
+        }
+        prtree->heap_size_min.x = prtree->heap_size_min.y = prtree->heap_size_min.z = -1.0;
+    }
+
+    // allocate result node from blocks, result nodes do not move
+    if (prtree->num_nodes == prtree->num_blocks * RESULT_TREE_BLOCK_SIZE) {
+        if ((pblocks = (ResultTreeNode**) realloc(prtree->blocks, (prtree->num_blocks + 1) * sizeof (ResultTreeNode*))) == NULL
+                || (pblocks[prtree->num_blocks] = (ResultTreeNode*) malloc(RESULT_TREE_BLOCK_SIZE * sizeof (ResultTreeNode))) == NULL) {
+            if (pblocks != NULL)
+                prtree->blocks = pblocks;
+            fprintf(stderr, "ERROR allocating memory for result-tree node.\n");
+            return (prtree);
+        }
+        prtree->blocks = pblocks;
+        prtree->num_blocks++;
+    }
+    if (prtree->num_nodes == prtree->max_num_nodes) {
+        max_num_nodes = prtree->max_num_nodes > 0 ? 2 * prtree->max_num_nodes : RESULT_TREE_BLOCK_SIZE;
+        if (!reallocResultList(&prtree->heap, max_num_nodes)
+                || !reallocResultList(&prtree->deferred, max_num_nodes)
+                || !reallocResultList(&prtree->sorted, max_num_nodes)) {
             fprintf(stderr, "ERROR allocating memory for result-tree node.\n");
-        prtree->value = value;
-        prtree->level = pnode->level;
-        prtree->volume = volume; // node volume depends on geometry in physical space, may not be dx*dy*dz
-        prtree->pnode = pnode;
-        prtree->left = prtree->right = NULL;
-
-        /* 20101213 AJL removed this block - causes memory errors in trace_processing/location.c
-           } else if (value == prtree->value) { // prevent assymetric tree if multiple identical values
-            if (get_rand_int(-10000, 9999) < 0)
-                prtree->left = addResult(prtree->left, value, volume, pnode);
-            else
-                prtree->right = addResult(prtree->right, value, volume, pnode);
-         */
-
-    } else if (value < prtree->value) {
-        prtree->left = addResult(prtree->left, value, volume, pnode);
+            return (prtree);
+        }
+        prtree->max_num_nodes = max_num_nodes;
+    }
 
-    } else {
+    presult = getResultNode(prtree, prtree->num_nodes);
+    presult->value = value;
+    presult->level = pnode->level;
+    presult->volume = volume; // node volume depends on geometry in physical space, may not be dx*dy*dz
+    presult->pnode = pnode;
+    presult->index = prtree->num_nodes++;
 
-        prtree->right = addResult(prtree->right, value, volume, pnode);
-    }
+    pushResultHeap(prtree, presult);
 
     return (prtree);
 }
 
 /*** function to free results tree */
 
-void freeResultTree(ResultTreeNode* prtree) {
+void freeResultTree(ResultTree* prtree) {
+
+    int n;
 
     if (prtree == NULL)
         return;
 
-    if (prtree->left != NULL)
-        freeResultTree(prtree->left);
-
-    if (prtree->right != NULL)
-        freeResultTree(prtree->right);
+    for (n = 0; n < prtree->num_blocks; n++)
+        free(prtree->blocks[n]);
+    free(prtree->blocks);
+    free(prtree->heap);
+    free(prtree->deferred);
+    free(prtree->sorted);
     free(prtree);
 }
 
 /*** function to get ResultTreeNode with highest value */
 
-ResultTreeNode* getHighestValue(ResultTreeNode* prtree) {
+ResultTreeNode* getHighestValue(ResultTree* prtree) {
 
-    if (prtree == NULL)
+    if (prtree == NULL || prtree->num_nodes < 1)
         return (NULL);
 
-    if (prtree->right == NULL) /* right child is empty */
-        return (prtree);
-
-    return (getHighestValue(prtree->right));
+    return (getSortedResults(prtree)[prtree->num_nodes - 1]);
 }
 
 /*** function to get ResultTree Leaf Node with highest value */
 
-ResultTreeNode* getHighestLeafValue(ResultTreeNode* prtree) {
-
-    if (prtree == NULL)
-        return (NULL);
-
-    ResultTreeNode * prtree_returned = NULL;
+ResultTreeNode* getHighestLeafValue(ResultTree* prtree) {
 
-    if (prtree->right != NULL)
-        prtree_returned = getHighestLeafValue(prtree->right);
-
-    if (prtree_returned != NULL) // right leaf descendent
-        return (prtree_returned); // thus highest value leaf
-    else // no right leaf descendents
-        if (prtree->pnode->isLeaf) // this is leaf
-        return (prtree); // thus highest value leaf
-
-    if (prtree->left != NULL) // look for left leaf descendents
-        prtree_returned = getHighestLeafValue(prtree->left);
-
-    return (prtree_returned);
+    // node sides are always larger than -1
+    return (getHighestLeafValueMinSize(prtree, -1.0, -1.0, -1.0));
 }
 
 /*** function to get ResultTree Leaf Node with highest value, node must be larger than specified minimum size */
 
-ResultTreeNode* getHighestLeafValueMinSize(ResultTreeNode* prtree, double sizeMinX, double sizeMinY, double sizeMinZ) {
+ResultTreeNode* getHighestLeafValueMinSize(ResultTree* prtree, double sizeMinX, double sizeMinY, double sizeMinZ) {
+
+    int n;
+    ResultTreeNode* presult;
 
     if (prtree == NULL) { // no nodes in tree
         return (NULL);
     }
 
-    ResultTreeNode* prtree_returned = NULL;
-
-    if (prtree->right != NULL)
-        prtree_returned = getHighestLeafValueMinSize(prtree->right, sizeMinX, sizeMinY, sizeMinZ);
-
-    if (prtree_returned != NULL) // right leaf descendent
-        return (prtree_returned); // thus highest value leaf
-    else { // no right leaf descendents
-        if (prtree->pnode->isLeaf // this is leaf
-                && prtree->pnode->ds.x >= sizeMinX
-                && prtree->pnode->ds.y >= sizeMinY
-                && prtree->pnode->ds.z >= sizeMinZ) // not too small
-            return (prtree); // thus highest value leaf that is not too small
+    // put back leafs too small for the last query
+    if (sizeMinX != prtree->heap_size_min.x || sizeMinY != prtree->heap_size_min.y || sizeMinZ != prtree->heap_size_min.z) {
+        for (n = 0; n < prtree->num_deferred; n++)
+            pushResultHeap(prtree, prtree->deferred[n]);
+        prtree->num_deferred = 0;
+        prtree->heap_size_min.x = sizeMinX;
+        prtree->heap_size_min.y = sizeMinY;
+        prtree->heap_size_min.z = sizeMinZ;
     }
 
-    if (prtree->left != NULL) // look for left leaf descendents
-        prtree_returned = getHighestLeafValueMinSize(prtree->left, sizeMinX, sizeMinY, sizeMinZ);
+    while (prtree->num_heap > 0) {
+        presult = prtree->heap[0];
+        if (!presult->pnode->isLeaf) { // subdivided, never a leaf again
+            popResultHeap(prtree);
+        } else if (presult->pnode->ds.x < sizeMinX
+                || presult->pnode->ds.y < sizeMinY
+                || presult->pnode->ds.z < sizeMinZ) { // too small
+            prtree->deferred[prtree->num_deferred++] = popResultHeap(prtree);
+        } else {
+            return (presult); // highest value leaf that is not too small
+        }
+    }
 
-    return (prtree_returned);
+    return (NULL);
 }
 
 
@@ -641,123 +837,108 @@ ResultTreeNode* getHighestLeafValueMinSize(ResultTreeNode* prtree, double sizeMi
 
 /*** function to get ResultTree Leaf Node with highest value, node size must be less than or equal to specified maximum size */
 
-ResultTreeNode* getHighestLeafValueLESpecifiedSize(ResultTreeNode* prtree, double sizeX, double sizeY, double sizeZ) {
+ResultTreeNode* getHighestLeafValueLESpecifiedSize(ResultTree* prtree, double sizeX, double sizeY, double sizeZ) {
 
-    ResultTreeNode* prtree_returned = NULL;
+    int n;
+    ResultTreeNode** sorted;
 
-    if (prtree->right != NULL)
-        prtree_returned = getHighestLeafValueLESpecifiedSize(prtree->right, sizeX, sizeY, sizeZ);
+    if (prtree == NULL)
+        return (NULL);
 
-    if (prtree_returned != NULL) // right leaf descendent
-        return (prtree_returned); // thus highest value leaf
-    else { // no right leaf descendents
-        if (prtree->pnode->isLeaf // this is leaf
-                && ((sizeX < 0.0) || (prtree->pnode->ds.x - sizeX < SIZE_TOLERANCE))
-                && ((sizeY < 0.0) || (prtree->pnode->ds.y - sizeY < SIZE_TOLERANCE))
-                && ((sizeZ < 0.0) || (prtree->pnode->ds.z - sizeZ < SIZE_TOLERANCE))
+    sorted = getSortedResults(prtree);
+    for (n = prtree->num_nodes - 1; n >= 0; n--) {
+        if (sorted[n]->pnode->isLeaf // this is leaf
+                && ((sizeX < 0.0) || (sorted[n]->pnode->ds.x - sizeX < SIZE_TOLERANCE))
+                && ((sizeY < 0.0) || (sorted[n]->pnode->ds.y - sizeY < SIZE_TOLERANCE))
+                && ((sizeZ < 0.0) || (sorted[n]->pnode->ds.z - sizeZ < SIZE_TOLERANCE))
                 ) // is specified size
-            return (prtree); // thus highest value leaf that is not too small
+            return (sorted[n]); // thus highest value leaf that is not too small
     }
 
-    if (prtree->left != NULL) // look for left leaf descendents
-        prtree_returned = getHighestLeafValueLESpecifiedSize(prtree->left, sizeX, sizeY, sizeZ);
-
-    return (prtree_returned);
+    return (NULL);
 }
 
 /*** function to get ResultTree Leaf Node with highest value, node size must be equal to specified maximum size */
 
-ResultTreeNode* getHighestLeafValueOfSpecifiedSize(ResultTreeNode* prtree, double sizeX, double sizeY, double sizeZ) {
+ResultTreeNode* getHighestLeafValueOfSpecifiedSize(ResultTree* prtree, double sizeX, double sizeY, double sizeZ) {
 
-    ResultTreeNode* prtree_returned = NULL;
+    int n;
+    ResultTreeNode** sorted;
 
-    if (prtree->right != NULL)
-        prtree_returned = getHighestLeafValueOfSpecifiedSize(prtree->right, sizeX, sizeY, sizeZ);
+    if (prtree == NULL)
+        return (NULL);
 
-    if (prtree_returned != NULL) // right leaf descendent
-        return (prtree_returned); // thus highest value leaf
-    else { // no right leaf descendents
-        if (prtree->pnode->isLeaf // this is leaf
-                && ((sizeX < 0.0) || (fabs(prtree->pnode->ds.x - sizeX) < SIZE_TOLERANCE))
-                && ((sizeY < 0.0) || (fabs(prtree->pnode->ds.y - sizeY) < SIZE_TOLERANCE))
-                && ((sizeZ < 0.0) || (fabs(prtree->pnode->ds.z - sizeZ) < SIZE_TOLERANCE))
+    sorted = getSortedResults(prtree);
+    for (n = prtree->num_nodes - 1; n >= 0; n--) {
+        if (sorted[n]->pnode->isLeaf // this is leaf
+                && ((sizeX < 0.0) || (fabs(sorted[n]->pnode->ds.x - sizeX) < SIZE_TOLERANCE))
+                && ((sizeY < 0.0) || (fabs(sorted[n]->pnode->ds.y - sizeY) < SIZE_TOLERANCE))
+                && ((sizeZ < 0.0) || (fabs(sorted[n]->pnode->ds.z - sizeZ) < SIZE_TOLERANCE))
                 ) // is specified size
-            return (prtree); // thus highest value leaf that is not too small
+            return (sorted[n]); // thus highest value leaf that is not too small
     }
 
-    if (prtree->left != NULL) // look for left leaf descendents
-        prtree_returned = getHighestLeafValueOfSpecifiedSize(prtree->left, sizeX, sizeY, sizeZ);
-
-    return (prtree_returned);
+    return (NULL);
 }
 
 /*** function to get ResultTree Leaf Node at specified level with highest value */
 
-ResultTreeNode* getHighestLeafValueAtSpecifiedLevel(ResultTreeNode* prtree, int level) {
+ResultTreeNode* getHighestLeafValueAtSpecifiedLevel(ResultTree* prtree, int level) {
 
-    ResultTreeNode* prtree_returned = NULL;
+    int n;
+    ResultTreeNode** sorted;
 
-    if (prtree->right != NULL)
-        prtree_returned = getHighestLeafValueAtSpecifiedLevel(prtree->right, level);
+    if (prtree == NULL)
+        return (NULL);
 
-    if (prtree_returned != NULL) // right leaf descendent
-        return (prtree_returned); // thus highest value leaf
-    else { // no right leaf descendents
-        if ((prtree->level == level) // is specified level
-                && prtree->pnode->isLeaf) // this is leaf
-            return (prtree); // thus highest value leaf that is at specfied level
+    sorted = getSortedResults(prtree);
+    for (n = prtree->num_nodes - 1; n >= 0; n--) {
+        if ((sorted[n]->level == level) // is specified level
+                && sorted[n]->pnode->isLeaf) // this is leaf
+            return (sorted[n]); // thus highest value leaf that is at specfied level
     }
 
-    if (prtree->left != NULL) // look for left leaf descendents
-        prtree_returned = getHighestLeafValueAtSpecifiedLevel(prtree->left, level);
-
-    return (prtree_returned);
+    return (NULL);
 }
 
 /*** function to get ResultTree Leaf Node at level less than or equal to specified level with highest value */
 
-ResultTreeNode* getHighestLeafValueLESpecifiedLevel(ResultTreeNode* prtree, int level) {
+ResultTreeNode* getHighestLeafValueLESpecifiedLevel(ResultTree* prtree, int level) {
 
-    ResultTreeNode* prtree_returned = NULL;
+    int n;
+    ResultTreeNode** sorted;
 
-    if (prtree->right != NULL)
-        prtree_returned = getHighestLeafValueLESpecifiedLevel(prtree->right, level);
+    if (prtree == NULL)
+        return (NULL);
 
-    if (prtree_returned != NULL) // right leaf descendent
-        return (prtree_returned); // thus highest value leaf
-    else { // no right leaf descendents
-        if ((prtree->level <= level) // is less than or equal to specified level
-                && prtree->pnode->isLeaf) // this is leaf
-            return (prtree); // thus highest value leaf that is <= specified level
+    sorted = getSortedResults(prtree);
+    for (n = prtree->num_nodes - 1; n >= 0; n--) {
+        if ((sorted[n]->level <= level) // is less than or equal to specified level
+                && sorted[n]->pnode->isLeaf) // this is leaf
+            return (sorted[n]); // thus highest value leaf that is <= specified level
     }
 
-    if (prtree->left != NULL) // look for left leaf descendents
-        prtree_returned = getHighestLeafValueLESpecifiedLevel(prtree->left, level);
-
-    return (prtree_returned);
+    return (NULL);
 }
 
 /*** function to get ResultTree Leaf Node at level greater than or equal to specified level with highest value */
 
-ResultTreeNode* getHighestLeafValueGESpecifiedLevel(ResultTreeNode* prtree, int level) {
+ResultTreeNode* getHighestLeafValueGESpecifiedLevel(ResultTree* prtree, int level) {
 
-    ResultTreeNode* prtree_returned = NULL;
+    int n;
+    ResultTreeNode** sorted;
 
-    if (prtree->right != NULL)
-        prtree_returned = getHighestLeafValueGESpecifiedLevel(prtree->right, level);
+    if (prtree == NULL)
+        return (NULL);
 
-    if (prtree_returned != NULL) // right leaf descendent
-        return (prtree_returned); // thus highest value leaf
-    else { // no right leaf descendents
-        if ((prtree->level >= level) // is greater than or equal to specified level
-                && prtree->pnode->isLeaf) // this is leaf
-            return (prtree); // thus highest value leaf that is >= specified level
+    sorted = getSortedResults(prtree);
+    for (n = prtree->num_nodes - 1; n >= 0; n--) {
+        if ((sorted[n]->level >= level) // is greater than or equal to specified level
+                && sorted[n]->pnode->isLeaf) // this is leaf
+            return (sorted[n]); // thus highest value leaf that is >= specified level
     }
 
-    if (prtree->left != NULL) // look for left leaf descendents
-        prtree_returned = getHighestLeafValueGESpecifiedLevel(prtree->left, level);
-
-    return (prtree_returned);
+    return (NULL);
 }
 
 
@@ -1049,31 +1230,39 @@ int writeNode(FILE *fpio, OctNode *node) {
  *  *poct_tree_scatter_volume = SUM(cell_volume * cell_prob / oct_node_value_ref)
  */
 
-int getScatterSampleResultTreeAtLevels(ResultTreeNode* prtree, int value_type, int num_scatter,
+int getScatterSampleResultTreeAtLevels(ResultTree* prtree, int value_type, int num_scatter,
         double integral, float* fdata, int npoints, int* pfdata_index,
         double oct_node_value_ref, double *poct_tree_scatter_volume, int level_min, int level_max) {
 
+    int n;
+    ResultTreeNode** sorted;
+    ResultTreeNode* presult;
     OctNode* pnode;
     double xnpoints = 0.0;
     double xval, yval, zval;
     double dx, dy, dz;
     //int isample_taken;
 
-    if (prtree->right != NULL)
-        npoints = getScatterSampleResultTreeAtLevels(prtree->right, value_type, num_scatter, integral,
-            fdata, npoints, pfdata_index, oct_node_value_ref, poct_tree_scatter_volume, level_min, level_max);
+    if (prtree == NULL)
+        return (npoints);
+
+    // results in order of decreasing value
+    sorted = getSortedResults(prtree);
+    for (n = prtree->num_nodes - 1; n >= 0 && npoints < num_scatter; n--) {
 
-    pnode = prtree->pnode;
-    //printf("npoints < num_scatter %d && pnode->isLeaf %d && pnode->level >= level_min %d && pnode->level <= level_max %d (level %d min %d max %d\n",
-    //        npoints < num_scatter, pnode->isLeaf, pnode->level >= level_min, pnode->level <= level_max, pnode->level, level_min, level_max);
-    if (npoints < num_scatter && pnode->isLeaf && pnode->level >= level_min && pnode->level <= level_max) {
+        presult = sorted[n];
+        pnode = presult->pnode;
+        //printf("npoints < num_scatter %d && pnode->isLeaf %d && pnode->level >= level_min %d && pnode->level <= level_max %d (level %d min %d max %d\n",
+        //        npoints < num_scatter, pnode->isLeaf, pnode->level >= level_min, pnode->level <= level_max, pnode->level, level_min, level_max);
+        if (!(pnode->isLeaf && pnode->level >= level_min && pnode->level <= level_max))
+            continue;
 
         // AJL 20061023 bug fix - prtree value may not be same as pnode value * volume
-        //xnpoints = (double) num_scatter * exp(prtree->value - oct_node_value_ref) / integral;
+        //xnpoints = (double) num_scatter * exp(presult->value - oct_node_value_ref) / integral;
         if (value_type == VALUE_IS_LOG_PROB_DENSITY_IN_NODE) {
-            xnpoints = (double) num_scatter * (exp(pnode->value - oct_node_value_ref) * prtree->volume) / integral;
+            xnpoints = (double) num_scatter * (exp(pnode->value - oct_node_value_ref) * presult->volume) / integral;
         } else if (value_type == VALUE_IS_PROB_DENSITY_IN_NODE) {
-            xnpoints = prtree->volume * (double) num_scatter * (pnode->value / oct_node_value_ref) / integral;
+            xnpoints = presult->volume * (double) num_scatter * (pnode->value / oct_node_value_ref) / integral;
         } else if (value_type == VALUE_IS_PROBABILITY_IN_NODE) {
             // 20140220 AJL - bug fix
             xnpoints = (double) num_scatter * (pnode->value / oct_node_value_ref) / integral;
@@ -1095,7 +1284,7 @@ int getScatterSampleResultTreeAtLevels(ResultTreeNode* prtree, int value_type, i
 
             if (xnpoints > 1.0 || xnpoints - (double) ((int) xnpoints) > get_rand_double(0.0, 1.0)) {
                 fdata[*pfdata_index + 0] = xval + get_rand_double(-dx, dx);
-                //printf("npoints %d  *pfdata_index %d  %lf  dx %lf  exp(prtree->value) %le  integral %le\n", npoints, *pfdata_index, fdata[*pfdata_index + 0], dx, exp(prtree->value), integral);
+                //printf("npoints %d  *pfdata_index %d  %lf  dx %lf  exp(presult->value) %le  integral %le\n", npoints, *pfdata_index, fdata[*pfdata_index + 0], dx, exp(presult->value), integral);
                 fdata[*pfdata_index + 1] = yval + get_rand_double(-dy, dy);
                 fdata[*pfdata_index + 2] = zval + get_rand_double(-dz, dz);
                 fdata[*pfdata_index + 3] = pnode->value;
@@ -1113,30 +1302,26 @@ int getScatterSampleResultTreeAtLevels(ResultTreeNode* prtree, int value_type, i
         // pnode->value is probability density
         // oct_node_value_ref is maximum probability density
         if (value_type == VALUE_IS_LOG_PROB_DENSITY_IN_NODE) {
-            *poct_tree_scatter_volume += prtree->volume * exp(pnode->value - oct_node_value_ref);
+            *poct_tree_scatter_volume += presult->volume * exp(pnode->value - oct_node_value_ref);
         } else if (value_type == VALUE_IS_PROB_DENSITY_IN_NODE) {
-            *poct_tree_scatter_volume += prtree->volume * ((pnode->value / oct_node_value_ref) > 0.0 ? (pnode->value / oct_node_value_ref) : 0.0);
+            *poct_tree_scatter_volume += presult->volume * ((pnode->value / oct_node_value_ref) > 0.0 ? (pnode->value / oct_node_value_ref) : 0.0);
         } else if (value_type == VALUE_IS_PROBABILITY_IN_NODE) {
             // 20150910 AJL - TEST
             *poct_tree_scatter_volume += (pnode->value / oct_node_value_ref) > 0.0 ? (pnode->value / oct_node_value_ref) : 0.0;
             // 20150215 AJL - bug fix? - need to weight volume by something, TODO: though this (wt by P) is not equivalent to weighting above (wt by PDF)
-            //*poct_tree_scatter_volume += prtree->volume * ((pnode->value / oct_node_value_ref) > 0.0 ? (pnode->value / oct_node_value_ref) : 0.0);
+            //*poct_tree_scatter_volume += presult->volume * ((pnode->value / oct_node_value_ref) > 0.0 ? (pnode->value / oct_node_value_ref) : 0.0);
             // 20140220 AJL - bug fix
-            //printf("poct_tree_scatter_volume %f  volume %f  value%f  oct_node_value_ref%f\n", *poct_tree_scatter_volume, prtree->volume, pnode->value, oct_node_value_ref);
+            //printf("poct_tree_scatter_volume %f  volume %f  value%f  oct_node_value_ref%f\n", *poct_tree_scatter_volume, presult->volume, pnode->value, oct_node_value_ref);
             //*poct_tree_scatter_volume += (pnode->value - oct_node_value_ref) > 0.0 ? (pnode->value - oct_node_value_ref) : 0.0;
         }
     }
 
-    if (prtree->left != NULL)
-        npoints = getScatterSampleResultTreeAtLevels(prtree->left, value_type, num_scatter, integral,
-            fdata, npoints, pfdata_index, oct_node_value_ref, poct_tree_scatter_volume, level_min, level_max);
-
     return (npoints);
 }
 
 /** function to get scatter sample for all leafs in results tree */
 
-int getScatterSampleResultTree(ResultTreeNode* prtree, int value_type, int num_scatter,
+int getScatterSampleResultTree(ResultTree* prtree, int value_type, int num_scatter,
         double integral, float* fdata, int npoints, int* pfdata_index,
         double oct_node_value_ref, double *poct_tree_scatter_volume) {
 
@@ -1151,40 +1336,43 @@ int getScatterSampleResultTree(ResultTreeNode* prtree, int value_type, int num_s
 
 /** function to integrate exp(val) * volume of all leafs in results tree */
 
-double integrateResultTreeAtLevels(ResultTreeNode* prtree, int value_type, double sum, double oct_node_value_ref, int level_min, int level_max) {
+double integrateResultTreeAtLevels(ResultTree* prtree, int value_type, double sum, double oct_node_value_ref, int level_min, int level_max) {
 
+    int n;
+    ResultTreeNode** sorted;
     OctNode* pnode;
 
-    if (prtree->left != NULL)
-        sum = integrateResultTreeAtLevels(prtree->left, value_type, sum, oct_node_value_ref, level_min, level_max);
-
-    pnode = prtree->pnode;
-    if (pnode->isLeaf && pnode->level >= level_min && pnode->level <= level_max) {
-        //printf("DEBUG: sum_in=%f", sum);
-        // result tree value is log(value + volume)
-        // AJL 20061023 bug fix - prtree value may not be same as pnode value * volume
-        //sum += exp(prtree->value - oct_node_value_ref);
-        if (value_type == VALUE_IS_LOG_PROB_DENSITY_IN_NODE) {
-            sum += exp(pnode->value - oct_node_value_ref) * prtree->volume;
-        } else if (value_type == VALUE_IS_PROB_DENSITY_IN_NODE) {
-            sum += prtree->volume * ((pnode->value / oct_node_value_ref) > 0.0 ? (pnode->value / oct_node_value_ref) : 0.0);
-        } else if (value_type == VALUE_IS_PROBABILITY_IN_NODE) {
-            // 20140220 AJL - bug fix
-            sum += (pnode->value / oct_node_value_ref) > 0.0 ? (pnode->value / oct_node_value_ref) : 0.0;
-            //sum += (pnode->value - oct_node_value_ref) > 0.0 ? (pnode->value - oct_node_value_ref) : 0.0;
+    if (prtree == NULL)
+        return (sum);
+
+    // results in order of increasing value
+    sorted = getSortedResults(prtree);
+    for (n = 0; n < prtree->num_nodes; n++) {
+        pnode = sorted[n]->pnode;
+        if (pnode->isLeaf && pnode->level >= level_min && pnode->level <= level_max) {
+            //printf("DEBUG: sum_in=%f", sum);
+            // result tree value is log(value + volume)
+            // AJL 20061023 bug fix - prtree value may not be same as pnode value * volume
+            //sum += exp(sorted[n]->value - oct_node_value_ref);
+            if (value_type == VALUE_IS_LOG_PROB_DENSITY_IN_NODE) {
+                sum += exp(pnode->value - oct_node_value_ref) * sorted[n]->volume;
+            } else if (value_type == VALUE_IS_PROB_DENSITY_IN_NODE) {
+                sum += sorted[n]->volume * ((pnode->value / oct_node_value_ref) > 0.0 ? (pnode->value / oct_node_value_ref) : 0.0);
+            } else if (value_type == VALUE_IS_PROBABILITY_IN_NODE) {
+                // 20140220 AJL - bug fix
+                sum += (pnode->value / oct_node_value_ref) > 0.0 ? (pnode->value / oct_node_value_ref) : 0.0;
+                //sum += (pnode->value - oct_node_value_ref) > 0.0 ? (pnode->value - oct_node_value_ref) : 0.0;
+            }
+            //printf(" sum=%f  leaf=%d  level=%d  value=%f oct_node_value_ref=%f volume=%f exp()=%f\n", sum, pnode->isLeaf, pnode->level, pnode->value, oct_node_value_ref, sorted[n]->volume, exp(pnode->value - oct_node_value_ref) * sorted[n]->volume);
         }
-        //printf(" sum=%f  leaf=%d  level=%d  value=%f oct_node_value_ref=%f volume=%f exp()=%f\n", sum, pnode->isLeaf, pnode->level, pnode->value, oct_node_value_ref, prtree->volume, exp(pnode->value - oct_node_value_ref) * prtree->volume);
     }
 
-    if (prtree->right != NULL)
-        sum = integrateResultTreeAtLevels(prtree->right, value_type, sum, oct_node_value_ref, level_min, level_max);
-
     return (sum);
 }
 
 /** function to integrate exp(val) * volume of all leafs in results tree */
 
-double integrateResultTree(ResultTreeNode* prtree, int value_type, double sum, double oct_node_value_ref) {
+double integrateResultTree(ResultTree* prtree, int value_type, double sum, double oct_node_value_ref) {
 
     int level_min = -1;
     int level_max = 9999;
@@ -1194,74 +1382,80 @@ double integrateResultTree(ResultTreeNode* prtree, int value_type, double sum, d
 
 /** function to convert value of all leafs in results tree to probability density */
 
-double convertOcttreeValuesToProbabilityDensity(ResultTreeNode* prtree, int value_type, double integral, double oct_node_value_ref) {
+double convertOcttreeValuesToProbabilityDensity(ResultTree* prtree, int value_type, double integral, double oct_node_value_ref) {
 
+    int n;
+    ResultTreeNode** sorted;
     OctNode* pnode;
 
-    if (prtree->left != NULL)
-        integral = convertOcttreeValuesToProbabilityDensity(prtree->left, value_type, integral, oct_node_value_ref);
-
-    pnode = prtree->pnode;
-    if (pnode->isLeaf) {
-        if (value_type == VALUE_IS_LOG_PROB_DENSITY_IN_NODE) {
-            pnode->value = exp(pnode->value - oct_node_value_ref); // replace leaf value with relative prob density
-            integral += pnode->value * prtree->volume; // integrate value * cell volume
-        } else if (value_type == VALUE_IS_PROB_DENSITY_IN_NODE) {
-            pnode->value = ((pnode->value / oct_node_value_ref) > 0.0 ? (pnode->value / oct_node_value_ref) : 0.0); // replace leaf value with relative prob density
-            integral += pnode->value * prtree->volume; // integrate value * cell volume
-        } else if (value_type == VALUE_IS_PROBABILITY_IN_NODE) {
-            pnode->value = (pnode->value / oct_node_value_ref) > 0.0 ? (pnode->value / oct_node_value_ref) : 0.0; // replace leaf value with relative prob density
-            integral += pnode->value; // integrate prob
-            pnode->value /= prtree->volume; // convert to prob den
+    if (prtree == NULL)
+        return (integral);
+
+    sorted = getSortedResults(prtree);
+    for (n = 0; n < prtree->num_nodes; n++) {
+        pnode = sorted[n]->pnode;
+        if (pnode->isLeaf) {
+            if (value_type == VALUE_IS_LOG_PROB_DENSITY_IN_NODE) {
+                pnode->value = exp(pnode->value - oct_node_value_ref); // replace leaf value with relative prob density
+                integral += pnode->value * sorted[n]->volume; // integrate value * cell volume
+            } else if (value_type == VALUE_IS_PROB_DENSITY_IN_NODE) {
+                pnode->value = ((pnode->value / oct_node_value_ref) > 0.0 ? (pnode->value / oct_node_value_ref) : 0.0); // replace leaf value with relative prob density
+                integral += pnode->value * sorted[n]->volume; // integrate value * cell volume
+            } else if (value_type == VALUE_IS_PROBABILITY_IN_NODE) {
+                pnode->value = (pnode->value / oct_node_value_ref) > 0.0 ? (pnode->value / oct_node_value_ref) : 0.0; // replace leaf value with relative prob density
+                integral += pnode->value; // integrate prob
+                pnode->value /= sorted[n]->volume; // convert to prob den
+            }
         }
     }
 
-    if (prtree->right != NULL)
-        integral = convertOcttreeValuesToProbabilityDensity(prtree->right, value_type, integral, oct_node_value_ref);
-
     return (integral);
 
 }
 
 /** function to normalize value of all leafs in results tree */
 
-double normalizeProbabilityDensityOcttree(ResultTreeNode* prtree, double integral, double norm) {
+double normalizeProbabilityDensityOcttree(ResultTree* prtree, double integral, double norm) {
 
+    int n;
+    ResultTreeNode** sorted;
     OctNode* pnode;
 
-    if (prtree->left != NULL)
-        integral = normalizeProbabilityDensityOcttree(prtree->left, integral, norm);
-
-    pnode = prtree->pnode;
-    if (pnode->isLeaf) {
-        pnode->value /= norm; // normalize
-        integral += pnode->value * prtree->volume; // integrate value * cell volume
+    if (prtree == NULL)
+        return (integral);
+
+    sorted = getSortedResults(prtree);
+    for (n = 0; n < prtree->num_nodes; n++) {
+        pnode = sorted[n]->pnode;
+        if (pnode->isLeaf) {
+            pnode->value /= norm; // normalize
+            integral += pnode->value * sorted[n]->volume; // integrate value * cell volume
+        }
     }
 
-    if (prtree->right != NULL)
-        integral = normalizeProbabilityDensityOcttree(prtree->right, integral, norm);
-
     return (integral);
 
 }
 
 /** function to create a new ResultTree using node values */
 
-ResultTreeNode * createResultTree(ResultTreeNode* prtree, ResultTreeNode * pnew_rtree) {
+ResultTree * createResultTree(ResultTree* prtree, ResultTree * pnew_rtree) {
 
+    int n;
+    ResultTreeNode** sorted;
     OctNode* pnode;
 
-    if (prtree->left != NULL)
-        pnew_rtree = createResultTree(prtree->left, pnew_rtree);
+    if (prtree == NULL)
+        return (pnew_rtree);
 
-    pnode = prtree->pnode;
-    if (pnode->isLeaf) {
-        pnew_rtree = addResult(pnew_rtree, pnode->value, prtree->volume, pnode);
+    sorted = getSortedResults(prtree);
+    for (n = 0; n < prtree->num_nodes; n++) {
+        pnode = sorted[n]->pnode;
+        if (pnode->isLeaf) {
+            pnew_rtree = addResult(pnew_rtree, pnode->value, sorted[n]->volume, pnode);
+        }
     }
 
-    if (prtree->right != NULL)
-        pnew_rtree = createResultTree(prtree->right, pnew_rtree);
-
     return (pnew_rtree);
 
 }
@@ -40,10 +40,14 @@ tel: +33(0)493752502  e-mail: anthony@alomax.net  web: http://www.alomax.net
 #include <limits.h>
 #include <time.h>
 
+#ifndef NLL_THREAD_LOCAL
+#define NLL_THREAD_LOCAL __thread
+#endif
+
 #ifdef EXTERN_MODE
-#define	EXTERN_TXT extern
+#define	EXTERN_TXT extern NLL_THREAD_LOCAL
 #else
-#define EXTERN_TXT
+#define EXTERN_TXT NLL_THREAD_LOCAL
 #endif
 
 	/* misc defines */
@@ -70,6 +74,31 @@ tel: +33(0)493752502  e-mail: anthony@alomax.net  web: http://www.alomax.net
 #define VALUE_IS_PROB_DENSITY_IN_NODE 1     // pdf (does not take into account volume of cell)
 #define VALUE_IS_PROBABILITY_IN_NODE 2     // pdf * cell volume (takes into account volume of cell)
 
+/* arena for the nodes of a Tree3D and their data, released with the tree */
+
+#define OCT_ARENA_BLOCK_SIZE (1024 * 1024)
+
+typedef struct octArenaBlock {
+	struct octArenaBlock* next;	/* previous block */
+	size_t size;			/* usable size of block */
+	size_t used;			/* allocated size of block */
+} OctArenaBlock;
+
+typedef struct octArena {
+	OctArenaBlock* blocks;		/* current block, first in list */
+	size_t bytes;			/* size of all blocks */
+	long num_nodes;			/* number of nodes allocated */
+} OctArena;
+
+/* octree memory of the calling thread */
+
+typedef struct {
+	long num_nodes;			/* nodes of trees not freed */
+	long peak_num_nodes;
+	size_t bytes;			/* arena size of trees not freed */
+	size_t peak_bytes;
+} OctreeMemStats;
+
 /* octree node */
 
 typedef struct octnode* OctNodePtr;
@@ -82,7 +111,8 @@ typedef struct octnode
 	double value;			/* node value */
 	OctNodePtr child[2][2][2];	/* child nodes */
 	char isLeaf;			/* leaf flag, 1=leaf, for read/write spherical: -1=NULL node */
-	void *pdata;		/* additional data */
+	void *pdata;		/* additional data, allocate with newOctNodeData() */
+	OctArena* arena;		/* arena of tree containing node */
 } OctNode;
 
 
@@ -100,22 +130,44 @@ typedef struct
         int* num_x;                 // array of true num_x values for spherical case
 	double integral;
         int isSpherical;            // =1 if Tree3D is spherical, 0 otherwise
+	OctArena* arena;            // nodes and node data
 }
 Tree3D;
 
 
 /* structure for storing results */
 
-typedef struct resultTreeNode* ResultTreeNodePtr;
 typedef struct resultTreeNode {
-	ResultTreeNodePtr left;		/* address of left node */
-	ResultTreeNodePtr right;	/* address of right node */
 	double value;			/* sort value */
 	int level;			/* level of node in oect-tree hierarchy (0 = top, largest) */
 	double volume;		/* volume, node volume depends on geometry in physical space, may not be dx*dy*dz */
 	OctNode* pnode;			/* corresponding octree node */
+	int index;			/* order of addition, results with same value are sorted by index */
 } ResultTreeNode;
 
+#define RESULT_TREE_BLOCK_SIZE 4096
+
+/* results in order of value
+ *
+ * result nodes are allocated in blocks and do not move, the leaf with the
+ * highest value is taken from a max-heap, results no longer leafs are removed
+ * from the heap when they reach the top. Iteration in order of value uses a
+ * sorted list of all results, created when needed. */
+
+typedef struct {
+	ResultTreeNode** blocks;	/* result nodes, RESULT_TREE_BLOCK_SIZE per block */
+	int num_blocks;
+	int num_nodes;			/* number of results */
+	int max_num_nodes;		/* size of heap, deferred and sorted */
+	ResultTreeNode** heap;		/* max-heap of results that may be leafs */
+	int num_heap;
+	ResultTreeNode** deferred;	/* leafs removed from heap as smaller than heap_size_min */
+	int num_deferred;
+	Vect3D heap_size_min;		/* minimum leaf size of last heap query */
+	ResultTreeNode** sorted;	/* results in order of increasing value */
+	int num_sorted;			/* number of sorted results, list is valid if equal to num_nodes */
+} ResultTree;
+
 
 
 /* */
@@ -146,24 +198,26 @@ Tree3D* newTree3D_spherical(int data_code, int numx_nominal, int numy, int numz,
         double origx, double origy, double origz,
         double dx_nominal, double dy, double dz, double value, double integral, void *pdata);
 double get_dx_spherical(double dx_nominal, double origx, double x_max, double center_y, int *pnum_x);
-OctNode* newOctNode(OctNode* parent, Vect3D center, Vect3D ds, double value, void *pdata);
+OctNode* newOctNode(OctArena* arena, OctNode* parent, Vect3D center, Vect3D ds, double value, void *pdata);
+void* newOctNodeData(OctNode* node, size_t size);
 void subdivide(OctNode* parent, double value, void *pdata);
 void freeTree3D(Tree3D* tree, int freeDataPointer);
-void freeNode(OctNode* node, int freeDataPointer);
+void getOctreeMemStats(OctreeMemStats* pstats);
+void resetOctreeMemPeak();
 OctNode* getTreeNodeContaining(Tree3D* tree, Vect3D coords, double *padjusted_coords_x);
 OctNode* getLeafNodeContaining(Tree3D* tree, Vect3D coords);
 OctNode* getLeafContaining(OctNode* node, double x, double y, double z);
 
-ResultTreeNode* addResult(ResultTreeNode* prtn, double value, double volume, OctNode* pnode);
-void freeResultTree(ResultTreeNode* prtn);
-ResultTreeNode* getHighestValue(ResultTreeNode* prtn);
-ResultTreeNode* getHighestLeafValue(ResultTreeNode* prtree);
-ResultTreeNode* getHighestLeafValueMinSize(ResultTreeNode* prtree, double sizeMinX, double sizeMinY, double sizeMinZ);
-ResultTreeNode* getHighestLeafValueLESpecifiedSize(ResultTreeNode* prtree, double sizeX, double sizeY, double sizeZ);
-ResultTreeNode* getHighestLeafValueOfSpecifiedSize(ResultTreeNode* prtree, double sizeX, double sizeY, double sizeZ);
-ResultTreeNode* getHighestLeafValueAtSpecifiedLevel(ResultTreeNode* prtree, int level);
-ResultTreeNode* getHighestLeafValueLESpecifiedLevel(ResultTreeNode* prtree, int level);
-ResultTreeNode* getHighestLeafValueGESpecifiedLevel(ResultTreeNode* prtree, int level);
+ResultTree* addResult(ResultTree* prtree, double value, double volume, OctNode* pnode);
+void freeResultTree(ResultTree* prtree);
+ResultTreeNode* getHighestValue(ResultTree* prtree);
+ResultTreeNode* getHighestLeafValue(ResultTree* prtree);
+ResultTreeNode* getHighestLeafValueMinSize(ResultTree* prtree, double sizeMinX, double sizeMinY, double sizeMinZ);
+ResultTreeNode* getHighestLeafValueLESpecifiedSize(ResultTree* prtree, double sizeX, double sizeY, double sizeZ);
+ResultTreeNode* getHighestLeafValueOfSpecifiedSize(ResultTree* prtree, double sizeX, double sizeY, double sizeZ);
+ResultTreeNode* getHighestLeafValueAtSpecifiedLevel(ResultTree* prtree, int level);
+ResultTreeNode* getHighestLeafValueLESpecifiedLevel(ResultTree* prtree, int level);
+ResultTreeNode* getHighestLeafValueGESpecifiedLevel(ResultTree* prtree, int level);
 
 Tree3D* readTree3D(FILE *fpio);
 int readNode(FILE *fpio, OctNode* node);
@@ -173,17 +227,17 @@ int writeNode(FILE *fpio, OctNode* node);
 int nodeContains(OctNode* node, double x, double y, double z);
 int extendedNodeContains(OctNode* node, double x, double y, double z, int checkZ);
 
-int getScatterSampleResultTreeAtLevels(ResultTreeNode* prtree, int value_type, int num_scatter,
+int getScatterSampleResultTreeAtLevels(ResultTree* prtree, int value_type, int num_scatter,
         double integral, float* fdata, int npoints, int* pfdata_index,
         double oct_node_value_ref, double *poct_tree_scatter_volume, int level_min, int level_max);
-int getScatterSampleResultTree(ResultTreeNode* prtree, int value_type, int num_scatter,
+int getScatterSampleResultTree(ResultTree* prtree, int value_type, int num_scatter,
         double integral, float* fdata, int npoints, int* pfdata_index,
         double oct_node_value_max, double *poct_tree_scatter_volume);
-double convertOcttreeValuesToProbabilityDensity(ResultTreeNode* prtree, int value_type, double integral, double oct_node_value_ref);
-double normalizeProbabilityDensityOcttree(ResultTreeNode* prtree, double integral, double norm);
-double integrateResultTreeAtLevels(ResultTreeNode* prtree, int value_type, double sum, double oct_node_value_max, int level_min, int level_max);
-double integrateResultTree(ResultTreeNode* prtree, int value_type, double sum, double oct_node_value_max);
-ResultTreeNode* createResultTree(ResultTreeNode* prtree, ResultTreeNode* pnew_rtree);
+double convertOcttreeValuesToProbabilityDensity(ResultTree* prtree, int value_type, double integral, double oct_node_value_ref);
+double normalizeProbabilityDensityOcttree(ResultTree* prtree, double integral, double norm);
+double integrateResultTreeAtLevels(ResultTree* prtree, int value_type, double sum, double oct_node_value_max, int level_min, int level_max);
+double integrateResultTree(ResultTree* prtree, int value_type, double sum, double oct_node_value_max);
+ResultTree* createResultTree(ResultTree* prtree, ResultTree* pnew_rtree);
 
 
 /* */
@@ -280,8 +280,8 @@ int writePhaseList(PhsNode *head, FILE *out)
 
 /** function to convert arrival date/time to double time value */
 
-static struct tm time_1970 = {0, 0, 1, 1, 0, 70, 0, 0, 0};
-static time_t time_1970_seconds = LONG_MIN;
+static NLL_THREAD_LOCAL struct tm time_1970 = {0, 0, 1, 1, 0, 70, 0, 0, 0};
+static NLL_THREAD_LOCAL time_t time_1970_seconds = LONG_MIN;
 static time_t TIME_T_INVALID = LONG_MIN;
 
 double getPhaseTimeValue(ArrivalDesc *parrival)
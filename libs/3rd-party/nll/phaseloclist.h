@@ -40,10 +40,14 @@ tel: +33(0)493752502  e-mail: anthony@alomax.net  web: http://www.alomax.net
 #include <limits.h>
 #include <time.h>
 
+#ifndef NLL_THREAD_LOCAL
+#define NLL_THREAD_LOCAL __thread
+#endif
+
 #ifdef EXTERN_MODE
-#define	EXTERN_TXT extern
+#define	EXTERN_TXT extern NLL_THREAD_LOCAL
 #else
-#define EXTERN_TXT
+#define EXTERN_TXT NLL_THREAD_LOCAL
 #endif
 
 
@@ -136,7 +140,7 @@ typedef struct locnode
 /* globals  */
 /*------------------------------------------------------------/ */
 
-EXTERN_TXT ArrivalDesc arrivals_tmp[MAX_NUM_PHASES_PER_LOC];
+EXTERN_TXT ArrivalDesc *arrivals_tmp; /* [MAX_NUM_PHASES_PER_LOC], see AllocThreadGlobals() */
 
 /* */
 /*------------------------------------------------------------/ */
@@ -2,6 +2,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #define EXTERN_MODE 1
 
@@ -101,9 +102,9 @@ void test_rand_int()
  *	Global variables for rstart & uni
  */
 
-double uni_u[98];	/* Was U(97) in Fortran version -- too lazy to fix */
-double uni_c, uni_cd, uni_cm;
-int uni_ui, uni_uj;
+NLL_THREAD_LOCAL double uni_u[98];	/* Was U(97) in Fortran version -- too lazy to fix */
+NLL_THREAD_LOCAL double uni_c, uni_cd, uni_cm;
+NLL_THREAD_LOCAL int uni_ui, uni_uj;
 
  double uni(void)
 {
@@ -152,6 +153,31 @@ int uni_ui, uni_uj;
 }
 
 
+/* ~uni_get_state, uni_set_state: save and restore the generator state,
+ *	e.g. to advance several independent streams in turn
+ */
+
+void uni_get_state(UniState *state)
+{
+	memcpy(state->u, uni_u, sizeof(uni_u));
+	state->c = uni_c;
+	state->cd = uni_cd;
+	state->cm = uni_cm;
+	state->ui = uni_ui;
+	state->uj = uni_uj;
+}
+
+void uni_set_state(const UniState *state)
+{
+	memcpy(uni_u, state->u, sizeof(uni_u));
+	uni_c = state->c;
+	uni_cd = state->cd;
+	uni_cm = state->cm;
+	uni_ui = state->ui;
+	uni_uj = state->uj;
+}
+
+
 /* ~rinit: this takes a single integer in the range
 		0 <= ijkl <= 900 000 000
 	and produces the four smaller integers needed for rstart. It is
@@ -12,6 +12,10 @@
 EXTERN_TXT int RanSeed;
 // 20220118 AJL */
 
+#ifndef NLL_THREAD_LOCAL
+#define NLL_THREAD_LOCAL __thread
+#endif
+
 
 
 int get_rand_int(const int, const int);
@@ -70,9 +74,18 @@ double ran1(int* idum);
 
 /*//////// UNI stuff */
 
+/* state of the UNI generator, allows several independent streams in one thread */
+typedef struct {
+	double u[98];
+	double c, cd, cm;
+	int ui, uj;
+} UniState;
+
 double uni(void);
 void rstart(int i, int j, int k, int l);
 void rinit(int ijkl);
+void uni_get_state(UniState *state);
+void uni_set_state(const UniState *state);
 
 
 #endif
@@ -43,10 +43,14 @@
 #define VERY_SMALL_DOUBLE 1.0e-30
 #endif
 
+#ifndef NLL_THREAD_LOCAL
+#define NLL_THREAD_LOCAL __thread
+#endif
+
 #ifdef EXTERN_MODE
-#define	EXTERN_TXT extern
+#define	EXTERN_TXT extern NLL_THREAD_LOCAL
 #else
-#define EXTERN_TXT
+#define EXTERN_TXT NLL_THREAD_LOCAL
 #endif
 
 EXTERN_TXT char package_name[MAXLINE];
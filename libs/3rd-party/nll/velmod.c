@@ -32,9 +32,9 @@
 
 #undef EXTERN_TXT
 #ifdef EXTERN_MODE
-#define EXTERN_TXT extern
+#define EXTERN_TXT extern NLL_THREAD_LOCAL
 #else
-#define EXTERN_TXT
+#define EXTERN_TXT NLL_THREAD_LOCAL
 #endif
 
 
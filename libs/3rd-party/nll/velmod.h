@@ -68,7 +68,7 @@
 #endif
 
 /* externally defined names */
-extern int prog_mode_3d; /* 0 = 2D, 1 = 3D calculation */
+extern NLL_THREAD_LOCAL int prog_mode_3d; /* 0 = 2D, 1 = 3D calculation */
 //extern void puterr(char* );
 
 EXTERN_TXT double min_x_cut; /* minimum x distance cutoff */
@@ -44,10 +44,10 @@ extern "C" {
 #include <seiscomp/utils/replace.h>
 
 #include <fstream>
-#include <sstream>
-#include <iomanip>
 #include <set>
 
+#include <sys/stat.h>
+
 
 ADD_SC_PLUGIN(
 	"Locator implementation using NonLinLoc by Anthony Lomax "
@@ -254,20 +254,39 @@ double timeError(const TimeQuantity &t, double defaultValue) {
 
 
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
-void replaceWeight(vector<string> &observations, const std::string staCode,
-                   double weight) {
-	for ( vector<string>::iterator it = observations.begin();
-	      it != observations.end(); ++it ) {
-		size_t pos = it->find(' ');
-		if ( pos == string::npos ) continue;
-		if ( it->compare(0, pos, staCode) != 0 ) continue;
-
-		pos = it->rfind(' ');
-		if ( pos == string::npos ) continue;
-
-		it->replace(pos+1, it->size(), Core::toString(weight)+"\n");
-		break;
-	}
+void copyLabel(char *target, size_t size, const std::string &label) {
+	strncpy(target, label.c_str(), size-1);
+	target[size-1] = '\0';
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Formats an observation record as NLLOC_OBS line, used to save the input
+std::string observationLine(const ObsArrivalDesc &arr) {
+	char line[512];
+	snprintf(line, sizeof(line),
+	         "%-10s %s %s %s %s %s %04d%02d%02d %02d%02d %07.4f %s "
+	         "%.2e %.2e %.2e %.2e %.2e\n",
+	         arr.label, arr.inst, arr.comp, arr.onset, arr.phase, arr.first_mot,
+	         arr.year, arr.month, arr.day, arr.hour, arr.min, arr.sec,
+	         arr.error_type, arr.error, arr.coda_dur, arr.amplitude,
+	         arr.period, arr.apriori_weight);
+	return line;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Formats a station record as LOCSRCE statement, used to save the input
+std::string sourceLine(const SourceDesc &src) {
+	return string("LOCSRCE ") + src.label + " LATLON " +
+	       Core::toString(src.dlat) + " " + Core::toString(src.dlong) +
+	       " 0 " + Core::toString(-src.depth);
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
@@ -334,7 +353,15 @@ std::string stationName(const Seiscomp::DataModel::Pick *pick, const std::string
 // >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
 REGISTER_LOCATOR(NLLocator, "NonLinLoc");
 
-NLLocator::IDList NLLocator::_allowedParameters;
+NLLocator::IDList NLLocator::_allowedParameters = {
+	"CONTROL",
+	"LOCGRID",
+	"LOCGAU",
+	"LOCGAU2",
+	"LOCELEVCORR",
+	"LOCSEARCH",
+	"LOCMETH"
+};
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
 
@@ -345,16 +372,6 @@ NLLocator::NLLocator() {
 	_name = "NonLinLoc";
 	_publicIDPattern = "NLL.@time/%Y%m%d%H%M%S.%f@.@id@";
 
-	if ( _allowedParameters.empty() ) {
-		_allowedParameters.push_back("CONTROL");
-		_allowedParameters.push_back("LOCGRID");
-		_allowedParameters.push_back("LOCGAU");
-		_allowedParameters.push_back("LOCGAU2");
-		_allowedParameters.push_back("LOCELEVCORR");
-		_allowedParameters.push_back("LOCSEARCH");
-		_allowedParameters.push_back("LOCMETH");
-	}
-
 	_defaultPickError = 0.5;
 	_fixedDepthGridSpacing = 0.1;
 	_allowMissingStations = true;
@@ -556,6 +573,55 @@ bool NLLocator::init(const Config::Config &config) {
 		_allowMissingStations = true;
 	}
 
+	int gridCacheSize;
+	try {
+		gridCacheSize = config.getInt("NonLinLoc.gridCacheSize");
+	}
+	catch ( ... ) {
+		gridCacheSize = 512;
+	}
+
+	bool mapGrids;
+	try {
+		mapGrids = config.getBool("NonLinLoc.mapGrids");
+	}
+	catch ( ... ) {
+		mapGrids = false;
+	}
+
+	bool tileGrids;
+	try {
+		tileGrids = config.getBool("NonLinLoc.tileGrids");
+	}
+	catch ( ... ) {
+		tileGrids = false;
+	}
+
+	// The grid cache is shared by all locator instances of the process
+	NLL_SetGridMemoryLimit(gridCacheSize > 0 ? (size_t)gridCacheSize * 1024 * 1024 : 0);
+	NLL_SetGridMemoryMap(mapGrids ? 1 : 0);
+	NLL_SetGridMemoryTiling(tileGrids ? 1 : 0);
+
+	int octreeThreads;
+	try {
+		octreeThreads = config.getInt("NonLinLoc.octreeThreads");
+	}
+	catch ( ... ) {
+		octreeThreads = 1;
+	}
+
+	NLL_SetOctreeThreads(octreeThreads);
+
+	bool fastEDT;
+	try {
+		fastEDT = config.getBool("NonLinLoc.fastEDT");
+	}
+	catch ( ... ) {
+		fastEDT = false;
+	}
+
+	NLL_SetFastEDT(fastEDT ? 1 : 0);
+
 	try {
 		_enableSEDParameters = config.getBool("NonLinLoc.enableSEDParameters");
 	}
@@ -671,7 +737,8 @@ Origin* NLLocator::locate(PickList &pickList) {
 		throw GeneralException("No profile set");
 	}
 
-	if ( _controlFile.empty() ) {
+	const ControlSetup &setup = _currentProfile->setup;
+	if ( setup.lines.empty() ) {
 		throw GeneralException("Invalid control file");
 	}
 
@@ -694,7 +761,9 @@ Origin* NLLocator::locate(PickList &pickList) {
 	}
 
 
-	TextLines obs, params;
+	TextLines params;
+	vector<ObsArrivalDesc> arrivals;
+	vector<SourceDesc> stations;
 	std::vector<string> observationIDs;
 
 	// copy user set parameters to param strings
@@ -705,7 +774,7 @@ Origin* NLLocator::locate(PickList &pickList) {
 
 	PickList usedPicks;
 
-	// create observation buffer
+	// create observation and station records
 	for ( PickList::iterator it = pickList.begin();
 	      it != pickList.end(); ++it )
 	{
@@ -735,60 +804,53 @@ Origin* NLLocator::locate(PickList &pickList) {
 
 		usedPicks.push_back(*it);
 
-		// create the LOCSRCE entries 
-		params.push_back(string("LOCSRCE ") +
-		                 stationName(pick, stationNameFormat) +
-		                 " LATLON " +
-		                 toString(sloc->latitude()) + " " +
-		                 toString(sloc->longitude()) + " 0 " +
-		                 toString(sloc->elevation()*0.001));
-		stringstream ss;
-		ss << setprecision(2);
-		ss.setf(ios_base::scientific, ios_base::floatfield);
-
-		ss // station code
-		   << left << setw(10) << stationName(pick, stationNameFormat)
-		   << internal << setw(0) << " "
-		   // instrument
-		   << "? "
-		   // component
-		   << (pick->waveformID().channelCode().size() > 2
-		       ?
-		         pick->waveformID().channelCode().substr(pick->waveformID().channelCode().size()-1)
-		       :
-		         "?"
-		       ) << " "
-		   // P phase onset (i, e)
-		   << "? "
-		   // phase descriptor
-		   << pick->phaseHint().code() << " "
-		   // first motion
-		   << "? "
-		   // date
-		   << pick->time().value().toString("%Y%m%d") << " "
-		   // hour Minute
-		   << pick->time().value().toString("%H%M") << " "
-		   // seconds
-		   << pick->time().value().toString("%S.%4f") << " "
-		   // error type
-		   << "GAU "
-		   // error magnitude
-		   << timeError(pick->time(), _defaultPickError) << " "
-		   // coda duration
-		   << -1.0 << " "
-		   // amplitude
-		   << -1.0 << " "
-		   // period
-		   << -1.0 << " "
-		   // priorWt
-		   << weight << endl;
-
-		// NOTE: The weight must be the last value otherwise the method "replaceWeight"
-		//       needs to be changed.
-		obs.push_back(ss.str());
-	}
-
-	if ( obs.empty() ) {
+		string label = stationName(pick, stationNameFormat);
+
+		// The station coordinates, passed as LOCSRCE to NLLoc
+		SourceDesc station;
+		memset(&station, 0, sizeof(station));
+		copyLabel(station.label, sizeof(station.label), label);
+		station.dlat = sloc->latitude();
+		station.dlong = sloc->longitude();
+		station.depth = -sloc->elevation()*0.001;
+		station.is_coord_latlon = 1;
+		stations.push_back(station);
+
+		// The observation, passed as NLLOC_OBS arrival to NLLoc
+		ObsArrivalDesc arr;
+		memset(&arr, 0, sizeof(arr));
+		copyLabel(arr.label, sizeof(arr.label), label);
+		copyLabel(arr.inst, sizeof(arr.inst), "?");
+		// component
+		copyLabel(arr.comp, sizeof(arr.comp),
+		          pick->waveformID().channelCode().size() > 2
+		          ?
+		            pick->waveformID().channelCode().substr(pick->waveformID().channelCode().size()-1)
+		          :
+		            "?");
+		// P phase onset (i, e)
+		copyLabel(arr.onset, sizeof(arr.onset), "?");
+		// phase descriptor
+		copyLabel(arr.phase, sizeof(arr.phase), pick->phaseHint().code());
+		// first motion
+		copyLabel(arr.first_mot, sizeof(arr.first_mot), "?");
+
+		int sec, usec;
+		pick->time().value().get(&arr.year, &arr.month, &arr.day,
+		                         &arr.hour, &arr.min, &sec, &usec);
+		arr.sec = sec + usec * 1E-6;
+
+		copyLabel(arr.error_type, sizeof(arr.error_type), "GAU");
+		arr.error = timeError(pick->time(), _defaultPickError);
+		arr.coda_dur = -1.0;
+		arr.amplitude = -1.0;
+		arr.period = -1.0;
+		arr.apriori_weight = weight;
+
+		arrivals.push_back(arr);
+	}
+
+	if ( arrivals.empty() ) {
 		throw LocatorException("Empty observation set due to missing stations");
 	}
 
@@ -866,24 +928,9 @@ Origin* NLLocator::locate(PickList &pickList) {
 	// Deal with LOCHYPOUT options
 	// The plugin suppress physical NLL output (LOCHYPOUT NONE)
 	// but some supported flags can be used
-	bool hasSed = _enableSEDParameters; // init true if user already set SED parameters
-	bool hasExpect = false;
-
-	for ( const auto &line : _controlFile ) {
-		if ( line.rfind("LOCHYPOUT", 0) != 0 ) 
-			continue;
-
-		// detect supported flags
-		if ( line.find("SAVE_NLLOC_EXPECTATION") != std::string::npos ) {
-			hasExpect = true;
-			SEISCOMP_DEBUG("Using expectation hypocenter");
-		}
-
-		if ( line.find("CALC_SED_ORIGIN") != std::string::npos ) {
-			hasSed = true;
-			SEISCOMP_DEBUG("SED parameters enabled");
-		}
-	}
+	// init true if user already set SED parameters
+	bool hasSed = _enableSEDParameters || setup.calcSEDOrigin;
+	bool hasExpect = setup.saveExpectation;
 
 	params.push_back(
 		std::string("LOCHYPOUT NONE")
@@ -891,32 +938,46 @@ Origin* NLLocator::locate(PickList &pickList) {
 		+ (hasExpect ? " SAVE_NLLOC_EXPECTATION" : "")
 	);
 
-	std::vector<char*> obs_buf, control_buf;
+	std::vector<char*> control_buf;
 
-	obs_buf.resize(obs.size());
-	for ( size_t i = 0; i < obs.size(); ++i )
-		obs_buf[i] = &obs[i][0];
-
-	control_buf.resize(_controlFile.size() + params.size());
-	for ( size_t i = 0; i < _controlFile.size(); ++i )
-		control_buf[i] = &_controlFile[i][0];
+	// The static statements are prepared by updateProfile, only the per
+	// location statements are appended
+	control_buf.reserve(setup.buffer.size() + params.size());
+	control_buf.assign(setup.buffer.begin(), setup.buffer.end());
 
 	for ( size_t i = 0; i < params.size(); ++i )
-		control_buf[_controlFile.size()+i] = &params[i][0];
+		control_buf.push_back(&params[i][0]);
 
 	// call taken from NLL_func_test
 	int return_locations = 1;
-	int return_oct_tree_grid = 1;
-	int return_scatter_sample = 1;
+	// The oct-tree and the scatter sample are only read to write the
+	// intermediate output. Without it NLLoc releases them right after the
+	// location and skips converting the oct-tree to probability densities.
+	// The scatter sample is still generated for the expectation and the
+	// covariance.
+	int return_oct_tree_grid = _enableNLLOutput ? 1 : 0;
+	int return_scatter_sample = _enableNLLOutput ? 1 : 0;
 	LocNode *loc_list_head = nullptr;
 
-	int istat = NLLoc(nullptr, nullptr,
-	                  &control_buf[0], (int)control_buf.size(),
-	                  &obs_buf[0], (int)obs_buf.size(), return_locations,
-	                  return_oct_tree_grid, return_scatter_sample, &loc_list_head);
+	int istat = NLLocArrivals(nullptr, nullptr,
+	                          &control_buf[0], (int)control_buf.size(),
+	                          &arrivals[0], (int)arrivals.size(),
+	                          &stations[0], (int)stations.size(), return_locations,
+	                          return_oct_tree_grid, return_scatter_sample, &loc_list_head);
 
 	SEISCOMP_DEBUG("NLLoc returned with code %d", istat);
 
+	GridMemStats gridStats;
+	NLL_GetGridMemoryStats(&gridStats);
+	SEISCOMP_DEBUG("Grid cache: %d grids, %.1f MB, hits: %lu, misses: %lu, evictions: %lu",
+	               gridStats.num_grids, gridStats.bytes / (1024.0 * 1024.0),
+	               gridStats.hits, gridStats.misses, gridStats.evictions);
+
+	OctreeMemStats octreeStats;
+	getOctreeMemStats(&octreeStats);
+	SEISCOMP_DEBUG("Octree memory: peak %ld nodes, %.1f MB",
+	               octreeStats.peak_num_nodes, octreeStats.peak_bytes / (1024.0 * 1024.0));
+
 	int id = 0;
 	LocNode *locNode = getLocationFromLocList(loc_list_head, id);
 	bool validOrigin = false;
@@ -935,10 +996,11 @@ Origin* NLLocator::locate(PickList &pickList) {
 
 			if ( _enableDistanceCutOff && !rejectedLocation ) {
 				// Update input weights for stations within distance
-				// greater that the cut-off
-				for ( PickList::iterator it = usedPicks.begin();
-				      it != usedPicks.end(); ++it ) {
-					Pick *pick = it->pick.get();
+				// greater that the cut-off, arrivals are in order of the
+				// used picks
+				size_t numCutOff = 0;
+				for ( size_t i = 0; i < usedPicks.size(); ++i ) {
+					Pick *pick = usedPicks[i].pick.get();
 
 					SensorLocation *sloc = getSensorLocation(pick);
 					if ( !sloc ) {
@@ -952,46 +1014,53 @@ Origin* NLLocator::locate(PickList &pickList) {
 					                  &dist, &az, &baz);
 
 					dist = Math::Geo::deg2km(dist);
-					if ( dist > _distanceCutOff )
-						replaceWeight(obs, stationName(pick, stationNameFormat), 0);
+					if ( dist > _distanceCutOff && arrivals[i].apriori_weight > 0 ) {
+						arrivals[i].apriori_weight = 0;
+						++numCutOff;
+					}
 				}
 
-				// Rebuild observation buffer
-				for ( size_t i = 0; i < obs.size(); ++i )
-					obs_buf[i] = &obs[i][0];
-
-				// Free previous results
-				freeLocList(loc_list_head, 1);
-
-				// call NLL again
-				loc_list_head = nullptr;
-				id = 0;
-				istat = NLLoc(nullptr, nullptr,
-				              &control_buf[0], (int)control_buf.size(),
-				              &obs_buf[0], (int)obs_buf.size(), return_locations,
-				              return_oct_tree_grid, return_scatter_sample, &loc_list_head);
-
-				SEISCOMP_DEBUG("NLLoc 2nd call returned with code %d", istat);
-
-				validOrigin = false;
-				locNode = getLocationFromLocList(loc_list_head, id);
-
-				if ( locNode ) {
-					// Create a new origin with the same publicID
-					std::string publicID = origin->publicID();
-					delete origin;
-					origin = nullptr;
-					origin = Origin::Create(publicID);
-					validOrigin = NLL2SC3(origin, _lastWarning, locNode, usedPicks, _usingFixedDepth);
+				// The second pass would repeat the first one with the
+				// same weights
+				if ( !numCutOff ) {
+					SEISCOMP_DEBUG("No weighted arrival beyond the distance cut-off, "
+					               "keeping the first location");
 				}
 				else {
-					delete origin;
-					origin = nullptr;
+					// Free previous results
 					freeLocList(loc_list_head, 1);
-					throw LocatorException("Distance cut-off failed: empty location");
-				}
 
-				if ( !validOrigin ) break;
+					// call NLL again
+					loc_list_head = nullptr;
+					id = 0;
+					istat = NLLocArrivals(nullptr, nullptr,
+					                      &control_buf[0], (int)control_buf.size(),
+					                      &arrivals[0], (int)arrivals.size(),
+					                      &stations[0], (int)stations.size(), return_locations,
+					                      return_oct_tree_grid, return_scatter_sample, &loc_list_head);
+
+					SEISCOMP_DEBUG("NLLoc 2nd call returned with code %d", istat);
+
+					validOrigin = false;
+					locNode = getLocationFromLocList(loc_list_head, id);
+
+					if ( locNode ) {
+						// Create a new origin with the same publicID
+						std::string publicID = origin->publicID();
+						delete origin;
+						origin = nullptr;
+						origin = Origin::Create(publicID);
+						validOrigin = NLL2SC3(origin, _lastWarning, locNode, usedPicks, _usingFixedDepth);
+					}
+					else {
+						delete origin;
+						origin = nullptr;
+						freeLocList(loc_list_head, 1);
+						throw LocatorException("Distance cut-off failed: empty location");
+					}
+
+					if ( !validOrigin ) break;
+				}
 			}
 
 			// fill additional values
@@ -1055,8 +1124,8 @@ Origin* NLLocator::locate(PickList &pickList) {
 	if ( _enableNLLSaveInput ) {
 		// Save NLL observation input
 		ofstream obsOut((outputPath + ".obs").c_str());
-		for ( size_t i = 0; i < obs_buf.size(); ++i ) {
-			obsOut << obs_buf[i];
+		for ( size_t i = 0; i < arrivals.size(); ++i ) {
+			obsOut << observationLine(arrivals[i]);
 		}
 		obsOut.close();
 		SEISCOMP_DEBUG("Saving phase observations in %s.obs", outputPath);
@@ -1064,6 +1133,9 @@ Origin* NLLocator::locate(PickList &pickList) {
 		// Save NLL control input
 		ofstream controlOut((outputPath + ".conf").c_str());
 		SEISCOMP_DEBUG("Saving NonLinLoc configuration to %s.conf", outputPath);
+		for ( size_t i = 0; i < stations.size(); ++i ) {
+			controlOut << sourceLine(stations[i]) << endl;
+		}
 		for ( size_t i = 0; i < control_buf.size(); ++i ) {
 			controlOut << control_buf[i] << endl;
 		}
@@ -1320,57 +1392,109 @@ void NLLocator::updateProfile(const std::string &name) {
 	SEISCOMP_DEBUG("Setting profile %s", name.c_str());
 
 	_currentProfile = prof;
-	_controlFile.clear();
 
 	// Unset all parameters
 	for ( ParameterMap::iterator it = _parameters.begin();
 	      it != _parameters.end(); ++it )
 		it->second = "";
 
-	if ( _currentProfile ) {
-		string controlFile;
-		if ( !_currentProfile->controlFile.empty() )
-			controlFile = _currentProfile->controlFile;
-		else if ( !_controlFilePath.empty() )
-			controlFile = _controlFilePath;
-
-		if ( !controlFile.empty() ) {
-			SEISCOMP_DEBUG("Reading control file: %s", controlFile.c_str());
-			ifstream f(controlFile.c_str());
-			if ( !f.is_open() ) {
-				SEISCOMP_ERROR("NonLinLoc: unable to open control file %s",
-				               controlFile.c_str());
-				return;
-			}
+	if ( !_currentProfile ) {
+		return;
+	}
 
-			while ( f.good() ) {
-				string line;
-				getline(f, line);
-				Core::trim(line);
-				// ignore empty lines
-				if ( line.empty() ) continue;
-				// ignore comments
-				if ( line[0] == '#' ) continue;
-
-				size_t pos = line.find_first_of(" \t\r\n");
-				if ( pos != string::npos ) {
-					string param = line.substr(0, pos);
-					// Lookup the parameter name in the local parameter map
-					// If not available pass it to NLL directly without being able
-					// to modify it.
-					ParameterMap::iterator it = _parameters.find(param);
-					if ( it == _parameters.end() )
-						_controlFile.push_back(line);
-					else {
-						it->second = line.substr(pos+1);
-						Core::trim(it->second);
+	string controlFile;
+	if ( !_currentProfile->controlFile.empty() )
+		controlFile = _currentProfile->controlFile;
+	else if ( !_controlFilePath.empty() )
+		controlFile = _controlFilePath;
+
+	if ( controlFile.empty() ) {
+		return;
+	}
+
+	// The control file is only read again if it was modified since the
+	// profile was selected the last time
+	ControlSetup &setup = _currentProfile->setup;
+	struct stat st;
+	time_t mtime = stat(controlFile.c_str(), &st) == 0 ? st.st_mtime : 0;
+	if ( !setup.loaded || setup.path != controlFile || setup.mtime != mtime ) {
+		if ( !readControlFile(setup, controlFile) ) {
+			setup = ControlSetup();
+			return;
+		}
+
+		setup.path = controlFile;
+		setup.mtime = mtime;
+	}
+
+	for ( ParameterMap::const_iterator it = setup.parameters.begin();
+	      it != setup.parameters.end(); ++it )
+		_parameters[it->first] = it->second;
+}
+// <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
+
+
+
+
+// >>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+bool NLLocator::readControlFile(ControlSetup &setup, const string &path) const {
+	SEISCOMP_DEBUG("Reading control file: %s", path.c_str());
+	ifstream f(path.c_str());
+	if ( !f.is_open() ) {
+		SEISCOMP_ERROR("NonLinLoc: unable to open control file %s",
+		               path.c_str());
+		return false;
+	}
+
+	setup = ControlSetup();
+
+	while ( f.good() ) {
+		string line;
+		getline(f, line);
+		Core::trim(line);
+		// ignore empty lines
+		if ( line.empty() ) continue;
+		// ignore comments
+		if ( line[0] == '#' ) continue;
+
+		size_t pos = line.find_first_of(" \t\r\n");
+		if ( pos != string::npos ) {
+			string param = line.substr(0, pos);
+			// Lookup the parameter name in the local parameter map
+			// If not available pass it to NLL directly without being able
+			// to modify it.
+			if ( _parameters.find(param) == _parameters.end() ) {
+				if ( param == "LOCHYPOUT" ) {
+					// detect supported flags
+					if ( line.find("SAVE_NLLOC_EXPECTATION") != string::npos ) {
+						setup.saveExpectation = true;
+						SEISCOMP_DEBUG("Using expectation hypocenter");
+					}
+
+					if ( line.find("CALC_SED_ORIGIN") != string::npos ) {
+						setup.calcSEDOrigin = true;
+						SEISCOMP_DEBUG("SED parameters enabled");
 					}
 				}
-				else
-					_controlFile.push_back(line);
+
+				setup.lines.push_back(line);
+			}
+			else {
+				string &value = setup.parameters[param];
+				value = line.substr(pos+1);
+				Core::trim(value);
 			}
 		}
+		else
+			setup.lines.push_back(line);
 	}
+
+	setup.buffer.resize(setup.lines.size());
+	for ( size_t i = 0; i < setup.lines.size(); ++i )
+		setup.buffer[i] = &setup.lines[i][0];
+
+	setup.loaded = true;
+	return true;
 }
 // <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
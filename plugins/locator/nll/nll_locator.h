@@ -17,6 +17,7 @@
 
 #include <seiscomp/core/plugin.h>
 #include <seiscomp/seismology/locatorinterface.h>
+#include <ctime>
 #include <string>
 
 
@@ -90,7 +91,10 @@ class NLLocator : public Seiscomp::Seismology::LocatorInterface {
 	//  Private methods
 	// ----------------------------------------------------------------------
 	private:
+		struct ControlSetup;
+
 		void updateProfile(const std::string &name);
+		bool readControlFile(ControlSetup &setup, const std::string &path) const;
 
 		bool NLL2SC3(DataModel::Origin *origin, std::string &locComment,
 		             const void *node, const PickList &picks,
@@ -101,18 +105,42 @@ class NLLocator : public Seiscomp::Seismology::LocatorInterface {
 	//  Private members
 	// ----------------------------------------------------------------------
 	private:
+		typedef std::map<std::string, std::string> ParameterMap;
+		typedef std::vector<std::string> TextLines;
+
+		//! The static part of a profile's control file. It is read when
+		//! the profile is selected and the file has not been read before
+		//! or was modified since. Only the plugin side is cached, NLLoc
+		//! still parses the statements on each location.
+		struct ControlSetup {
+			ControlSetup() : loaded(false), mtime(0), saveExpectation(false), calcSEDOrigin(false) {}
+
+			bool               loaded;
+			//! The file read and its modification time
+			std::string        path;
+			time_t             mtime;
+			//! Statements passed to NLLoc unmodified
+			TextLines          lines;
+			//! Pointers into lines, the static head of the NLLoc input
+			std::vector<char*> buffer;
+			//! Values of the statements that can be changed with setParameter
+			ParameterMap       parameters;
+			//! Flags of the LOCHYPOUT statements honoured by the plugin
+			bool               saveExpectation;
+			bool               calcSEDOrigin;
+		};
+
 		struct Profile {
-			std::string name;
-			std::string earthModelID;
-			std::string methodID;
-			std::string tablePath;
-			std::string stationNameFormat;
-			std::string controlFile;
-			RegionPtr   region;
+			std::string  name;
+			std::string  earthModelID;
+			std::string  methodID;
+			std::string  tablePath;
+			std::string  stationNameFormat;
+			std::string  controlFile;
+			RegionPtr    region;
+			ControlSetup setup;
 		};
 
-		typedef std::map<std::string, std::string> ParameterMap;
-		typedef std::vector<std::string> TextLines;
 		typedef std::list<Profile> Profiles;
 
 		static IDList _allowedParameters;
@@ -123,7 +151,6 @@ class NLLocator : public Seiscomp::Seismology::LocatorInterface {
 		std::string   _lastWarning;
 		std::string   _SEDqualityTag;
 		std::string   _SEDdiffMaxLikeExpectTag;
-		TextLines     _controlFile;
 		IDList        _profileNames;
 
 		double        _fixedDepthGridSpacing;